@@ -75,10 +75,18 @@ typedef struct {
 typedef struct {
    int section;
    char *title;
+   Dlist *bms;  /* index: this section's bookmarks, in order */
 
    int o_sec;   /* private, for normalization */
 } BmSec;
 
+/* Bookmarks per page in the bookmarks and modify pages */
+#define BM_PAGE_SIZE 500
+/* Records appended to the bookmarks file before it's rewritten in full */
+#define BM_COMPACT_THRESHOLD 256
+/* Written by Bms_save(), the records after it were appended */
+#define BM_JOURNAL_MARK ":j: appended records follow\n"
+
 
 /*
  * Local data
@@ -86,8 +94,10 @@ typedef struct {
 static char *Header = "Content-type: text/html\n\n";
 static char *BmFile = NULL;
 static time_t BmFileTimeStamp = 0;
-static Dlist *B_bms = NULL;
+static Dlist *B_bms = NULL;   /* sorted by key */
 static int bm_key = 0;
+static int BmJournalLen = 0;  /* records appended since the last full save */
+static int BmJournalMark = 0; /* whether the file has BM_JOURNAL_MARK */
 
 static Dlist *B_secs = NULL;
 static int sec_key = 0;
@@ -153,13 +163,13 @@ static const char *mainpage_sections_header =
 #define modifypage_sections_header mainpage_sections_header
 
 static const char *mainpage_sections_item =
-"    <li><a href='#s%d'>%s</a></li>\n";
+"    <li><a href='%s#s%d'>%s</a></li>\n";
 
 static const char *sections_sep =
 " | \n";
 
 static const char *modifypage_sections_item =
-"    <li><input type='checkbox' name='s%d'><a href='#s%d'>%s</a></li>\n";
+"    <li><input type='checkbox' name='s%d'><a href='%s#s%d'>%s</a></li>\n";
 
 static const char *mainpage_sections_footer =
 "  </ul>\n"
@@ -195,6 +205,19 @@ static const char *mainpage_section_card_footer =
 
 #define modifypage_section_card_footer mainpage_section_card_footer
 
+static const char *pages_header =
+"<nav>\n"
+"  <ul>\n"
+"    <li>Page:</li>\n";
+
+static const char *pages_item =
+"    <li><a href='%s?page=%d'>%d</a></li>\n";
+
+static const char *pages_item_current =
+"    <li><b>%d</b></li>\n";
+
+#define pages_footer mainpage_sections_footer
+
 static const char *mainpage_footer =
 "</body>\n"
 "</html>\n";
@@ -372,14 +395,6 @@ static int Bms_node_by_key_cmp(const void *node, const void *key)
    return ((BmRec *)node)->key - VOIDP2INT(key);
 }
 
-/*
- * Compare function for searching a bookmark by section
- */
-static int Bms_node_by_section_cmp(const void *node, const void *key)
-{
-   return ((BmRec *)node)->section - VOIDP2INT(key);
-}
-
 /*
  * Compare function for searching a section by its number
  */
@@ -390,10 +405,11 @@ static int Bms_sec_by_number_cmp(const void *node, const void *key)
 
 /*
  * Return the Bm record by key
+ * (B_bms is kept sorted by key: new keys are always the greatest)
  */
 static BmRec *Bms_get(int key)
 {
-   return dList_find_custom(B_bms, INT2VOIDP(key), Bms_node_by_key_cmp);
+   return dList_find_sorted(B_bms, INT2VOIDP(key), Bms_node_by_key_cmp);
 }
 
 /*
@@ -407,9 +423,10 @@ static BmSec *Bms_get_sec(int key)
 /*
  * Add a bookmark
  */
-static void Bms_add(int section, char *url, char *title)
+static BmRec *Bms_add(int section, char *url, char *title)
 {
    BmRec *bm_node;
+   BmSec *sec_node;
 
    bm_node = dNew(BmRec, 1);
    bm_node->key = ++bm_key;
@@ -417,6 +434,9 @@ static void Bms_add(int section, char *url, char *title)
    bm_node->url = Escape_uri_str(url, "'");
    bm_node->title = Escape_html_str(title);
    dList_append(B_bms, bm_node);
+   if ((sec_node = Bms_get_sec(section)))
+      dList_append(sec_node->bms, bm_node);
+   return bm_node;
 }
 
 /*
@@ -425,11 +445,30 @@ static void Bms_add(int section, char *url, char *title)
 static void Bms_sec_add(char *title)
 {
    BmSec *sec_node;
+   BmRec *bm_node;
+   int i;
 
    sec_node = dNew(BmSec, 1);
    sec_node->section = sec_key++;
    sec_node->title = Escape_html_str(title);
+   sec_node->bms = dList_new(32);
    dList_append(B_secs, sec_node);
+
+   /* adopt bookmarks that refer to this section number already */
+   for (i = 0; (bm_node = dList_nth_data(B_bms, i)); ++i) {
+      if (bm_node->section == sec_node->section)
+         dList_append(sec_node->bms, bm_node);
+   }
+}
+
+/*
+ * Free a bookmark record
+ */
+static void Bms_node_free(BmRec *bm_node)
+{
+   dFree(bm_node->title);
+   dFree(bm_node->url);
+   dFree(bm_node);
 }
 
 /*
@@ -438,13 +477,13 @@ static void Bms_sec_add(char *title)
 static void Bms_del(int key)
 {
    BmRec *bm_node;
+   BmSec *sec_node;
 
-   bm_node = dList_find_custom(B_bms, INT2VOIDP(key), Bms_node_by_key_cmp);
-   if (bm_node) {
+   if ((bm_node = Bms_get(key))) {
       dList_remove(B_bms, bm_node);
-      dFree(bm_node->title);
-      dFree(bm_node->url);
-      dFree(bm_node);
+      if ((sec_node = Bms_get_sec(bm_node->section)))
+         dList_remove(sec_node->bms, bm_node);
+      Bms_node_free(bm_node);
    }
    if (dList_length(B_bms) == 0)
       bm_key = 0;
@@ -458,18 +497,16 @@ static void Bms_sec_del(int section)
    BmSec *sec_node;
    BmRec *bm_node;
 
-   sec_node = dList_find_custom(B_secs, INT2VOIDP(section),
-                                Bms_sec_by_number_cmp);
-   if (sec_node) {
+   if ((sec_node = Bms_get_sec(section))) {
+      /* remove the bookmarks in this section */
+      while ((bm_node = dList_nth_data(sec_node->bms, 0))) {
+         Bms_del(bm_node->key);
+      }
+
       dList_remove(B_secs, sec_node);
+      dList_free(sec_node->bms);
       dFree(sec_node->title);
       dFree(sec_node);
-
-      /* iterate B_bms and remove those that match the section */
-      while ((bm_node = dList_find_custom(B_bms, INT2VOIDP(section),
-                                          Bms_node_by_section_cmp))) {
-         Bms_del(bm_node->key);
-      }
    }
    if (dList_length(B_secs) == 0)
       sec_key = 0;
@@ -481,9 +518,13 @@ static void Bms_sec_del(int section)
 static void Bms_move(int key, int target_section)
 {
    BmRec *bm_node;
+   BmSec *sec_node;
 
-   bm_node = dList_find_custom(B_bms, INT2VOIDP(key), Bms_node_by_key_cmp);
-   if (bm_node) {
+   if ((bm_node = Bms_get(key)) && bm_node->section != target_section) {
+      if ((sec_node = Bms_get_sec(bm_node->section)))
+         dList_remove(sec_node->bms, bm_node);
+      if ((sec_node = Bms_get_sec(target_section)))
+         dList_append(sec_node->bms, bm_node);
       bm_node->section = target_section;
    }
 }
@@ -495,8 +536,7 @@ static void Bms_update_title(int key, char *n_title)
 {
    BmRec *bm_node;
 
-   bm_node = dList_find_custom(B_bms, INT2VOIDP(key), Bms_node_by_key_cmp);
-   if (bm_node) {
+   if ((bm_node = Bms_get(key))) {
       dFree(bm_node->title);
       bm_node->title = Escape_html_str(n_title);
    }
@@ -509,8 +549,7 @@ static void Bms_update_sec_title(int key, char *n_title)
 {
    BmSec *sec_node;
 
-   sec_node = dList_find_custom(B_secs, INT2VOIDP(key), Bms_sec_by_number_cmp);
-   if (sec_node) {
+   if ((sec_node = Bms_get_sec(key))) {
       dFree(sec_node->title);
       sec_node->title = Escape_html_str(n_title);
    }
@@ -523,15 +562,24 @@ static void Bms_free(void)
 {
    BmRec *bm_node;
    BmSec *sec_node;
+   int i;
+
+   /* free B_bms (no need to keep the indexes up to date one by one) */
+   for (i = 0; (bm_node = dList_nth_data(B_bms, i)); ++i)
+      Bms_node_free(bm_node);
+   dList_free(B_bms);
+   B_bms = dList_new(512);
+   bm_key = 0;
 
-   /* free B_bms */
-   while ((bm_node = dList_nth_data(B_bms, 0))) {
-      Bms_del(bm_node->key);
-   }
    /* free B_secs */
-   while ((sec_node = dList_nth_data(B_secs, 0))) {
-      Bms_sec_del(sec_node->section);
+   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
+      dList_free(sec_node->bms);
+      dFree(sec_node->title);
+      dFree(sec_node);
    }
+   dList_free(B_secs);
+   B_secs = dList_new(32);
+   sec_key = 0;
 }
 
 /*
@@ -553,18 +601,52 @@ static void Bms_normalize(void)
       sec_node->section = i;
    }
 
-   /* iterate B_secs and make the changes in B_bms */
+   /* iterate B_secs and make the changes in their bookmarks */
    for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
       if (sec_node->section != sec_node->o_sec) {
          /* update section numbers */
-         for (j = 0; (bm_node = dList_nth_data(B_bms, j)); ++j) {
-            if (bm_node->section == sec_node->o_sec)
-               bm_node->section = sec_node->section;
-         }
+         for (j = 0; (bm_node = dList_nth_data(sec_node->bms, j)); ++j)
+            bm_node->section = sec_node->section;
       }
    }
 }
 
+/*
+ * Return the number of pages needed to show all the bookmarks
+ */
+static int Bms_page_count(void)
+{
+   BmSec *sec_node;
+   int i, n = 0;
+
+   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i)
+      n += dList_length(sec_node->bms);
+   return n > BM_PAGE_SIZE ? (n + BM_PAGE_SIZE - 1) / BM_PAGE_SIZE : 1;
+}
+
+/*
+ * Return the page where a section's card starts.
+ * 'n' is the number of bookmarks in the preceding sections, and
+ * 'n_pages' what Bms_page_count() returns.
+ */
+static int Bms_sec_page(int n, int n_pages)
+{
+   return MIN(n / BM_PAGE_SIZE, n_pages - 1);
+}
+
+/*
+ * Tell whether (part of) a section's card is shown in 'page'.
+ * 'n' is the number of bookmarks in the preceding sections.
+ */
+static int Bms_sec_in_page(BmSec *sec_node, int n, int page, int n_pages)
+{
+   int len = dList_length(sec_node->bms);
+
+   if (len == 0)
+      return Bms_sec_page(n, n_pages) == page;
+   return n < (page + 1) * BM_PAGE_SIZE && n + len > page * BM_PAGE_SIZE;
+}
+
 /* -- Load bookmarks file -------------------------------------------------- */
 
 /*
@@ -620,6 +702,8 @@ static int Bms_load(void)
 
    /* clear current bookmarks */
    Bms_free();
+   BmJournalLen = 0;
+   BmJournalMark = 0;
 
    /* open bm file */
    if (!(BmTxt = fopen(BmFile, "r"))) {
@@ -649,7 +733,11 @@ static int Bms_load(void)
          u_title = Unescape_html_str(title);
          Bms_add(section, url, u_title);
          dFree(u_title);
+         if (BmJournalMark)
+            ++BmJournalLen;
 
+      } else if (buf[0] == ':' && buf[1] == 'j') {
+         BmJournalMark = 1;
       } else if (buf[0] == ':' && buf[1] == 's') {
          /* section = strtol(buf + 2, NULL, 10); */
          p = strchr(buf + 2, ' ');
@@ -747,19 +835,56 @@ static int Bms_save(void)
 
    /* save bookmarks  (section url title) */
    for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
-      for (j = 0; (bm_node = dList_nth_data(B_bms, j)); ++j) {
-         if (bm_node->section == sec_node->section) {
-            u_title = Unescape_html_str(bm_node->title);
-            dStr_sprintf(dstr, "s%d %s %s\n",
-                         bm_node->section, bm_node->url, u_title);
-            fwrite(dstr->str, (size_t)dstr->len, 1, BmTxt);
-            dFree(u_title);
-         }
+      for (j = 0; (bm_node = dList_nth_data(sec_node->bms, j)); ++j) {
+         u_title = Unescape_html_str(bm_node->title);
+         dStr_sprintf(dstr, "s%d %s %s\n",
+                      bm_node->section, bm_node->url, u_title);
+         fwrite(dstr->str, (size_t)dstr->len, 1, BmTxt);
+         dFree(u_title);
       }
    }
+   /* Bms_append() adds to the file after this */
+   fputs(BM_JOURNAL_MARK, BmTxt);
 
    dStr_free(dstr, TRUE);
    fclose(BmTxt);
+   BmJournalLen = 0;
+   BmJournalMark = 1;
+
+   /* keep track of the timestamp */
+   stat(BmFile, &BmStat);
+   BmFileTimeStamp = BmStat.st_mtime;
+
+   return 0;
+}
+
+/*
+ * Append a bookmark record to the bookmarks file instead of rewriting it.
+ * The loader doesn't mind the records being out of section order, and
+ * counts the ones after BM_JOURNAL_MARK; once enough of them pile up, the
+ * file is compacted by a full save (which also writes the mark to files
+ * that lack it).
+ * Return code: { 0:OK, 1:Abort }
+ */
+static int Bms_append(BmRec *bm_node)
+{
+   FILE *BmTxt;
+   struct stat BmStat;
+   char *u_title;
+
+   if (!BmJournalMark || BmJournalLen >= BM_COMPACT_THRESHOLD ||
+       stat(BmFile, &BmStat) != 0 || BmStat.st_mtime != BmFileTimeStamp)
+      return Bms_save();
+
+   if (!(BmTxt = fopen(BmFile, "a"))) {
+      perror("[fopen]");
+      return 1;
+   }
+   u_title = Unescape_html_str(bm_node->title);
+   fprintf(BmTxt, "s%d %s %s\n", bm_node->section, bm_node->url, u_title);
+   dFree(u_title);
+   fclose(BmTxt);
+   ++BmJournalLen;
 
    /* keep track of the timestamp */
    stat(BmFile, &BmStat);
@@ -778,14 +903,18 @@ static int Bmsrv_add_bm(Dsh *sh, char *url, char *title)
    char *u_title;
    char *msg="Added bookmark!";
    int section = 0;
+   BmRec *bm_node;
 
    /* Add in memory */
    u_title = Unescape_html_str(title);
-   Bms_add(section, url, u_title);
+   bm_node = Bms_add(section, url, u_title);
    dFree(u_title);
 
-   /* Write to file */
-   Bms_save();
+   /* Write to file (a fresh one when there are no sections yet) */
+   if (Bms_get_sec(section))
+      Bms_append(bm_node);
+   else
+      Bms_save();
 
    if (Bmsrv_dpi_send_status_msg(sh, msg))
       return 1;
@@ -832,17 +961,78 @@ static int Bmsrv_send_reload_request(Dsh *sh, char *url)
    return st;
 }
 
+/*
+ * Send links to every page of 'base' (when there's more than one)
+ * Return code: { 0:OK, 1:Abort }
+ */
+static int Bmsrv_send_pages_nav(Dsh *sh, Dstr *dstr, const char *base,
+                                int page)
+{
+   int i, n_pages = Bms_page_count();
+
+   if (n_pages == 1)
+      return 0;
+
+   if (a_Dpip_dsh_write_str(sh, 0, pages_header))
+      return 1;
+   for (i = 0; i < n_pages; ++i) {
+      if (i == page)
+         dStr_sprintf(dstr, pages_item_current, i + 1);
+      else
+         dStr_sprintf(dstr, pages_item, base, i, i + 1);
+      if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
+         return 1;
+   }
+   if (a_Dpip_dsh_write_str(sh, 0, pages_footer))
+      return 1;
+   return 0;
+}
+
+/*
+ * Return the link prefix to reach a section card that starts at
+ * bookmark number 'n', from page 'page' of 'base'.
+ */
+static const char *Bmsrv_sec_href(const char *base, int n, int page,
+                                  int n_pages)
+{
+   static Dstr *href = NULL;
+   int sec_page = Bms_sec_page(n, n_pages);
+
+   if (!href)
+      href = dStr_new("");
+   if (sec_page == page)
+      dStr_truncate(href, 0);
+   else
+      dStr_sprintf(href, "%s?page=%d", base, sec_page);
+   return href->str;
+}
+
+/*
+ * Get the page number from a bookmarks url (e.g. "dpi:/bm/?page=2")
+ */
+static int Bmsrv_get_page(const char *url)
+{
+   const char *p;
+   int page = 0;
+
+   if ((p = strstr(url, "?page=")))
+      page = strtol(p + 6, NULL, 10);
+   return MAX(0, MIN(page, Bms_page_count() - 1));
+}
+
 /*
  * Send the HTML for the modify page
  * Return code: { 0:OK, 1:Abort, 2:Close }
  */
-static int Bmsrv_send_modify_page(Dsh *sh)
+static int Bmsrv_send_modify_page(Dsh *sh, int page)
 {
    static Dstr *dstr = NULL;
+   const char *href;
    char *l_title;
    BmSec *sec_node;
    BmRec *bm_node;
-   int i, j;
+   int i, j, n, len, start = page * BM_PAGE_SIZE;
+   int n_pages = Bms_page_count();
 
    if (!dstr)
       dstr = dStr_new("");
@@ -855,16 +1045,18 @@ static int Bmsrv_send_modify_page(Dsh *sh)
    if (a_Dpip_dsh_write_str(sh, 0, modifypage_sections_header))
       return 1;
    /* write sections */
-   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
+   for (i = 0, n = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
       if (i > 0) {
          if (a_Dpip_dsh_write_str(sh, 0, sections_sep))
             return 1;
       }
 
-      dStr_sprintf(dstr, modifypage_sections_item,
-                   sec_node->section, sec_node->section, sec_node->title);
+      href = Bmsrv_sec_href("dpi:/bm/modify", n, page, n_pages);
+      dStr_sprintf(dstr, modifypage_sections_item, sec_node->section,
+                   href, sec_node->section, sec_node->title);
       if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
          return 1;
+      n += dList_length(sec_node->bms);
    }
    /* write sections footer */
    if (a_Dpip_dsh_write_str(sh, 0, modifypage_sections_footer))
@@ -874,8 +1066,12 @@ static int Bmsrv_send_modify_page(Dsh *sh)
    if (a_Dpip_dsh_write_str(sh, 0, modifypage_middle1))
       return 1;
 
-   /* send bookmark cards */
-   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
+   /* send bookmark cards for this page */
+   for (i = 0, n = 0; (sec_node = dList_nth_data(B_secs, i)); ++i, n += len) {
+      len = dList_length(sec_node->bms);
+      if (!Bms_sec_in_page(sec_node, n, page, n_pages))
+         continue;
+
       /* send card header */
       l_title = make_one_line_str(sec_node->title);
       dStr_sprintf(dstr, modifypage_section_card_header,
@@ -885,13 +1081,13 @@ static int Bmsrv_send_modify_page(Dsh *sh)
          return 1;
 
       /* send section's bookmarks */
-      for (j = 0; (bm_node = dList_nth_data(B_bms, j)); ++j) {
-         if (bm_node->section == sec_node->section) {
-            dStr_sprintf(dstr, modifypage_section_card_item,
-                         bm_node->key, bm_node->url, bm_node->title);
-            if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
-               return 1;
-         }
+      for (j = MAX(0, start - n);
+           j < len && n + j < start + BM_PAGE_SIZE; ++j) {
+         bm_node = dList_nth_data(sec_node->bms, j);
+         dStr_sprintf(dstr, modifypage_section_card_item,
+                      bm_node->key, bm_node->url, bm_node->title);
+         if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
+            return 1;
       }
 
       /* send card footer */
@@ -899,6 +1095,10 @@ static int Bmsrv_send_modify_page(Dsh *sh)
          return 1;
    }
 
+   /* send links to the other pages */
+   if (Bmsrv_send_pages_nav(sh, dstr, "dpi:/bm/modify", page))
+      return 1;
+
    /* finish page */
    if (a_Dpip_dsh_write_str(sh, 1, modifypage_footer))
       return 1;
@@ -1039,7 +1239,7 @@ static int Bmsrv_send_modify_answer(Dsh *sh, char *url)
       MODIFY_PAGE_NUM = 1;
       return Bmsrv_send_modify_page_add_url(sh);
    } else {
-      return Bmsrv_send_modify_page(sh);
+      return Bmsrv_send_modify_page(sh, Bmsrv_get_page(url));
    }
 }
 
@@ -1400,15 +1600,17 @@ static int Bmsrv_process_modify_request(Dsh *sh, char *url)
 /* -- Bookmarks ------------------------------------------------------------ */
 
 /*
- * Send the current bookmarks page (in HTML)
+ * Send a page of the current bookmarks (in HTML)
  */
-static int send_bm_page(Dsh *sh)
+static int send_bm_page(Dsh *sh, int page)
 {
    static Dstr *dstr = NULL;
+   const char *href;
    char *l_title;
    BmSec *sec_node;
    BmRec *bm_node;
-   int i, j;
+   int i, j, n, len, start = page * BM_PAGE_SIZE;
+   int n_pages = Bms_page_count();
 
    if (!dstr)
       dstr = dStr_new("");
@@ -1420,16 +1622,18 @@ static int send_bm_page(Dsh *sh)
    if (a_Dpip_dsh_write_str(sh, 0, mainpage_sections_header))
       return 1;
    /* write sections */
-   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
+   for (i = 0, n = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
       if (i > 0) {
          if (a_Dpip_dsh_write_str(sh, 0, sections_sep))
             return 1;
       }
 
+      href = Bmsrv_sec_href("dpi:/bm/", n, page, n_pages);
       dStr_sprintf(dstr, mainpage_sections_item,
-                   sec_node->section, sec_node->title);
+                   href, sec_node->section, sec_node->title);
       if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
          return 1;
+      n += dList_length(sec_node->bms);
    }
    /* write sections footer */
    if (a_Dpip_dsh_write_str(sh, 0, mainpage_sections_footer))
@@ -1439,8 +1643,12 @@ static int send_bm_page(Dsh *sh)
    if (a_Dpip_dsh_write_str(sh, 0, mainpage_middle1))
       return 1;
 
-   /* send bookmark cards */
-   for (i = 0; (sec_node = dList_nth_data(B_secs, i)); ++i) {
+   /* send bookmark cards for this page */
+   for (i = 0, n = 0; (sec_node = dList_nth_data(B_secs, i)); ++i, n += len) {
+      len = dList_length(sec_node->bms);
+      if (!Bms_sec_in_page(sec_node, n, page, n_pages))
+         continue;
+
       /* send card header */
       l_title = make_one_line_str(sec_node->title);
       dStr_sprintf(dstr, mainpage_section_card_header,
@@ -1450,13 +1658,13 @@ static int send_bm_page(Dsh *sh)
          return 1;
 
       /* send section's bookmarks */
-      for (j = 0; (bm_node = dList_nth_data(B_bms, j)); ++j) {
-         if (bm_node->section == sec_node->section) {
-            dStr_sprintf(dstr, mainpage_section_card_item,
-                         bm_node->url, bm_node->title);
-            if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
-               return 1;
-         }
+      for (j = MAX(0, start - n);
+           j < len && n + j < start + BM_PAGE_SIZE; ++j) {
+         bm_node = dList_nth_data(sec_node->bms, j);
+         dStr_sprintf(dstr, mainpage_section_card_item,
+                      bm_node->url, bm_node->title);
+         if (a_Dpip_dsh_write_str(sh, 0, dstr->str))
+            return 1;
       }
 
       /* send card footer */
@@ -1464,6 +1672,10 @@ static int send_bm_page(Dsh *sh)
          return 1;
    }
 
+   /* send links to the other pages */
+   if (Bmsrv_send_pages_nav(sh, dstr, "dpi:/bm/", page))
+      return 1;
+
    /* finish page */
    if (a_Dpip_dsh_write_str(sh, 1, mainpage_footer))
       return 1;
@@ -1484,7 +1696,7 @@ static int Bmsrv_parse_token(Dsh *sh, char *Buf)
    static char *msg1=NULL, *msg2=NULL, *msg3=NULL;
    char *cmd, *d_cmd, *url, *title, *msg;
    size_t BufSize;
-   int st;
+   int st, page;
 
    if (!msg1) {
      /* Initialize data for the "chat" command. */
@@ -1547,7 +1759,8 @@ static int Bmsrv_parse_token(Dsh *sh, char *Buf)
       url = a_Dpip_get_attr_l(Buf, BufSize, "url");
 
       if (dStrnAsciiCasecmp(url, "dpi:", 4) == 0) {
-         if (strcmp(url+4, "/bm/modify") == 0) {
+         if (strcmp(url+4, "/bm/modify") == 0 ||
+             strncmp(url+4, "/bm/modify?page=", 16) == 0) {
             st = Bmsrv_send_modify_answer(sh, url);
             dFree(url);
             return st;
@@ -1560,6 +1773,7 @@ static int Bmsrv_parse_token(Dsh *sh, char *Buf)
       }
 
 
+      page = Bmsrv_get_page(url);
       d_cmd = a_Dpip_build_cmd("cmd=%s url=%s", "start_send_page", url);
       dFree(url);
       st = a_Dpip_dsh_write_str(sh, 1, d_cmd);
@@ -1572,7 +1786,7 @@ static int Bmsrv_parse_token(Dsh *sh, char *Buf)
          return 1;
       }
 
-      st = send_bm_page(sh);
+      st = send_bm_page(sh, page);
       if (st != 0) {
          char *err =
             DOCTYPE
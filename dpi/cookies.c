@@ -33,7 +33,9 @@ int main(void)
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/un.h>
 #include <netinet/in.h>
 #include <fcntl.h>
@@ -81,6 +83,12 @@ int main(void)
 #define MAX_DOMAIN_COOKIES 20
 #define MAX_TOTAL_COOKIES 1200
 
+/* Seconds a journaled cookie may wait before it's written to disk */
+#define JOURNAL_FLUSH_DELAY 5
+
+/* The most labels a host name can have (253 chars, 1 char labels) */
+#define MAX_DOMAIN_LABELS 127
+
 typedef enum {
    COOKIE_ACCEPT,
    COOKIE_ACCEPT_SESSION,
@@ -92,11 +100,27 @@ typedef struct {
    CookieControlAction action;
 } CookieControl;
 
+typedef struct DomainTrie DomainTrie;
+
 typedef struct {
    char *domain;
    Dlist *cookies;
+   DomainTrie *trie;   /* where this node hangs from */
 } DomainNode;
 
+/*
+ * Domains are indexed by a trie of their labels, in reverse order:
+ * "www.example.com" is reached through "com", "example" and "www".
+ * A domain with a leading dot shares the entry of the one without it.
+ */
+struct DomainTrie {
+   char *label;
+   DomainTrie *parent;
+   Dlist *children;       /* sorted by label */
+   DomainNode *node;      /* e.g. "example.com" */
+   DomainNode *dot_node;  /* e.g. ".example.com" */
+};
+
 typedef struct {
    char *name;
    char *value;
@@ -122,6 +146,15 @@ static Dlist *all_cookies;
 
 /* List of DomainNode. Each node holds a domain and its list of cookies */
 static Dlist *domains;
+/* Index of the DomainNodes in 'domains' */
+static DomainTrie *domain_trie;
+/* Set while Cookies_get() holds on to trie entries */
+static bool_t domain_trie_busy = FALSE;
+
+/* Cookie file lines waiting to be appended to cookies.txt, and the time
+ * of the oldest one. The whole file is rewritten at exit. */
+static Dstr *journal;
+static time_t journal_since;
 
 /* Variables for access control */
 static CookieControl *ccontrol = NULL;
@@ -152,25 +185,142 @@ static int Cookie_control_init(void);
 static void Cookies_add_cookie(CookieData_t *cookie);
 static int Cookies_cmp(const void *a, const void *b);
 
+typedef struct {
+   const char *str;
+   size_t len;
+} DomainLabel;
+
+/*
+ * Compare function for sorting trie entries
+ */
+static int Domain_trie_cmp(const void *v1, const void *v2)
+{
+   const DomainTrie *t1 = v1, *t2 = v2;
+
+   return dStrAsciiCasecmp(t1->label, t2->label);
+}
+
+/*
+ * Compare function for searching a trie entry by label
+ */
+static int Domain_trie_by_label_cmp(const void *v1, const void *v2)
+{
+   const DomainTrie *t = v1;
+   const DomainLabel *label = v2;
+   int st = dStrnAsciiCasecmp(t->label, label->str, label->len);
+
+   return st ? st : (t->label[label->len] != '\0');
+}
+
+static DomainTrie *Domain_trie_new(const char *label, size_t len)
+{
+   DomainTrie *t = dNew0(DomainTrie, 1);
+
+   t->label = dStrndup(label, len);
+   return t;
+}
+
+static void Domain_trie_free(DomainTrie *t)
+{
+   DomainTrie *child;
+   int i;
+
+   for (i = 0; (child = dList_nth_data(t->children, i)); ++i)
+      Domain_trie_free(child);
+   dList_free(t->children);
+   dFree(t->label);
+   dFree(t);
+}
+
+/*
+ * Remove 't' and then its parents, as long as they're left without
+ * nodes and children.
+ */
+static void Domain_trie_prune(DomainTrie *t)
+{
+   DomainTrie *parent;
+
+   while (t != domain_trie && !t->node && !t->dot_node &&
+          dList_length(t->children) == 0) {
+      parent = t->parent;
+      dList_remove(parent->children, t);
+      Domain_trie_free(t);
+      t = parent;
+   }
+}
+
+/*
+ * Walk the trie along the labels of 'domain' (without any leading dot),
+ * from its top level domain down, and return the entry for 'domain'.
+ * When 'create' is set, missing entries are added, else NULL is returned
+ * for an unknown domain.
+ * If 'path' is given, it gets every entry along the way (i.e., the ones
+ * for each suffix of 'domain', shortest first) and 'depth' their number.
+ */
+static DomainTrie *Domain_trie_walk(const char *domain, bool_t create,
+                                    DomainTrie **path, int *depth)
+{
+   DomainTrie *t = domain_trie, *child;
+   DomainLabel label;
+   const char *end = domain + strlen(domain), *p;
+   int n = 0;
+
+   while (1) {
+      for (p = end; p > domain && p[-1] != '.'; --p) ;
+      label.str = p;
+      label.len = end - p;
+      child = dList_find_sorted(t->children, &label,
+                                Domain_trie_by_label_cmp);
+      if (!child) {
+         if (!create) {
+            t = NULL;
+            break;
+         }
+         child = Domain_trie_new(label.str, label.len);
+         child->parent = t;
+         if (!t->children)
+            t->children = dList_new(4);
+         dList_insert_sorted(t->children, child, Domain_trie_cmp);
+      }
+      t = child;
+      if (path && n < MAX_DOMAIN_LABELS)
+         path[n++] = t;
+      if (p == domain)
+         break;
+      end = p - 1;
+   }
+   if (depth)
+      *depth = n;
+   return t;
+}
+
 /*
- * Compare function for searching a domain node
+ * Return the node holding the cookies for 'domain', if any.
  */
-static int Domain_node_cmp(const void *v1, const void *v2)
+static DomainNode *Cookies_find_node(const char *domain)
 {
-   const DomainNode *n1 = v1, *n2 = v2;
+   DomainTrie *t = Domain_trie_walk(domain + (*domain == '.'), FALSE,
+                                    NULL, NULL);
 
-   return dStrAsciiCasecmp(n1->domain, n2->domain);
+   return !t ? NULL : (*domain == '.') ? t->dot_node : t->node;
 }
 
 /*
- * Compare function for searching a domain node by domain
+ * Create an (empty) node for 'domain'.
  */
-static int Domain_node_by_domain_cmp(const void *v1, const void *v2)
+static DomainNode *Cookies_new_node(const char *domain)
 {
-   const DomainNode *node = v1;
-   const char *domain = v2;
+   DomainNode *node = dNew(DomainNode, 1);
 
-   return dStrAsciiCasecmp(node->domain, domain);
+   node->domain = dStrdup(domain);
+   node->cookies = dList_new(5);
+   node->trie = Domain_trie_walk(domain + (*domain == '.'), TRUE, NULL, NULL);
+   if (*domain == '.')
+      node->trie->dot_node = node;
+   else
+      node->trie->node = node;
+   dList_append(domains, node);
+   return node;
 }
 
 /*
@@ -178,6 +328,12 @@ static int Domain_node_by_domain_cmp(const void *v1, const void *v2)
  */
 static void Cookies_delete_node(DomainNode *node)
 {
+   if (node->trie->node == node)
+      node->trie->node = NULL;
+   else
+      node->trie->dot_node = NULL;
+   if (!domain_trie_busy)
+      Domain_trie_prune(node->trie);
    dList_remove(domains, node);
    dFree(node->domain);
    dList_free(node->cookies);
@@ -251,6 +407,8 @@ static void Cookies_load_cookies(FILE *stream)
 
    all_cookies = dList_new(32);
    domains = dList_new(32);
+   domain_trie = dNew0(DomainTrie, 1);
+   journal = dStr_new("");
 
    /* Get all lines in the file */
    while (!feof(stream)) {
@@ -384,6 +542,22 @@ static void Cookies_init(void)
    Cookies_load_cookies(file_stream);
 }
 
+/*
+ * Format the cookies.txt line for 'cookie' into 'buf' (LINE_MAXLEN long).
+ * Return value: the line length, LINE_MAXLEN or more if it doesn't fit.
+ */
+static int Cookies_format_line(char *buf, CookieData_t *cookie, long expiry)
+{
+   return snprintf(buf, LINE_MAXLEN, "%s\t%s\t%s\t%s\t%ld\t%s\t%s\n",
+                   cookie->domain,
+                   cookie->host_only ? "FALSE" : "TRUE",
+                   cookie->path,
+                   cookie->secure ? "TRUE" : "FALSE",
+                   expiry,
+                   cookie->name,
+                   cookie->value);
+}
+
 /*
  * Flush cookies to disk and free all the memory allocated.
  */
@@ -416,15 +590,9 @@ static void Cookies_save_and_free(void)
             int len;
             char buf[LINE_MAXLEN];
 
-            len = snprintf(buf, LINE_MAXLEN, "%s\t%s\t%s\t%s\t%ld\t%s\t%s\n",
-                           cookie->domain,
-                           cookie->host_only ? "FALSE" : "TRUE",
-                           cookie->path,
-                           cookie->secure ? "TRUE" : "FALSE",
-                           (long) difftime(cookie->expires_at,
-                                           cookies_epoch_time),
-                           cookie->name,
-                           cookie->value);
+            len = Cookies_format_line(buf, cookie,
+                                      (long) difftime(cookie->expires_at,
+                                                      cookies_epoch_time));
             if (len < LINE_MAXLEN) {
                fprintf(file_stream, "%s", buf);
                saved++;
@@ -438,6 +606,9 @@ static void Cookies_save_and_free(void)
    }
    dList_free(domains);
    dList_free(all_cookies);
+   Domain_trie_free(domain_trie);
+   /* the journal is part of what was just saved */
+   dStr_free(journal, TRUE);
 
 #ifdef HAVE_LOCKF
    lockf(fd, F_ULOCK, 0);
@@ -454,6 +625,80 @@ static void Cookies_save_and_free(void)
    MSG("Cookies saved: %d.\n", saved);
 }
 
+/*
+ * Append the journal to cookies.txt.
+ */
+static void Cookies_journal_flush(void)
+{
+   if (disabled || journal->len == 0)
+      return;
+
+   if (fseek(file_stream, 0, SEEK_END) == -1 ||
+       fwrite(journal->str, (size_t)journal->len, 1, file_stream) != 1 ||
+       fflush(file_stream) == EOF) {
+      MSG("Cookies: Journal write failed: %s\n", dStrerror(errno));
+   }
+   _MSG("Cookies journal flushed: %d bytes.\n", journal->len);
+   dStr_truncate(journal, 0);
+}
+
+/*
+ * Journal a cookie that is about to be added, so that it survives a crash.
+ * When loading, a later line replaces the cookies that an earlier one set,
+ * and an expired one just removes them.
+ */
+static void Cookies_journal_add(CookieData_t *cookie)
+{
+   char buf[LINE_MAXLEN];
+   DomainNode *node;
+   CookieData_t *c;
+   long expiry = 0;  /* already expired */
+   int len;
+
+   if (cookie->session_only) {
+      /* only a persistent cookie that it replaces needs to be removed */
+      if (!(node = Cookies_find_node(cookie->domain)) ||
+          !(c = dList_find_custom(node->cookies, cookie, Cookies_cmp)) ||
+          c->session_only)
+         return;
+   } else if (cookie->expires_at != (time_t) -1) {
+      expiry = MAX(0, (long) difftime(cookie->expires_at,
+                                      cookies_epoch_time));
+   }
+
+   len = Cookies_format_line(buf, cookie, expiry);
+   if (len < LINE_MAXLEN) {
+      if (journal->len == 0)
+         journal_since = time(NULL);
+      dStr_append_l(journal, buf, len);
+   }
+}
+
+/*
+ * Wait until a client connects to 'fd'. Meanwhile, flush the journal as
+ * soon as it's JOURNAL_FLUSH_DELAY seconds old.
+ */
+static void Cookies_wait_client(int fd)
+{
+   fd_set fds;
+   struct timeval tv;
+   long left;
+
+   while (!disabled && journal->len) {
+      left = JOURNAL_FLUSH_DELAY - (long) difftime(time(NULL), journal_since);
+      if (left <= 0) {
+         Cookies_journal_flush();
+         break;
+      }
+      FD_ZERO(&fds);
+      FD_SET(fd, &fds);
+      tv.tv_sec = left;
+      tv.tv_usec = 0;
+      if (select(fd + 1, &fds, NULL, NULL, &tv) != 0)
+         break;   /* a client is waiting (or select failed) */
+   }
+}
+
 /*
  * Month parsing
  */
@@ -685,8 +930,7 @@ static int Cookies_rm_expired_cookies(DomainNode *node)
       CookieData_t *c = dList_nth_data(cookies, i);
 
       if (difftime(c->expires_at, now) < 0) {
-         DomainNode *currnode = node ? node :
-              dList_find_sorted(domains, c->domain, Domain_node_by_domain_cmp);
+         DomainNode *currnode = node ? node : Cookies_find_node(c->domain);
          dList_remove(currnode->cookies, c);
          if (dList_length(currnode->cookies) == 0)
             Cookies_delete_node(currnode);
@@ -713,7 +957,7 @@ static void Cookies_too_many(DomainNode *node)
        "Removing LRU cookie for \'%s\': \'%s=%s\'\n", lru->domain,
        lru->name, lru->value);
    if (!node)
-      node = dList_find_sorted(domains, lru->domain,Domain_node_by_domain_cmp);
+      node = Cookies_find_node(lru->domain);
 
    dList_remove(node->cookies, lru);
    dList_remove_fast(all_cookies, lru);
@@ -728,7 +972,7 @@ static void Cookies_add_cookie(CookieData_t *cookie)
    CookieData_t *c;
    DomainNode *node;
 
-   node = dList_find_sorted(domains, cookie->domain,Domain_node_by_domain_cmp);
+   node = Cookies_find_node(cookie->domain);
    domain_cookies = (node) ? node->cookies : NULL;
 
    if (domain_cookies) {
@@ -757,8 +1001,7 @@ static void Cookies_add_cookie(CookieData_t *cookie)
             Cookies_too_many(node);
          } else if (removed >= MAX_DOMAIN_COOKIES) {
             /* So many were removed that the node might have been deleted. */
-            node = dList_find_sorted(domains, cookie->domain,
-                                                    Domain_node_by_domain_cmp);
+            node = Cookies_find_node(cookie->domain);
             domain_cookies = (node) ? node->cookies : NULL;
          }
       }
@@ -767,8 +1010,7 @@ static void Cookies_add_cookie(CookieData_t *cookie)
             Cookies_too_many(NULL);
          } else if (domain_cookies) {
             /* Our own node might have just been deleted. */
-            node = dList_find_sorted(domains, cookie->domain,
-                                                    Domain_node_by_domain_cmp);
+            node = Cookies_find_node(cookie->domain);
             domain_cookies = (node) ? node->cookies : NULL;
          }
       }
@@ -779,15 +1021,10 @@ static void Cookies_add_cookie(CookieData_t *cookie)
       dList_append(all_cookies, cookie);
 
       if (!domain_cookies) {
-         domain_cookies = dList_new(5);
-         dList_append(domain_cookies, cookie);
-         node = dNew(DomainNode, 1);
-         node->domain = dStrdup(cookie->domain);
-         node->cookies = domain_cookies;
-         dList_insert_sorted(domains, node, Domain_node_cmp);
-      } else {
-         dList_append(domain_cookies, cookie);
+         node = Cookies_new_node(cookie->domain);
+         domain_cookies = node->cookies;
       }
+      dList_append(domain_cookies, cookie);
    }
    if (domain_cookies && (dList_length(domain_cookies) == 0))
       Cookies_delete_node(node);
@@ -1236,6 +1473,7 @@ static int Cookies_set(char *cookie_string, char *url_host,
             Cookies_validate_path(cookie, url_path);
             if (action == COOKIE_ACCEPT_SESSION)
                cookie->session_only = TRUE;
+            Cookies_journal_add(cookie);
             Cookies_add_cookie(cookie);
             ret = 0;
          } else {
@@ -1270,14 +1508,12 @@ static bool_t Cookies_match(CookieData_t *cookie, const char *url_path,
    return TRUE;
 }
 
-static void Cookies_add_matching_cookies(const char *domain,
+static void Cookies_add_matching_cookies(DomainNode *node,
                                          const char *url_path,
                                          bool_t host_only_val,
                                          Dlist *matching_cookies,
                                          bool_t is_tls)
 {
-   DomainNode *node = dList_find_sorted(domains, domain,
-                                        Domain_node_by_domain_cmp);
    if (node) {
       int i;
       CookieData_t *cookie;
@@ -1321,13 +1557,14 @@ static void Cookies_add_matching_cookies(const char *domain,
 static char *Cookies_get(char *url_host, char *url_path,
                          char *url_scheme)
 {
-   char *domain_str, *str;
+   char *str;
    CookieData_t *cookie;
    Dlist *matching_cookies;
+   DomainTrie *host_trie[MAX_DOMAIN_LABELS], *host, *t;
    bool_t is_tls, is_ip_addr, host_only_val;
 
    Dstr *cookie_dstring;
-   int i;
+   int i, depth;
 
    if (disabled)
       return dStrdup("");
@@ -1346,39 +1583,50 @@ static char *Cookies_get(char *url_host, char *url_path,
     * attrs can have leading dots, which should be ignored for matching
     * purposes.
     */
+   /* A single walk down the domain trie gets the entries for url_host and
+    * all of its parent domains (host_trie[0] is the top level domain).
+    * Note that matching may delete nodes, so they're read at each call,
+    * and the trie entries left empty are only removed at the end.
+    */
+   if ((t = Domain_trie_walk(url_host, FALSE, host_trie, &depth)))
+      --depth;  /* i.e., leave url_host's own entry out of the parents */
+   /* the deepest entry found, where pruning starts */
+   host = t ? t : depth > 0 ? host_trie[depth - 1] : NULL;
+   domain_trie_busy = TRUE;
+
    host_only_val = FALSE;
-   if (!is_ip_addr) {
+   if (t && !is_ip_addr) {
       /* e.g., sub.example.com set a cookie with domain ".sub.example.com". */
-      domain_str = dStrconcat(".", url_host, NULL);
-      Cookies_add_matching_cookies(domain_str, url_path, host_only_val,
+      Cookies_add_matching_cookies(t->dot_node, url_path, host_only_val,
+                                   matching_cookies, is_tls);
+   }
+   if (t) {
+      host_only_val = TRUE;
+      /* e.g., sub.example.com set a cookie with no domain attribute. */
+      Cookies_add_matching_cookies(t->node, url_path, host_only_val,
+                                   matching_cookies, is_tls);
+      host_only_val = FALSE;
+      /* e.g., sub.example.com set a cookie with domain "sub.example.com". */
+      Cookies_add_matching_cookies(t->node, url_path, host_only_val,
                                    matching_cookies, is_tls);
-      dFree(domain_str);
    }
-   host_only_val = TRUE;
-   /* e.g., sub.example.com set a cookie with no domain attribute. */
-   Cookies_add_matching_cookies(url_host, url_path, host_only_val,
-                                matching_cookies, is_tls);
-   host_only_val = FALSE;
-   /* e.g., sub.example.com set a cookie with domain "sub.example.com". */
-   Cookies_add_matching_cookies(url_host, url_path, host_only_val,
-                                matching_cookies, is_tls);
 
    if (!is_ip_addr) {
-      for (domain_str = strchr(url_host+1, '.');
-           domain_str != NULL && *domain_str;
-           domain_str = strchr(domain_str+1, '.')) {
+      while (depth > 0) {
+         t = host_trie[--depth];
          /* e.g., sub.example.com set a cookie with domain ".example.com". */
-         Cookies_add_matching_cookies(domain_str, url_path, host_only_val,
+         Cookies_add_matching_cookies(t->dot_node, url_path, host_only_val,
+                                      matching_cookies, is_tls);
+         /* e.g., sub.example.com set a cookie with domain "example.com".*/
+         Cookies_add_matching_cookies(t->node, url_path, host_only_val,
                                       matching_cookies, is_tls);
-         if (domain_str[1]) {
-            domain_str++;
-            /* e.g., sub.example.com set a cookie with domain "example.com".*/
-            Cookies_add_matching_cookies(domain_str, url_path, host_only_val,
-                                         matching_cookies, is_tls);
-         }
       }
    }
 
+   domain_trie_busy = FALSE;
+   if (host)
+      Domain_trie_prune(host);
+
    /* Found the cookies, now make the string */
    cookie_dstring = dStr_new("");
    if (dList_length(matching_cookies) > 0) {
@@ -1665,6 +1913,7 @@ int main(void) {
    address_size = sizeof(struct sockaddr_in);
 
    while (1) {
+      Cookies_wait_client(STDIN_FILENO);
       sock_fd = accept(STDIN_FILENO, (struct sockaddr *)&sin, &address_size);
       if (sock_fd == -1) {
          perror("[accept]");
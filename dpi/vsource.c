@@ -28,6 +28,11 @@
 #define _MSG(...)
 #define MSG(...)  fprintf(stderr, "[vsource dpi]: " __VA_ARGS__)
 
+/*
+ * Amount of escaped output collected before it's written to the socket.
+ */
+#define VS_CHUNK_SIZE (16 * 1024)
+
 /*---------------------------------------------------------------------------*/
 
 const char *DOCTYPE=
@@ -98,18 +103,24 @@ void send_numbered_text(Dsh *sh, int data_size)
    }
 }
 
+/*
+ * Buffered write that hands the data to the socket in VS_CHUNK_SIZE pieces,
+ * so the output of large sources is neither held in memory nor delayed
+ * until the whole document has been escaped.
+ */
+static void Vs_write(Dsh *sh, const char *data, int len)
+{
+   a_Dpip_dsh_write(sh, sh->wrbuf->len + len >= VS_CHUNK_SIZE, data, len);
+}
+
 /*
  * Send source as html text with line numbers
  * (handles embedded null chars correctly).
  */
 void send_html_text(Dsh *sh, const char *url, int data_size)
 {
-   int bytes_read = 0, old_line = 0, line = 1, token_size = 0;
-   char *p, *q, *token, line_str[128];
-
-   if (dStrnAsciiCasecmp(url, "dpi:", 4) == 0 &&
-       strncmp(url+4, "/vsource/:", 10) == 0)
-      url += 14;
+   int bytes_read = 0, line = 1, token_size = 0, new_line = 1, skip_lf = 0;
+   char *p, *q, *end, *token, line_str[128];
 
    /* Send HTTP header for html text MIME type */
    a_Dpip_dsh_write_str(sh, 0, "Content-type: text/html\n\n");
@@ -141,37 +152,44 @@ void send_html_text(Dsh *sh, const char *url, int data_size)
                      "</style>\n"
                      "</head>\n"
                      "<body id=\"dillo_vs\">\n<table cellspacing='0' cellpadding='0'>\n", url);
+   /* Let the header through before the first (possibly slow) chunk */
+   a_Dpip_dsh_write(sh, 1, "", 0);
 
    while (bytes_read < data_size &&
           (token = a_Dpip_dsh_read_token2(sh, 1, &token_size))) {
       bytes_read += token_size;
-      p = q = token;
+      q = token;
+      end = token + token_size;
 
-      while (*p) {
-         if (line > old_line) {
+      /* A CR LF pair may straddle two tokens */
+      if (skip_lf && q < end && *q == '\n')
+         Vs_write(sh, q++, 1);
+      skip_lf = 0;
+
+      for (p = q; p < end; ++p) {
+         if (new_line) {
             snprintf(line_str, 128,
                      "<tr><td class='num' id='L%d'><a href='#L%d'>%d</a><td class='src'>",
                      line, line, line);
-            a_Dpip_dsh_write_str(sh, 0, line_str);
-            old_line = line;
+            Vs_write(sh, line_str, strlen(line_str));
+            new_line = 0;
          }
-         if ((p = strpbrk(q, "\r\n<&"))) {
-            if (*p == '\r' || *p == '\n') {
-               a_Dpip_dsh_write(sh, 0, q, p - q + 1);
-               if (*p == '\r' && p[1] == '\n')
-                  p++;
-               ++line;
-            } else {
-               a_Dpip_dsh_write(sh, 0, q, p - q);
-               a_Dpip_dsh_write_str(sh, 0, (*p == '<') ? "&lt;" : "&amp;");
-            }
-         } else { 
-            /* send all the rest */
-            a_Dpip_dsh_write(sh, 1, q, token_size - (q - token));
-            break;
+         if (*p == '\r' || *p == '\n') {
+            if (*p == '\r' && p + 1 < end && p[1] == '\n')
+               ++p;
+            else if (*p == '\r' && p + 1 == end)
+               skip_lf = 1;
+            Vs_write(sh, q, p - q + 1);
+            q = p + 1;
+            ++line;
+            new_line = 1;
+         } else if (*p == '<' || *p == '&') {
+            Vs_write(sh, q, p - q);
+            Vs_write(sh, (*p == '<') ? "&lt;" : "&amp;", (*p == '<') ? 4 : 5);
+            q = p + 1;
          }
-         q = ++p;
       }
+      Vs_write(sh, q, end - q);
       dFree(token);
    }
 
@@ -186,7 +204,8 @@ int main(void)
    Dsh *sh;
    int data_size;
    char *dpip_tag, *cmd = NULL, *cmd2 = NULL, *url = NULL, *size_str = NULL;
-   char *d_cmd;
+   char *d_cmd, *p;
+   const char *src_url, *flavour;
 
    _MSG("starting...\n");
    //sleep(20);
@@ -234,10 +253,20 @@ int main(void)
       if (strcmp(cmd2, "start_send_page") == 0 &&
           (size_str = a_Dpip_get_attr(dpip_tag, "data_size"))) {
          data_size = strtol(size_str, NULL, 10);
-         /* Choose your flavour */
-         //send_plain_text(sh, data_size);
+         /* Choose your flavour: "dpi:/vsource/plain:<url>" skips the
+          * line-numbered table, which is a lot lighter to lay out */
+         src_url = url ? url : "";
+         flavour = "";
+         if (dStrnAsciiCasecmp(src_url, "dpi:/vsource/", 13) == 0 &&
+             (p = strchr(src_url + 13, ':'))) {
+            flavour = src_url + 13;
+            src_url = p + 1;
+         }
          //send_numbered_text(sh, data_size);
-         send_html_text(sh, url, data_size);
+         if (strncmp(flavour, "plain:", 6) == 0)
+            send_plain_text(sh, data_size);
+         else
+            send_html_text(sh, src_url, data_size);
       } else if (strcmp(cmd2, "DpiError") == 0) {
          /* Dillo detected an error (other failures just close the socket) */
          a_Dpip_dsh_write_str(sh, 0, "Content-type: text/plain\n\n");
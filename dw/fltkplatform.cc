@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <math.h>
 
 #include "dlib/dlib.h"
 #include "../lout/msg.h"
@@ -114,6 +115,7 @@ FltkFont::FltkFont (core::style::FontAttrs *attrs)
       family = &standardFontFamily;
 
    font = family->get (fa);
+   glyphWidths = smallCapsGlyphWidths = NULL;
 
    fl_font(font, size);
    // WORKAROUND: A bug with fl_width(uint_t) on non-xft X was present in
@@ -125,13 +127,55 @@ FltkFont::FltkFont (core::style::FontAttrs *attrs)
    zeroWidth = (int) fl_width("0");
    descent = fl_descent();
    ascent = fl_height() - descent;
+   sumGlyphWidths = glyphWidthsAdd ();
 }
 
 FltkFont::~FltkFont ()
 {
+   delete glyphWidths;
+   delete smallCapsGlyphWidths;
    fontsTable->remove (this);
 }
 
+FltkFont::GlyphWidths::GlyphWidths (Fl_Font font, int size)
+{
+   this->font = font;
+   this->size = size;
+   for (int i = 0; i < 256; i++)
+      latin1[i] = -1;
+   for (int i = 0; i < otherSize; i++)
+      other[i].c = -1;
+}
+
+float FltkFont::GlyphWidths::measure (int c)
+{
+   char buf[4];
+   int nb = fl_utf8encode (c, buf);
+
+   // WORKAROUND: A bug with fl_width(uint_t) on non-xft X was present in
+   // 1.3.0 (STR #2688).
+   fl_font (font, size);
+   return fl_width (buf, nb);
+}
+
+/**
+ * Whether fl_width () of a string is the sum of fl_width () of its
+ * characters in the current font, for some pairs that are kerned or
+ * joined into a ligature where the backend does that.
+ */
+static bool glyphWidthsAdd ()
+{
+   static const char *const pairs[] = { "AV", "To", "Wa", "LT", "fi" };
+
+   for (unsigned i = 0; i < sizeof (pairs) / sizeof (pairs[0]); i++) {
+      double w = fl_width (pairs[i], 2),
+         sum = fl_width (pairs[i], 1) + fl_width (pairs[i] + 1, 1);
+      if (fabs (w - sum) > 0.01)
+         return false;
+   }
+   return true;
+}
+
 static void strstrip(char *big, const char *little)
 {
    if (strlen(big) >= strlen(little) &&
@@ -519,42 +563,63 @@ int FltkPlatform::textWidth (core::style::Font *font, const char *text,
    FltkFont *ff = (FltkFont*) font;
    int curr = 0, next = 0, nb;
 
+   /* The glyph widths are taken from the font where that gives the same
+    * result as fl_width (), see FltkFont::simpleGlyph () and
+    * FltkFont::sumGlyphWidths. Small caps are measured glyph by glyph
+    * anyway. */
    if (font->fontVariant == core::style::FONT_VARIANT_SMALL_CAPS) {
       int sc_fontsize = lout::misc::roundInt(ff->size * 0.78);
       for (curr = 0; next < len; curr = next) {
-         next = nextGlyph(text, curr);
+         next = fl_utf8fwd(text + curr + 1, text, text + len) - text;
          c = fl_utf8decode(text + curr, text + next, &nb);
          if ((cu = fl_toupper(c)) == c) {
             /* already uppercase, just draw the character */
-            fl_font(ff->font, ff->size);
             if (fl_nonspacing(cu) == 0) {
                width += font->letterSpacing;
-               width += (int)fl_width(text + curr, next - curr);
+               if (FltkFont::simpleGlyph(cu)) {
+                  width += (int)ff->glyphWidth(cu);
+               } else {
+                  fl_font(ff->font, ff->size);
+                  width += (int)fl_width(text + curr, next - curr);
+               }
             }
          } else {
-            /* make utf8 string for converted char */
-            nb = fl_utf8encode(cu, chbuf);
-            fl_font(ff->font, sc_fontsize);
             if (fl_nonspacing(cu) == 0) {
                width += font->letterSpacing;
-               width += (int)fl_width(chbuf, nb);
+               if (FltkFont::simpleGlyph(cu)) {
+                  width += (int)ff->smallCapsGlyphWidth(cu);
+               } else {
+                  /* make utf8 string for converted char */
+                  nb = fl_utf8encode(cu, chbuf);
+                  fl_font(ff->font, sc_fontsize);
+                  width += (int)fl_width(chbuf, nb);
+               }
             }
          }
       }
    } else {
-      fl_font (ff->font, ff->size);
-      width = (int) fl_width (text, len);
-
-      if (font->letterSpacing) {
-         int curr = 0, next = 0;
+      double sum = 0.0;
+      bool simple = ff->sumGlyphWidths;
 
-         while (next < len) {
-            next = nextGlyph(text, curr);
-            c = fl_utf8decode(text + curr, text + next, &nb);
-            if (fl_nonspacing(c) == 0)
-               width += font->letterSpacing;
-            curr = next;
+      for (curr = 0; next < len && (simple || font->letterSpacing);
+           curr = next) {
+         next = fl_utf8fwd(text + curr + 1, text, text + len) - text;
+         c = fl_utf8decode(text + curr, text + next, &nb);
+         if (simple) {
+            if (FltkFont::simpleGlyph(c))
+               sum += ff->glyphWidth(c);
+            else
+               simple = false;
          }
+         if (font->letterSpacing && fl_nonspacing(c) == 0)
+            width += font->letterSpacing;
+      }
+
+      if (simple) {
+         width += (int) sum;
+      } else {
+         fl_font (ff->font, ff->size);
+         width += (int) fl_width (text, len);
       }
    }
 
@@ -23,6 +23,45 @@ class FltkFont: public core::style::Font
          Fl_Font get (int attrs);
    };
 
+   /**
+    * \brief The advance widths of the glyphs of a font, as fl_width ()
+    * returns them, measured when they are first needed.
+    *
+    * Latin-1 is looked up directly, other characters in a small hash
+    * table, where a new character replaces the old one.
+    */
+   class GlyphWidths {
+         enum { otherSize = 256 };
+
+         Fl_Font font;
+         int size;
+         float latin1[256];   /* < 0 when not measured yet */
+         struct {
+            int c;
+            float width;
+         } other[otherSize];
+
+         float measure (int c);
+
+      public:
+         GlyphWidths (Fl_Font font, int size);
+
+         inline float get (int c) {
+            if (c < 256) {
+               if (latin1[c] < 0)
+                  latin1[c] = measure (c);
+               return latin1[c];
+            } else {
+               int i = ((unsigned) c * 2654435761u) >> 24;
+               if (other[i].c != c) {
+                  other[i].c = c;
+                  other[i].width = measure (c);
+               }
+               return other[i].width;
+            }
+         }
+   };
+
    static FontFamily standardFontFamily;
 
    static lout::container::typed::HashTable <lout::object::ConstString,
@@ -35,12 +74,51 @@ class FltkFont: public core::style::Font
 
    static void initSystemFonts ();
 
+   GlyphWidths *glyphWidths, *smallCapsGlyphWidths;
+
 public:
    Fl_Font font;
 
+   /**
+    * \brief Whether the width of a text in this font is the sum of the
+    * widths of its glyphs, so that textWidth () can add them up.
+    *
+    * It's not where the backend kerns or joins glyphs into ligatures
+    * (e.g. Pango/Cairo), which is tested with a few pairs of characters
+    * when the font is created. See also simpleGlyph ().
+    */
+   bool sumGlyphWidths;
+
    static FltkFont *create (core::style::FontAttrs *attrs);
    static bool fontExists (const char *name);
    static Fl_Font get (const char *name, int attrs);
+
+   /**
+    * \brief Whether the width of a text is the sum of the widths of its
+    * glyphs with this character, so that glyphWidth () can be used.
+    *
+    * This holds for Latin, Greek and Cyrillic letters and common
+    * punctuation, but not for combining marks, and not for the scripts
+    * that need shaping.
+    */
+   static inline bool simpleGlyph (int c) {
+      return c < 0x0300 || (c >= 0x0370 && c < 0x0483) ||
+             (c >= 0x048a && c < 0x0590) || (c >= 0x2010 && c < 0x2028);
+   }
+
+   inline float glyphWidth (int c) {
+      if (glyphWidths == NULL)
+         glyphWidths = new GlyphWidths (font, size);
+      return glyphWidths->get (c);
+   }
+
+   /** As glyphWidth (), in the size that small-caps uses. */
+   inline float smallCapsGlyphWidth (int c) {
+      if (smallCapsGlyphWidths == NULL)
+         smallCapsGlyphWidths =
+            new GlyphWidths (font, lout::misc::roundInt (size * 0.78));
+      return smallCapsGlyphWidths->get (c);
+   }
 };
 
 
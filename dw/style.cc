@@ -155,8 +155,10 @@ bool StyleAttrs::sizeDiffs (StyleAttrs *otherStyle)
 bool StyleAttrs::equals (object::Object *other) {
    StyleAttrs *otherAttrs = (StyleAttrs *) other;
 
+   /* The fields that tell styles apart most often come first. */
    return this == otherAttrs ||
       (font == otherAttrs->font &&
+       x_link == otherAttrs->x_link &&
        textDecoration == otherAttrs->textDecoration &&
        color == otherAttrs->color &&
        backgroundColor == otherAttrs->backgroundColor &&
@@ -206,68 +208,89 @@ bool StyleAttrs::equals (object::Object *other) {
        listStyleType == otherAttrs->listStyleType &&
        cursor == otherAttrs->cursor &&
        zIndex == otherAttrs->zIndex &&
-       x_link == otherAttrs->x_link &&
        x_lang[0] == otherAttrs->x_lang[0] &&
        x_lang[1] == otherAttrs->x_lang[1] &&
        x_img == otherAttrs->x_img &&
        x_tooltip == otherAttrs->x_tooltip);
 }
 
+/* Mix one more value into a hash. Unlike with a plain sum, the position
+ * of each value counts, so that e.g. swapped margins don't collide. */
+static inline unsigned int hashMix (unsigned int h, intptr_t v)
+{
+   return (h ^ (unsigned int) v ^ (unsigned int) ((uint64_t) v >> 32))
+      * 16777619;
+}
+
 int StyleAttrs::hashValue () {
-   return (intptr_t) font +
-      textDecoration +
-      (intptr_t) color +
-      (intptr_t) backgroundColor +
-      (intptr_t) backgroundImage +
-      backgroundRepeat +
-      backgroundAttachment +
-      backgroundPositionX +
-      backgroundPositionY +
-      textAlign +
-      valign +
-      textAlignChar +
-      textTransform +
-      vloat +
-      clear +
-      overflow +
-      position +
-      top +
-      bottom +
-      left +
-      right +
-      hBorderSpacing +
-      vBorderSpacing +
-      wordSpacing +
-      width +
-      height +
-      minWidth +
-      maxWidth +
-      minHeight +
-      maxHeight +
-      lineHeight +
-      textIndent +
-      margin.hashValue () +
-      borderWidth.hashValue () +
-      padding.hashValue () +
-      borderCollapse +
-      (intptr_t) borderColor.top +
-      (intptr_t) borderColor.right +
-      (intptr_t) borderColor.bottom +
-      (intptr_t) borderColor.left +
-      borderStyle.top +
-      borderStyle.right +
-      borderStyle.bottom +
-      borderStyle.left +
-      display +
-      whiteSpace +
-      listStylePosition +
-      listStyleType +
-      cursor +
-      zIndex +
-      x_link +
-      x_lang[0] + x_lang[1] +
-      x_img +
-      (intptr_t) x_tooltip;
+   unsigned int h = 2166136261u;
+
+   h = hashMix (h, (intptr_t) font);
+   h = hashMix (h, (intptr_t) textDecoration);
+   h = hashMix (h, (intptr_t) color);
+   h = hashMix (h, (intptr_t) backgroundColor);
+   h = hashMix (h, (intptr_t) backgroundImage);
+   h = hashMix (h, (intptr_t) backgroundRepeat);
+   h = hashMix (h, (intptr_t) backgroundAttachment);
+   h = hashMix (h, (intptr_t) backgroundPositionX);
+   h = hashMix (h, (intptr_t) backgroundPositionY);
+   h = hashMix (h, (intptr_t) textAlign);
+   h = hashMix (h, (intptr_t) valign);
+   h = hashMix (h, (intptr_t) textAlignChar);
+   h = hashMix (h, (intptr_t) textTransform);
+   h = hashMix (h, (intptr_t) vloat);
+   h = hashMix (h, (intptr_t) clear);
+   h = hashMix (h, (intptr_t) overflow);
+   h = hashMix (h, (intptr_t) position);
+   h = hashMix (h, (intptr_t) top);
+   h = hashMix (h, (intptr_t) bottom);
+   h = hashMix (h, (intptr_t) left);
+   h = hashMix (h, (intptr_t) right);
+   h = hashMix (h, (intptr_t) hBorderSpacing);
+   h = hashMix (h, (intptr_t) vBorderSpacing);
+   h = hashMix (h, (intptr_t) wordSpacing);
+   h = hashMix (h, (intptr_t) width);
+   h = hashMix (h, (intptr_t) height);
+   h = hashMix (h, (intptr_t) minWidth);
+   h = hashMix (h, (intptr_t) maxWidth);
+   h = hashMix (h, (intptr_t) minHeight);
+   h = hashMix (h, (intptr_t) maxHeight);
+   h = hashMix (h, (intptr_t) lineHeight);
+   h = hashMix (h, (intptr_t) textIndent);
+   h = hashMix (h, (intptr_t) margin.top);
+   h = hashMix (h, (intptr_t) margin.right);
+   h = hashMix (h, (intptr_t) margin.bottom);
+   h = hashMix (h, (intptr_t) margin.left);
+   h = hashMix (h, (intptr_t) borderWidth.top);
+   h = hashMix (h, (intptr_t) borderWidth.right);
+   h = hashMix (h, (intptr_t) borderWidth.bottom);
+   h = hashMix (h, (intptr_t) borderWidth.left);
+   h = hashMix (h, (intptr_t) padding.top);
+   h = hashMix (h, (intptr_t) padding.right);
+   h = hashMix (h, (intptr_t) padding.bottom);
+   h = hashMix (h, (intptr_t) padding.left);
+   h = hashMix (h, (intptr_t) borderCollapse);
+   h = hashMix (h, (intptr_t) borderColor.top);
+   h = hashMix (h, (intptr_t) borderColor.right);
+   h = hashMix (h, (intptr_t) borderColor.bottom);
+   h = hashMix (h, (intptr_t) borderColor.left);
+   h = hashMix (h, (intptr_t) borderStyle.top);
+   h = hashMix (h, (intptr_t) borderStyle.right);
+   h = hashMix (h, (intptr_t) borderStyle.bottom);
+   h = hashMix (h, (intptr_t) borderStyle.left);
+   h = hashMix (h, (intptr_t) display);
+   h = hashMix (h, (intptr_t) whiteSpace);
+   h = hashMix (h, (intptr_t) listStylePosition);
+   h = hashMix (h, (intptr_t) listStyleType);
+   h = hashMix (h, (intptr_t) cursor);
+   h = hashMix (h, (intptr_t) zIndex);
+   h = hashMix (h, (intptr_t) x_link);
+   h = hashMix (h, (intptr_t) x_lang[0]);
+   h = hashMix (h, (intptr_t) x_lang[1]);
+   h = hashMix (h, (intptr_t) x_img);
+   h = hashMix (h, (intptr_t) x_tooltip);
+
+   return (int) (h ^ (h >> 16));
 }
 
 int Style::totalRef = 0;
@@ -2639,6 +2639,61 @@ void Textblock::addBreakOption (core::style::Style *style, bool forceBreak)
    DBG_OBJ_LEAVE ();
 }
 
+/**
+ * Add a run of words, spaces and break options, all in the same style.
+ *
+ * This does the same as calling addText(), addSpace() and addBreakOption()
+ * for each item, but what only depends on the style is calculated once, and
+ * words that cannot contain dividing characters skip the search for them.
+ * Line breaking still looks at one word after the other, since it may
+ * hyphenate words before the one just added.
+ */
+void Textblock::addTextRun (const char *text, const TextRunItem *items,
+                            int numItems, core::style::Style *style)
+{
+   DBG_OBJ_ENTER ("construct.word", 0, "addTextRun", "..., %d, %p",
+                  numItems, style);
+
+   core::Requisition size;
+   bool sizeValid = false;
+
+   for (int i = 0; i < numItems; i++) {
+      const TextRunItem *item = &items[i];
+      const char *word = text + item->start;
+
+      switch (item->type) {
+      case TextRunItem::TEXT:
+         // All dividing characters start with one of these bytes.
+         if (memchr (word, '-', item->len) ||
+             memchr (word, '\xc2', item->len) ||
+             memchr (word, '\xe2', item->len)) {
+            addText (word, item->len, style);
+         } else {
+            if (sizeValid)
+               size.width = textWidth (word, 0, item->len, style, true, true);
+            else {
+               calcTextSize (word, item->len, style, &size, true, true);
+               sizeValid = true;
+            }
+            addText0 (word, item->len,
+                      Word::CAN_BE_HYPHENATED | Word::WORD_START |
+                      Word::WORD_END, style, &size);
+         }
+         break;
+
+      case TextRunItem::SPACE:
+         addSpace (style);
+         break;
+
+      case TextRunItem::BREAK_OPTION:
+         addBreakOption (style, false);
+         break;
+      }
+   }
+
+   DBG_OBJ_LEAVE ();
+}
+
 void Textblock::fillSpace (int wordNo, core::style::Style *style)
 {
    DBG_OBJ_ENTER ("construct.word", 0, "fillSpace", "%d, ...", wordNo);
@@ -3001,7 +3056,10 @@ void Textblock::changeLinkColor (int link, int newColor)
       for (wordIdx = line->firstWord; wordIdx <= line->lastWord; wordIdx++){
          Word *word = words->getRef(wordIdx);
 
-         if (word->style->x_link == link) {
+         /* words that have the color already need no redraw */
+         if (word->style->x_link == link &&
+             !(word->style->color &&
+               word->style->color->getColor () == newColor)) {
             core::style::StyleAttrs styleAttrs;
 
             switch (word->content.type) {
@@ -864,6 +864,15 @@ protected:
    int getGeneratorRest (int oofmIndex);
 
 public:
+   /**
+    * \brief One piece of a run of text, see addTextRun().
+    */
+   struct TextRunItem
+   {
+      enum Type { TEXT, SPACE, BREAK_OPTION } type;
+      int start, len;   ///< Only for TEXT: the word in the run's text.
+   };
+
    static int CLASS_ID;
 
    static void setPenaltyHyphen (int penaltyHyphen);
@@ -891,6 +900,8 @@ public:
    bool addAnchor (const char *name, core::style::Style *style);
    void addSpace (core::style::Style *style);
    void addBreakOption (core::style::Style *style, bool forceBreak);
+   void addTextRun (const char *text, const TextRunItem *items, int numItems,
+                    core::style::Style *style);
    void addParbreak (int space, core::style::Style *style);
    void addLinebreak (core::style::Style *style);
 
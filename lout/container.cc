@@ -498,11 +498,11 @@ void HashSet::clearNode(HashSet::Node *node)
    }
 }
 
-HashSet::Node *HashSet::findNode(Object *object) const
+HashSet::Node *HashSet::findNode(Object *object, int hashValue) const
 {
-   int h = calcHashValue(object);
-   for (Node *node = table[h]; node; node = node->next) {
-      if (object->equals(node->object))
+   // Comparing the hash values first saves most calls of equals().
+   for (Node *node = table[calcSlot(hashValue)]; node; node = node->next) {
+      if (node->hashValue == hashValue && object->equals(node->object))
          return node;
    }
 
@@ -511,15 +511,21 @@ HashSet::Node *HashSet::findNode(Object *object) const
 
 HashSet::Node *HashSet::insertNode(Object *object)
 {
+   int hashValue = object->hashValue();
+
    // Look whether object is already contained.
-   Node *node = findNode(object);
+   Node *node = findNode(object, hashValue);
    if (node) {
       clearNode(node);
       numElements--;
    } else {
-      int h = calcHashValue(object);
+      if (numElements >= maxLoad * tableSize)
+         grow ();
+
+      int h = calcSlot(hashValue);
       node = createNode ();
       node->next = table[h];
+      node->hashValue = hashValue;
       table[h] = node;
       numElements++;
    }
@@ -528,6 +534,36 @@ HashSet::Node *HashSet::insertNode(Object *object)
    return node;
 }
 
+/**
+ * \brief Double the size of the table, so that the lists stay short.
+ *
+ * The nodes are moved to their new slots, using the hash values kept in
+ * them.
+ */
+void HashSet::grow()
+{
+   Node **oldTable = table;
+   int oldTableSize = tableSize;
+
+   tableSize = 2 * tableSize + 1;
+   table = new Node*[tableSize];
+   for (int i = 0; i < tableSize; i++)
+      table[i] = NULL;
+
+   for (int i = 0; i < oldTableSize; i++) {
+      Node *n1 = oldTable[i];
+      while (n1) {
+         Node *n2 = n1->next;
+         int h = calcSlot(n1->hashValue);
+         n1->next = table[h];
+         table[h] = n1;
+         n1 = n2;
+      }
+   }
+
+   delete[] oldTable;
+}
+
 
 void HashSet::put(Object *object)
 {
@@ -536,22 +572,16 @@ void HashSet::put(Object *object)
 
 bool HashSet::contains(Object *object) const
 {
-   int h = calcHashValue(object);
-   for (Node *n = table[h]; n; n = n->next) {
-      if (object->equals(n->object))
-         return true;
-   }
-
-   return false;
+   return findNode(object) != NULL;
 }
 
 bool HashSet::remove(Object *object)
 {
-   int h = calcHashValue(object);
+   int hashValue = object->hashValue(), h = calcSlot(hashValue);
    Node *last, *cur;
 
    for (last = NULL, cur = table[h]; cur; last = cur, cur = cur->next) {
-      if (object->equals(cur->object)) {
+      if (cur->hashValue == hashValue && object->equals(cur->object)) {
          if (last)
             last->next = cur->next;
          else
@@ -577,7 +607,7 @@ bool HashSet::remove(Object *object)
 
 /*Object *HashSet::getReference (Object *object)
 {
-   int h = calcHashValue(object);
+   int h = calcSlot(object->hashValue());
    for (Node *n = table[h]; n; n = n->next) {
       if (object->equals(n->object))
          return n->object;
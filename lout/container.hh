@@ -251,23 +251,35 @@ protected:
    {
       object::Object *object;
       Node *next;
+      int hashValue; // of object, so that it is not calculated again
       virtual ~Node() {};
    };
 
+   /**
+    * The table is enlarged when it holds more than maxLoad elements per
+    * slot on average.
+    */
+   enum { maxLoad = 2 };
+
    Node **table;
    int tableSize, numElements;
    bool ownerOfObjects;
 
-   inline int calcHashValue(object::Object *object) const
+   inline int calcSlot(int hashValue) const
    {
-      return abs(object->hashValue()) % tableSize;
+      return (unsigned int)hashValue % tableSize;
    }
 
    virtual Node *createNode();
    virtual void clearNode(Node *node);
 
-   Node *findNode(object::Object *object) const;
+   Node *findNode(object::Object *object, int hashValue) const;
+   inline Node *findNode(object::Object *object) const
+   {
+      return findNode(object, object->hashValue());
+   }
    Node *insertNode(object::Object *object);
+   void grow();
 
    AbstractIterator* createIterator();
 
@@ -630,7 +630,7 @@ public:
 class ZoneAllocator
 {
 private:
-   size_t poolSize, poolLimit, freeIdx;
+   size_t poolSize, poolLimit, freeIdx, allocated;
    SimpleVector <char*> *pools;
    SimpleVector <char*> *bulk;
 
@@ -639,6 +639,7 @@ public:
       this->poolSize = poolSize;
       this->poolLimit = poolSize / 4;
       this->freeIdx = poolSize;
+      this->allocated = 0;
       this->pools = new SimpleVector <char*> (1);
       this->bulk = new SimpleVector <char*> (1);
    };
@@ -652,6 +653,7 @@ public:
    inline void * zoneAlloc (size_t t) {
       void *ret;
 
+      allocated += t;
       if (t > poolLimit) {
          bulk->increase ();
          bulk->set (bulk->size () - 1, (char*) malloc (t));
@@ -669,6 +671,24 @@ public:
       return ret;
    }
 
+   /**
+    * \brief Like zoneAlloc(), but suitably aligned for any object, which
+    *    is needed when strings and objects share the zone.
+    */
+   inline void * zoneAllocAligned (size_t t) {
+      const size_t align = 2 * sizeof (void*);
+
+      freeIdx = (freeIdx + align - 1) & ~(align - 1);
+      if (freeIdx > poolSize)
+         freeIdx = poolSize;
+      return zoneAlloc ((t + align - 1) & ~(align - 1));
+   }
+
+   /**
+    * \brief Return the number of bytes handed out since the last zoneFree().
+    */
+   inline size_t zoneSize () { return allocated; }
+
    inline void zoneFree () {
       for (int i = 0; i < pools->size (); i++)
          free (pools->get (i));
@@ -677,6 +697,7 @@ public:
          free (bulk->get (i));
       bulk->setSize (0);
       freeIdx = poolSize;
+      allocated = 0;
    }
 
    inline const char *strndup (const char *str, size_t t) {
@@ -64,6 +64,7 @@ typedef struct {
    int ExpectedSize;         /**< Goal size of the HTTP transfer (0 if unknown)*/
    int TransferSize;         /**< Actual length of the HTTP transfer */
    uint_t Flags;             /**< See Flag Defines in cache.h */
+   uint_t Serial;            /**< Identifies the entry's current content */
 } CacheEntry_t;
 
 
@@ -73,6 +74,9 @@ typedef struct {
 /** A sorted list for cached data. Holds pointers to CacheEntry_t structs */
 static Dlist *CachedURLs;
 
+/** Source of CacheEntry_t.Serial values */
+static uint_t CacheSerial = 0;
+
 /** A list for cache clients.
  * Although implemented as a list, we'll call it ClientQueue  --Jcid */
 static Dlist *ClientQueue;
@@ -89,7 +93,8 @@ static uint_t DelayedQueueIdleId = 0;
 static CacheEntry_t *Cache_process_queue(CacheEntry_t *entry);
 static void Cache_delayed_process_queue(CacheEntry_t *entry);
 static void Cache_auth_entry(CacheEntry_t *entry, BrowserWindow *bw);
-static void Cache_entry_inject(const DilloUrl *Url, Dstr *data_ds);
+static void Cache_entry_inject(const DilloUrl *Url, Dstr *data_ds,
+                               int flag);
 
 /**
  * Determine if two cache entries are equal (used by CachedURLs)
@@ -125,7 +130,7 @@ void a_Cache_init(void)
    {
       DilloUrl *url = a_Url_new("about:splash", NULL);
       Dstr *ds = dStr_new(AboutSplash);
-      Cache_entry_inject(url, ds);
+      Cache_entry_inject(url, ds, CA_InternalUrl);
       dStr_free(ds, 1);
       a_Url_free(url);
    }
@@ -209,6 +214,7 @@ static void Cache_entry_init(CacheEntry_t *NewEntry, const DilloUrl *Url)
    NewEntry->ExpectedSize = 0;
    NewEntry->TransferSize = 0;
    NewEntry->Flags = CA_IsEmpty | CA_InProgress | CA_KeepAlive;
+   NewEntry->Serial = ++CacheSerial;
 }
 
 /**
@@ -264,21 +270,24 @@ static CacheEntry_t *Cache_entry_add(const DilloUrl *Url)
 
 /**
  * Inject full page content directly into the cache.
- * Used for "about:splash". May be used for "about:cache" too.
+ * Used for "about:splash" and "data:" URIs ('flag' tells which).
+ * May be used for "about:cache" too.
  */
-static void Cache_entry_inject(const DilloUrl *Url, Dstr *data_ds)
+static void Cache_entry_inject(const DilloUrl *Url, Dstr *data_ds,
+                               int flag)
 {
    CacheEntry_t *entry;
 
    if (!(entry = Cache_entry_search(Url)))
       entry = Cache_entry_add(Url);
-   entry->Flags = CA_GotHeader + CA_GotLength + CA_InternalUrl;
+   entry->Flags = CA_GotHeader + CA_GotLength + flag;
    if (data_ds->len)
       entry->Flags &= ~CA_IsEmpty;
    dStr_truncate(entry->Data, 0);
    dStr_append_l(entry->Data, data_ds->str, data_ds->len);
    dStr_fit(entry->Data);
    entry->ExpectedSize = entry->TransferSize = entry->Data->len;
+   entry->Serial = ++CacheSerial;
 }
 
 /**
@@ -359,6 +368,34 @@ void a_Cache_entry_remove_by_url(DilloUrl *url)
    Cache_entry_remove(NULL, url);
 }
 
+/**
+ * Wrapper for capi: inject a decoded "data:" URI.
+ * The entry is freed once nobody uses it (see Cache_entry_release).
+ */
+void a_Cache_entry_inject_data_url(const DilloUrl *url, Dstr *data_ds)
+{
+   Cache_entry_inject(url, data_ds, CA_DataUrl);
+}
+
+/**
+ * Free a "data:" URI entry when it has no clients and no data references
+ * left. It's cheap to decode again from the URL, and keeping every inline
+ * image of the session in memory is not.
+ */
+static void Cache_entry_release(CacheEntry_t *entry)
+{
+   int i;
+   CacheClient_t *Client;
+
+   if (!(entry->Flags & CA_DataUrl) || entry->DataRefcount > 0 ||
+       dList_find(DelayedQueue, entry))
+      return;
+   for (i = 0; (Client = dList_nth_data(ClientQueue, i)); ++i)
+      if (Client->Url == entry->Url)
+         return;
+   Cache_entry_remove(entry, NULL);
+}
+
 /* Misc. operations ------------------------------------------------------- */
 
 /**
@@ -418,6 +455,17 @@ uint_t a_Cache_get_flags_with_redirection(const DilloUrl *url)
    return (entry ? entry->Flags : 0);
 }
 
+/**
+ * Get a number that identifies the current content of the entry
+ * (following redirections), or 0 if it isn't cached.
+ * It changes when the entry is replaced or its charset changes.
+ */
+uint_t a_Cache_get_serial(const DilloUrl *url)
+{
+   CacheEntry_t *entry = Cache_entry_search_with_redirect(url);
+   return (entry ? entry->Serial : 0);
+}
+
 /**
  * Reference the cache data.
  */
@@ -538,6 +586,7 @@ const char *a_Cache_set_content_type(const DilloUrl *url, const char *ctype,
             /* Invalidate UTF8Data */
             dStr_free(entry->UTF8Data, 1);
             entry->UTF8Data = NULL;
+            entry->Serial = ++CacheSerial;
          }
          dFree(major); dFree(minor); dFree(charset);
       }
@@ -570,7 +619,11 @@ int a_Cache_get_buf(const DilloUrl *Url, char **PBuf, int *BufSize)
  */
 void a_Cache_unref_buf(const DilloUrl *Url)
 {
-   Cache_unref_data(Cache_entry_search_with_redirect(Url));
+   CacheEntry_t *entry = Cache_entry_search_with_redirect(Url);
+
+   Cache_unref_data(entry);
+   if (entry)
+      Cache_entry_release(entry);
 }
 
 
@@ -1369,6 +1422,7 @@ static void Cache_delayed_process_queue_callback(void *ptr)
       if ((entry = Cache_process_queue(entry))) {
          Cache_unref_data(entry);
          dList_remove(DelayedQueue, entry);
+         Cache_entry_release(entry);
       }
    }
    DelayedQueueIdleId = 0;
@@ -1436,6 +1490,9 @@ void a_Cache_stop_client(int Key)
       /* Main queue */
       Cache_client_dequeue(Client);
 
+      if (entry)
+         Cache_entry_release(entry);
+
    } else {
       _MSG("WARNING: Cache_stop_client, nonexistent client\n");
    }
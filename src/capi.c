@@ -33,6 +33,7 @@
 #include "domain.h"
 #include "../dpip/dpip.h"
 #include "prefs.h"
+#include "misc.h"
 
 /* for testing dpi chat */
 #include "bookmark.h"
@@ -343,6 +344,92 @@ static void Capi_dpi_send_source(BrowserWindow *bw, DilloUrl *url)
    dFree(cmd);
 }
 
+/**
+ * Value of an hex digit, or -1 if 'c' isn't one.
+ */
+static int Capi_hex_val(int c)
+{
+   return (c >= '0' && c <= '9') ? c - '0' :
+          (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+          (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+/**
+ * Percent-decode 'len' bytes of 'str' into a new Dstr.
+ * (Unlike a_Url_decode_hex_str(), %00 octets survive.)
+ */
+static Dstr *Capi_datauri_unescape(const char *str, size_t len)
+{
+   const char *p, *end = str + len;
+   Dstr *ds = dStr_sized_new((int)len);
+   int hi, lo;
+
+   while ((p = memchr(str, '%', end - str))) {
+      dStr_append_l(ds, str, p - str);
+      if (end - p >= 3 &&
+          (hi = Capi_hex_val(p[1])) >= 0 && (lo = Capi_hex_val(p[2])) >= 0) {
+         dStr_append_c(ds, (hi << 4) | lo);
+         str = p + 3;
+      } else {
+         dStr_append_c(ds, '%');
+         str = p + 1;
+      }
+   }
+   dStr_append_l(ds, str, end - str);
+   return ds;
+}
+
+/**
+ * Decode a "data:" URI (RFC 2397) in-process, straight into a cache entry.
+ * This spares a dpi connection for every inline image or sprite.
+ */
+static void Capi_datauri_inject(const DilloUrl *url)
+{
+   const char *url_str = URL_STR(url), *comma;
+   char *mime_type;
+   Dstr *data, *raw;
+   size_t len;
+   int is_base64 = 0;
+
+   if (!(comma = strchr(url_str, ','))) {
+      data = dStr_new("<!DOCTYPE HTML>\n<html><body>\n"
+                      "<h1>Can't parse data URI</h1>\n</body></html>\n");
+      mime_type = dStrdup("text/html");
+   } else {
+      /* strip ";base64" from the mediatype */
+      url_str += 5;
+      len = comma - url_str;
+      if (len >= 7 && !dStrnAsciiCasecmp(comma - 7, ";base64", 7)) {
+         is_base64 = 1;
+         len -= 7;
+      }
+      /* handle omitted types */
+      if (len == 0) {
+         mime_type = dStrdup("text/plain;charset=US-ASCII");
+      } else if (!dStrnAsciiCasecmp(url_str, "charset", 7)) {
+         char *charset = dStrndup(url_str, len);
+         mime_type = dStrconcat("text/plain;", charset, NULL);
+         dFree(charset);
+      } else {
+         mime_type = dStrndup(url_str, len);
+      }
+
+      raw = Capi_datauri_unescape(comma + 1, strlen(comma + 1));
+      if (is_base64) {
+         data = a_Misc_decode_base64(raw->str, raw->len);
+         dStr_free(raw, 1);
+      } else {
+         data = raw;
+      }
+   }
+   _MSG("Capi_datauri_inject: %s, %d bytes\n", mime_type, data->len);
+
+   a_Cache_entry_inject_data_url(url, data);
+   a_Cache_set_content_type(url, mime_type, "http");
+   dStr_free(data, 1);
+   dFree(mime_type);
+}
+
 /**
  * Shall we permit this request to open a URL?
  */
@@ -427,6 +514,12 @@ int a_Capi_open_url(DilloWeb *web, CA_Callback_t Call, void *CbData)
                     URL_STR(web->url));
         }
 
+      } else if (!dStrAsciiCasecmp(scheme, "data")) {
+         /* data URI: its content never changes, so decode it only once */
+         if (!(a_Capi_get_flags(web->url) & CAPI_IsCached))
+            Capi_datauri_inject(web->url);
+         use_cache = 1;
+
       } else if (Capi_url_uses_dpi(web->url, &server)) {
          /* dpi request */
          if ((safe = a_Capi_dpi_verify_request(web->bw, web->url))) {
@@ -536,6 +629,15 @@ int a_Capi_get_flags_with_redirection(const DilloUrl *Url)
    return status;
 }
 
+/**
+ * Get a number that changes whenever the cached content of the URL may
+ * have changed (0 if not cached).
+ */
+uint_t a_Capi_get_serial(const DilloUrl *Url)
+{
+   return a_Cache_get_serial(Url);
+}
+
 /**
  * Get the cache's buffer for the URL, and its size.
  * Return: 1 cached, 0 not cached.
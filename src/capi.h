@@ -30,6 +30,7 @@ const char *a_Capi_set_content_type(const DilloUrl *url, const char *ctype,
                                     const char *from);
 int a_Capi_get_flags(const DilloUrl *Url);
 int a_Capi_get_flags_with_redirection(const DilloUrl *Url);
+uint_t a_Capi_get_serial(const DilloUrl *Url);
 int a_Capi_dpi_verify_request(BrowserWindow *bw, DilloUrl *url);
 int a_Capi_dpi_send_data(const DilloUrl *url, void *bw,
                          char *data, int data_sz, char *server, int flags);
@@ -0,0 +1,296 @@
+/*
+ * File: charscan.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/** @file
+ * Delimiter scanning for the tokenizers.
+ *
+ * These are bounded versions of strcspn() and of "skip while isspace()"
+ * loops. When the CPU has AVX2 (checked at run time), sixteen and then
+ * thirty-two bytes are classified at a time with two nibble table lookups.
+ * Otherwise the first bytes are tested one at a time against a lookup
+ * table, as most tokens end within them, and then, where SSE2 is available
+ * (always on x86_64), sixteen bytes are compared at a time against sets of
+ * up to CHARSCAN_VEC_MAX delimiters. Larger sets and the tail of the buffer
+ * go through the lookup table.
+ */
+
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#  include <emmintrin.h>
+#  define CHARSCAN_SSE2
+#  if defined(__x86_64__) || defined(__i386__)
+#     include <immintrin.h>
+#     define CHARSCAN_AVX2
+#  endif
+#endif
+
+#include "charscan.h"
+
+/* Flags in CharscanSet.member[] */
+#define CHARSCAN_IN   1     /* in the set */
+#define CHARSCAN_STOP 2     /* in the set, or NUL: a_Charscan_find() stops */
+
+/* Bytes tested one at a time before the SSE2 loop */
+#define CHARSCAN_PREFIX 16
+
+/**
+ * Fill in the nibble tables for the bytes with 'flag' in 'member'.
+ * A byte c is one of them when lo[c & 15] & hi[c >> 4] isn't zero: each
+ * bit stands for one of the sets of low nibbles that go with some high
+ * nibble, so it works for up to eight different such sets.
+ * Return value: whether they fit.
+ */
+static int Charscan_prepare_nibbles(CharscanSet *set, int flag,
+                                    unsigned char *lo, unsigned char *hi)
+{
+   unsigned rows[16] = {0}, patterns[8];
+   int c, k, npatterns = 0;
+
+   for (c = 0; c < 256; ++c)
+      if (set->member[c] & flag)
+         rows[c >> 4] |= 1U << (c & 15);
+
+   memset(lo, 0, 16);
+   memset(hi, 0, 16);
+   for (c = 0; c < 16; ++c) {
+      if (!rows[c])
+         continue;
+      for (k = 0; k < npatterns && patterns[k] != rows[c]; ++k) ;
+      if (k == npatterns) {
+         if (npatterns == 8)
+            return 0;
+         patterns[npatterns++] = rows[c];
+      }
+      hi[c] = 1 << k;
+   }
+   for (k = 0; k < npatterns; ++k)
+      for (c = 0; c < 16; ++c)
+         if (patterns[k] & (1U << c))
+            lo[c] |= 1 << k;
+   return 1;
+}
+
+/**
+ * Fill in the tables of a set.
+ * Unused vector slots repeat the first delimiter, so that the SIMD loops
+ * can always test all of them without branching.
+ */
+void a_Charscan_prepare(CharscanSet *set)
+{
+   const unsigned char *p = (const unsigned char *)set->chars;
+   size_t i, n = strlen(set->chars);
+
+   memset(set->member, 0, sizeof(set->member));
+   for (i = 0; i < n; ++i)
+      set->member[p[i]] = CHARSCAN_IN | CHARSCAN_STOP;
+   set->member[0] |= CHARSCAN_STOP;
+
+   set->vec_ok = (n > 0 && n <= CHARSCAN_VEC_MAX);
+   for (i = 0; set->vec_ok && i < CHARSCAN_VEC_MAX; ++i)
+      memset(set->vec[i], p[i < n ? i : 0], 16);
+
+   set->nibbles_ok =
+      Charscan_prepare_nibbles(set, CHARSCAN_STOP, set->nibbles[0],
+                               set->nibbles[1]) &&
+      Charscan_prepare_nibbles(set, CHARSCAN_IN, set->nibbles[2],
+                               set->nibbles[3]);
+   set->ready = 1;
+}
+
+#ifdef CHARSCAN_SSE2
+/**
+ * Return the bytes of 'v' that are in the set, as a vector mask.
+ */
+static inline __m128i Charscan_vec_members(__m128i v, const CharscanSet *set)
+{
+   const __m128i *d = (const __m128i *)set->vec;
+   __m128i m0, m1, m2, m3;
+
+   m0 = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_loadu_si128(d + 0)),
+                     _mm_cmpeq_epi8(v, _mm_loadu_si128(d + 1)));
+   m1 = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_loadu_si128(d + 2)),
+                     _mm_cmpeq_epi8(v, _mm_loadu_si128(d + 3)));
+   m2 = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_loadu_si128(d + 4)),
+                     _mm_cmpeq_epi8(v, _mm_loadu_si128(d + 5)));
+   m3 = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_loadu_si128(d + 6)),
+                     _mm_cmpeq_epi8(v, _mm_loadu_si128(d + 7)));
+   return _mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3));
+}
+#endif /* CHARSCAN_SSE2 */
+
+#ifdef CHARSCAN_AVX2
+/*
+ * These are compiled for AVX2 whatever the compiler flags, and only called
+ * when __builtin_cpu_supports() (CPUID, and whether the OS saves the YMM
+ * registers) says that the CPU can run them.
+ */
+#define CHARSCAN_AVX2_FN __attribute__((target("avx2")))
+
+/**
+ * Return a bit mask of the sixteen bytes at 's' that aren't in the nibble
+ * tables 'lo' and 'hi'.
+ */
+CHARSCAN_AVX2_FN
+static inline unsigned Charscan_outside16(const char *s, __m128i lo,
+                                          __m128i hi)
+{
+   const __m128i v = _mm_loadu_si128((const __m128i *)s),
+                 nibble = _mm_set1_epi8(0x0f);
+   __m128i m;
+
+   m = _mm_and_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, nibble)),
+                     _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(v, 4),
+                                                        nibble)));
+   return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(m, _mm_setzero_si128()));
+}
+
+/**
+ * Scan 's' from '*pos' on, sixteen bytes and then thirty-two at a time,
+ * for the first byte that is (or, with 'skip', isn't) in the nibble tables
+ * 'lo' and 'hi'. Fewer than sixteen bytes at the end are left alone.
+ * Return value: whether it found one; '*pos' is its offset, or that of the
+ * first byte it didn't look at.
+ */
+CHARSCAN_AVX2_FN
+static int Charscan_scan_avx2(const char *s, size_t len, size_t *pos,
+                              const unsigned char *lo, const unsigned char *hi,
+                              int skip)
+{
+   const __m128i lo16 = _mm_loadu_si128((const __m128i *)lo),
+                 hi16 = _mm_loadu_si128((const __m128i *)hi);
+   const __m256i lo_t = _mm256_broadcastsi128_si256(lo16),
+                 hi_t = _mm256_broadcastsi128_si256(hi16),
+                 nibble = _mm256_set1_epi8(0x0f),
+                 zero = _mm256_setzero_si256();
+   const unsigned flip = skip ? 0 : ~0U;
+   __m256i v, m;
+   unsigned mask;
+   size_t i = *pos;
+
+   /* most tokens end within the first block */
+   if (i + 16 <= len) {
+      mask = Charscan_outside16(s + i, lo16, hi16) ^ flip;
+      if ((mask &= 0xffff)) {
+         *pos = i + __builtin_ctz(mask);
+         return 1;
+      }
+      i += 16;
+   }
+   for ( ; i + 32 <= len; i += 32) {
+      v = _mm256_loadu_si256((const __m256i *)(s + i));
+      m = _mm256_and_si256(
+             _mm256_shuffle_epi8(lo_t, _mm256_and_si256(v, nibble)),
+             _mm256_shuffle_epi8(hi_t, _mm256_and_si256(
+                                          _mm256_srli_epi16(v, 4), nibble)));
+      /* the bytes that aren't in the set */
+      mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(m, zero));
+      if ((mask ^= flip)) {
+         *pos = i + __builtin_ctz(mask);
+         return 1;
+      }
+   }
+   if (i + 16 <= len) {
+      mask = Charscan_outside16(s + i, lo16, hi16) ^ flip;
+      if ((mask &= 0xffff)) {
+         *pos = i + __builtin_ctz(mask);
+         return 1;
+      }
+      i += 16;
+   }
+   *pos = i;
+   return 0;
+}
+#endif /* CHARSCAN_AVX2 */
+
+/**
+ * Return the offset of the first byte of 's' that is in 'set' or is NUL,
+ * or 'len' if there's none (i.e. strcspn() that never reads past 'len').
+ */
+size_t a_Charscan_find(const char *s, size_t len, CharscanSet *set)
+{
+   size_t i = 0, n;
+
+   if (!set->ready)
+      a_Charscan_prepare(set);
+
+#ifdef CHARSCAN_AVX2
+   if (set->nibbles_ok && __builtin_cpu_supports("avx2")) {
+      if (Charscan_scan_avx2(s, len, &i, set->nibbles[0], set->nibbles[1], 0))
+         return i;
+   } else
+#endif
+   {
+      n = len < CHARSCAN_PREFIX ? len : CHARSCAN_PREFIX;
+      for ( ; i < n; ++i)
+         if (set->member[(unsigned char)s[i]] & CHARSCAN_STOP)
+            return i;
+#ifdef CHARSCAN_SSE2
+      if (set->vec_ok) {
+         __m128i v, zero = _mm_setzero_si128();
+         int mask;
+
+         for ( ; i + 16 <= len; i += 16) {
+            v = _mm_loadu_si128((const __m128i *)(s + i));
+            mask = _mm_movemask_epi8(
+                      _mm_or_si128(Charscan_vec_members(v, set),
+                                   _mm_cmpeq_epi8(v, zero)));
+            if (mask)
+               return i + __builtin_ctz(mask);
+         }
+      }
+#endif
+   }
+
+   for ( ; i < len; ++i)
+      if (set->member[(unsigned char)s[i]] & CHARSCAN_STOP)
+         break;
+   return i;
+}
+
+/**
+ * Return the offset of the first byte of 's' that is NOT in 'set',
+ * or 'len' if all of them are (i.e. a bounded strspn()).
+ */
+size_t a_Charscan_skip(const char *s, size_t len, CharscanSet *set)
+{
+   size_t i = 0, n;
+
+   if (!set->ready)
+      a_Charscan_prepare(set);
+
+#ifdef CHARSCAN_AVX2
+   if (set->nibbles_ok && __builtin_cpu_supports("avx2")) {
+      if (Charscan_scan_avx2(s, len, &i, set->nibbles[2], set->nibbles[3], 1))
+         return i;
+   } else
+#endif
+   {
+      n = len < CHARSCAN_PREFIX ? len : CHARSCAN_PREFIX;
+      for ( ; i < n; ++i)
+         if (!(set->member[(unsigned char)s[i]] & CHARSCAN_IN))
+            return i;
+#ifdef CHARSCAN_SSE2
+      if (set->vec_ok) {
+         __m128i v;
+         int mask;
+
+         for ( ; i + 16 <= len; i += 16) {
+            v = _mm_loadu_si128((const __m128i *)(s + i));
+            mask = ~_mm_movemask_epi8(Charscan_vec_members(v, set)) & 0xffff;
+            if (mask)
+               return i + __builtin_ctz(mask);
+         }
+      }
+#endif
+   }
+
+   for ( ; i < len && (set->member[(unsigned char)s[i]] & CHARSCAN_IN); ++i) ;
+   return i;
+}
@@ -0,0 +1,41 @@
+#ifndef __DILLO_CHARSCAN_H__
+#define __DILLO_CHARSCAN_H__
+
+#include <stddef.h>     /* for size_t */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define CHARSCAN_VEC_MAX 8
+
+/**
+ * A small set of delimiter bytes to scan for.
+ *
+ * Define them statically with CHARSCAN_SET("..."); the tables are
+ * filled in on first use. A set that more than one thread scans with
+ * must be passed to a_Charscan_prepare() before they start.
+ */
+typedef struct {
+   const char *chars;
+   int ready;
+   int vec_ok;          /**< whether 'chars' fits in 'vec' */
+   unsigned char member[256];
+   unsigned char vec[CHARSCAN_VEC_MAX][16];  /**< broadcast delimiters */
+   int nibbles_ok;      /**< whether 'nibbles' could be built */
+   unsigned char nibbles[4][16];  /**< low and high nibble classes, of the
+                                   *   bytes find stops at, and of 'chars' */
+} CharscanSet;
+
+#define CHARSCAN_SET(chars) { chars, 0, 0, {0}, {{0}}, 0, {{0}} }
+
+void a_Charscan_prepare(CharscanSet *set);
+size_t a_Charscan_find(const char *s, size_t len, CharscanSet *set);
+size_t a_Charscan_skip(const char *s, size_t len, CharscanSet *set);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __DILLO_CHARSCAN_H__ */
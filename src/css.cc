@@ -10,6 +10,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "../dlib/dlib.h"
 #include "msg.h"
 #include "html_common.hh"
@@ -34,8 +35,15 @@ CssPropertyList::CssPropertyList (const CssPropertyList &p, bool deep) :
          switch (p->type) {
             case CSS_TYPE_STRING:
             case CSS_TYPE_SYMBOL:
+            case CSS_TYPE_URI:
                p->value.strVal = dStrdup (p->value.strVal);
                break;
+            case CSS_TYPE_BACKGROUND_POSITION: {
+               CssBackgroundPosition *pos = dNew (CssBackgroundPosition, 1);
+               *pos = *p->value.posVal;
+               p->value.posVal = pos;
+               break;
+            }
             default:
                break;
          }
@@ -99,33 +107,117 @@ void CssPropertyList::apply (CssPropertyList *props) {
    }
 }
 
+/**
+ * \brief Whether both lists set the same properties to the same values,
+ * in the same order.
+ */
+bool CssPropertyList::equals (const CssPropertyList *props) const {
+   if (props == this)
+      return true;
+   if (props == NULL || props->size () != size ())
+      return false;
+
+   for (int i = 0; i < size (); i++) {
+      const CssProperty *p1 = getRef (i), *p2 = props->getRef (i);
+
+      if (p1->name != p2->name || p1->type != p2->type)
+         return false;
+
+      switch (p1->type) {
+         case CSS_TYPE_STRING:
+         case CSS_TYPE_SYMBOL:
+         case CSS_TYPE_URI:
+            if (p1->value.strVal != p2->value.strVal &&
+                (!p1->value.strVal || !p2->value.strVal ||
+                 strcmp (p1->value.strVal, p2->value.strVal)))
+               return false;
+            break;
+         case CSS_TYPE_BACKGROUND_POSITION:
+            if (p1->value.posVal->posX.type != p2->value.posVal->posX.type ||
+                p1->value.posVal->posX.i != p2->value.posVal->posX.i ||
+                p1->value.posVal->posY.type != p2->value.posVal->posY.type ||
+                p1->value.posVal->posY.i != p2->value.posVal->posY.i)
+               return false;
+            break;
+         case CSS_TYPE_LENGTH_PERCENTAGE:
+         case CSS_TYPE_LENGTH:
+         case CSS_TYPE_SIGNED_LENGTH:
+         case CSS_TYPE_LENGTH_PERCENTAGE_NUMBER:
+         case CSS_TYPE_AUTO:
+            if (p1->value.lenVal.type != p2->value.lenVal.type ||
+                p1->value.lenVal.i != p2->value.lenVal.i)
+               return false;
+            break;
+         default:
+            if (p1->value.intVal != p2->value.intVal)
+               return false;
+            break;
+      }
+   }
+   return true;
+}
+
+/**
+ * \brief A hash value that is the same for lists that are equal ().
+ */
+unsigned CssPropertyList::hashValue () const {
+   unsigned hash = 2166136261u;
+
+   for (int i = 0; i < size (); i++) {
+      const CssProperty *p = getRef (i);
+      unsigned v = 0;
+
+      switch (p->type) {
+         case CSS_TYPE_STRING:
+         case CSS_TYPE_SYMBOL:
+         case CSS_TYPE_URI:
+            if (p->value.strVal)
+               for (const char *s = p->value.strVal; *s; s++)
+                  v = v * 31 + (unsigned char) *s;
+            break;
+         case CSS_TYPE_BACKGROUND_POSITION:
+            v = p->value.posVal->posX.i * 31 + p->value.posVal->posY.i;
+            break;
+         case CSS_TYPE_LENGTH_PERCENTAGE:
+         case CSS_TYPE_LENGTH:
+         case CSS_TYPE_SIGNED_LENGTH:
+         case CSS_TYPE_LENGTH_PERCENTAGE_NUMBER:
+         case CSS_TYPE_AUTO:
+            v = p->value.lenVal.i * 31 + p->value.lenVal.type;
+            break;
+         default:
+            v = p->value.intVal;
+            break;
+      }
+      hash = (hash ^ ((unsigned) p->name << 8 | p->type)) * 16777619u;
+      hash = (hash ^ v) * 16777619u;
+   }
+   return hash;
+}
+
 void CssPropertyList::print () {
    for (int i = 0; i < size (); i++)
       getRef (i)->print ();
 }
 
-CssSelector::CssSelector () {
-   struct CombinatorAndSelector *cs;
-
-   refCount = 0;
-   matchCacheOffset = -1;
-   selectorList.increase ();
-   cs = selectorList.getRef (selectorList.size () - 1);
-
-   cs->combinator = COMB_NONE;
-   cs->selector = new CssSimpleSelector ();
+CssSelector::CssSelector (lout::misc::ZoneAllocator *zone) {
+   this->zone = zone;
+   numAncestorHashes = -1;
+   addSimpleSelector (COMB_NONE);
 }
 
 CssSelector::~CssSelector () {
+   /* the simple selectors live in the zone, only their vectors need it */
    for (int i = selectorList.size () - 1; i >= 0; i--)
-      delete selectorList.getRef (i)->selector;
+      selectorList.getRef (i)->selector->~CssSimpleSelector ();
 }
 
 /**
  * \brief Return whether selector matches at a given node in the document tree.
  */
 bool CssSelector::match (Doctree *docTree, const DoctreeNode *node,
-                         int i, Combinator comb, MatchCache *matchCache) {
+                         int i, Combinator comb, MatchCache *matchCache,
+                         int matchCacheOffset) {
    int *matchCacheEntry;
    assert (node);
 
@@ -151,7 +243,8 @@ bool CssSelector::match (Doctree *docTree, const DoctreeNode *node,
          for (const DoctreeNode *n = node;
               n && n->num > *matchCacheEntry; n = docTree->parent (n))
             if (sel->match (n) &&
-                match (docTree, n, i - 1, cs->combinator, matchCache))
+                match (docTree, n, i - 1, cs->combinator, matchCache,
+                       matchCacheOffset))
                return true;
 
          if (node) // remember that it didn't match to avoid future tests
@@ -167,18 +260,77 @@ bool CssSelector::match (Doctree *docTree, const DoctreeNode *node,
       return false;
 
    // tail recursion should be optimized by the compiler
-   return match (docTree, node, i - 1, cs->combinator, matchCache);
+   return match (docTree, node, i - 1, cs->combinator, matchCache,
+                 matchCacheOffset);
+}
+
+/**
+ * \brief Collect the filter hashes of what the ancestors of a matching node
+ *        must have.
+ *
+ * Only the simple selectors that are reached from the subject through
+ * descendant and child combinators are looked at. Ids and classes come
+ * first, since nearly every document has the common elements.
+ */
+void CssSelector::computeAncestorHashes () {
+   numAncestorHashes = 0;
+
+   for (int pass = 0; pass < 2; pass++) {
+      for (int i = selectorList.size () - 1; i > 0; i--) {
+         Combinator comb = selectorList.getRef (i)->combinator;
+         CssSimpleSelector *sel = selectorList.getRef (i - 1)->selector;
+
+         if (comb != COMB_DESCENDANT && comb != COMB_CHILD)
+            break;
+
+         if (pass == 0) {
+            if (sel->getId () && numAncestorHashes < maxAncestorHashes)
+               ancestorHashes[numAncestorHashes++] =
+                  Doctree::stringHash (sel->getId ());
+            for (int j = 0; j < sel->getClass ()->size () &&
+                            numAncestorHashes < maxAncestorHashes; j++)
+               ancestorHashes[numAncestorHashes++] =
+                  Doctree::stringHash (sel->getClass ()->get (j));
+         } else if (sel->getElement () >= 0 &&
+                    numAncestorHashes < maxAncestorHashes) {
+            ancestorHashes[numAncestorHashes++] =
+               Doctree::elementHash (sel->getElement ());
+         }
+      }
+   }
+}
+
+/**
+ * \brief Return false if the open elements of the document certainly
+ *        lack what the selector requires from the ancestors.
+ */
+bool CssSelector::ancestorsMayMatch (Doctree *dt) {
+   if (!dt->filterEnabled)
+      return true;
+   if (numAncestorHashes == -1)
+      computeAncestorHashes ();
+   if (numAncestorHashes == 0)
+      return true;
+
+   for (int i = 0; i < numAncestorHashes; i++) {
+      if (!dt->filterMayContain (ancestorHashes[i])) {
+         dt->filterRejected++;
+         return false;
+      }
+   }
+   dt->filterWalked++;
+   return true;
 }
 
 void CssSelector::addSimpleSelector (Combinator c) {
    struct CombinatorAndSelector *cs;
 
-   assert (matchCacheOffset == -1);
    selectorList.increase ();
    cs = selectorList.getRef (selectorList.size () - 1);
 
    cs->combinator = c;
-   cs->selector = new CssSimpleSelector ();
+   cs->selector = new (zone->zoneAllocAligned (sizeof (CssSimpleSelector)))
+      CssSimpleSelector (zone);
 }
 
 bool CssSelector::checksPseudoClass () {
@@ -228,32 +380,26 @@ void CssSelector::print () {
    fprintf (stderr, "\n");
 }
 
-CssSimpleSelector::CssSimpleSelector () {
+CssSimpleSelector::CssSimpleSelector (lout::misc::ZoneAllocator *zone) {
+   this->zone = zone;
    element = ELEMENT_ANY;
    id = NULL;
    pseudo = NULL;
 }
 
-CssSimpleSelector::~CssSimpleSelector () {
-   for (int i = 0; i < klass.size (); i++)
-      dFree (klass.get (i));
-   dFree (id);
-   dFree (pseudo);
-}
-
 void CssSimpleSelector::setSelect (SelectType t, const char *v) {
    switch (t) {
       case SELECT_CLASS:
          klass.increase ();
-         klass.set (klass.size () - 1, dStrdup (v));
+         klass.set (klass.size () - 1, (char *) zone->strdup (v));
          break;
       case SELECT_PSEUDO_CLASS:
          if (pseudo == NULL)
-            pseudo = dStrdup (v);
+            pseudo = zone->strdup (v);
          break;
       case SELECT_ID:
          if (id == NULL)
-            id = dStrdup (v);
+            id = zone->strdup (v);
          break;
       default:
          break;
@@ -321,21 +467,15 @@ CssRule::CssRule (CssSelector *selector, CssPropertyList *props, int pos) {
    assert (selector->size () > 0);
 
    this->selector = selector;
-   this->selector->ref ();
    this->props = props;
-   this->props->ref ();
    this->pos = pos;
+   matchCacheOffset = 0;
    spec = selector->specificity ();
 }
 
-CssRule::~CssRule () {
-   selector->unref ();
-   props->unref ();
-}
-
 void CssRule::apply (CssPropertyList *props, Doctree *docTree,
                      const DoctreeNode *node, MatchCache *matchCache) const {
-   if (selector->match (docTree, node, matchCache))
+   if (selector->match (docTree, node, matchCache, matchCacheOffset))
       this->props->apply (props);
 }
 
@@ -400,8 +540,8 @@ void CssStyleSheet::addRule (CssRule *rule) {
 
    if (ruleList) {
       ruleList->insert (rule);
-      if (rule->selector->getRequiredMatchCache () > requiredMatchCache)
-         requiredMatchCache = rule->selector->getRequiredMatchCache ();
+      if (rule->getRequiredMatchCache () > requiredMatchCache)
+         requiredMatchCache = rule->getRequiredMatchCache ();
    } else {
       assert (top->getElement () == CssSimpleSelector::ELEMENT_NONE);
       delete rule;
@@ -485,12 +625,28 @@ void CssStyleSheet::apply (CssPropertyList *props, Doctree *docTree,
 }
 
 CssStyleSheet CssContext::userAgentSheet;
+bool CssContext::userAgentMatchesSiblings = false;
 
-CssContext::CssContext () {
+CssContext::CssContext () : ruleSets (4) {
    pos = 0;
+   matchesSiblings = false;
    matchCache.setSize (userAgentSheet.getRequiredMatchCache (), -1);
 }
 
+CssContext::~CssContext () {
+   for (int i = 0; i < ruleSets.size (); i++)
+      ruleSets.get (i)->unref ();
+}
+
+/**
+ * \brief Keep a rule set alive as long as the context uses its rules.
+ */
+void CssContext::hold (CssRuleSet *ruleSet) {
+   ruleSet->ref ();
+   ruleSets.increase ();
+   ruleSets.set (ruleSets.size () - 1, ruleSet);
+}
+
 /**
  * \brief Apply a CSS context to a property list.
  *
@@ -504,26 +660,52 @@ void CssContext::apply (CssPropertyList *props, Doctree *docTree,
          DoctreeNode *node,
          CssPropertyList *tagStyle, CssPropertyList *tagStyleImportant,
          CssPropertyList *nonCssHints) {
+   apply (props, docTree, node, tagStyle, tagStyleImportant, nonCssHints,
+          &matchCache);
+}
 
-   userAgentSheet.apply (props, docTree, node, &matchCache);
+/**
+ * \brief Apply the context to a node that was styled before, and may
+ * already be closed.
+ *
+ * The nodes are normally matched in document order, which the match cache
+ * and the ancestor filter of the doctree rely on. Here a fresh match
+ * cache is used, and the filter is not consulted.
+ */
+void CssContext::reapply (CssPropertyList *props, Doctree *docTree,
+                          DoctreeNode *node, CssPropertyList *nonCssHints) {
+   MatchCache freshMatchCache;
+
+   freshMatchCache.setSize (matchCache.size (), -1);
+   docTree->filterEnabled = false;
+   apply (props, docTree, node, NULL, NULL, nonCssHints, &freshMatchCache);
+   docTree->filterEnabled = true;
+}
 
-   sheet[CSS_PRIMARY_USER].apply (props, docTree, node, &matchCache);
+void CssContext::apply (CssPropertyList *props, Doctree *docTree,
+         DoctreeNode *node,
+         CssPropertyList *tagStyle, CssPropertyList *tagStyleImportant,
+         CssPropertyList *nonCssHints, MatchCache *matchCache) {
+
+   userAgentSheet.apply (props, docTree, node, matchCache);
+
+   sheet[CSS_PRIMARY_USER].apply (props, docTree, node, matchCache);
 
    if (nonCssHints)
         nonCssHints->apply (props);
 
-   sheet[CSS_PRIMARY_AUTHOR].apply (props, docTree, node, &matchCache);
+   sheet[CSS_PRIMARY_AUTHOR].apply (props, docTree, node, matchCache);
 
    if (tagStyle)
         tagStyle->apply (props);
 
    sheet[CSS_PRIMARY_AUTHOR_IMPORTANT].apply (props, docTree, node,
-                                              &matchCache);
+                                              matchCache);
 
    if (tagStyleImportant)
         tagStyleImportant->apply (props);
 
-   sheet[CSS_PRIMARY_USER_IMPORTANT].apply (props, docTree, node, &matchCache);
+   sheet[CSS_PRIMARY_USER_IMPORTANT].apply (props, docTree, node, matchCache);
 }
 
 void CssContext::addRule (CssSelector *sel, CssPropertyList *props,
@@ -538,15 +720,404 @@ void CssContext::addRule (CssSelector *sel, CssPropertyList *props,
          _MSG_WARN ("Ignoring unsafe author style that might reveal browsing history\n");
          delete rule;
       } else {
-         rule->selector->setMatchCacheOffset(matchCache.size ());
-         if (rule->selector->getRequiredMatchCache () > matchCache.size ())
-            matchCache.setSize (rule->selector->getRequiredMatchCache (), -1);
+         rule->setMatchCacheOffset(matchCache.size ());
+         matchCache.setSize (rule->getRequiredMatchCache (), -1);
 
          if (order == CSS_PRIMARY_USER_AGENT) {
             userAgentSheet.addRule (rule);
+            if (sel->matchesSiblings ())
+               userAgentMatchesSiblings = true;
          } else {
             sheet[order].addRule (rule);
+            if (sel->matchesSiblings ())
+               matchesSiblings = true;
          }
       }
    }
 }
+
+CssRuleSet::~CssRuleSet () {
+   /* the objects themselves go with the zone */
+   for (int i = 0; i < selectors.size (); i++)
+      selectors.get (i)->~CssSelector ();
+   for (int i = 0; i < propertyLists.size (); i++)
+      propertyLists.get (i)->~CssPropertyList ();
+   for (int i = 0; i < imports.size (); i++)
+      a_Url_free (imports.get (i));
+}
+
+/**
+ * \brief Create an empty selector, which belongs to the rule set.
+ */
+CssSelector *CssRuleSet::newSelector () {
+   CssSelector *sel = new (zone.zoneAllocAligned (sizeof (CssSelector)))
+      CssSelector (&zone);
+
+   selectors.increase ();
+   selectors.set (selectors.size () - 1, sel);
+   return sel;
+}
+
+/**
+ * \brief Create an empty property list, which belongs to the rule set.
+ */
+CssPropertyList *CssRuleSet::newPropertyList () {
+   CssPropertyList *props =
+      new (zone.zoneAllocAligned (sizeof (CssPropertyList)))
+      CssPropertyList (true);
+
+   propertyLists.increase ();
+   propertyLists.set (propertyLists.size () - 1, props);
+   return props;
+}
+
+void CssRuleSet::addRule (CssSelector *sel, CssPropertyList *props,
+                          CssPrimaryOrder order) {
+   if (props->size () > 0) {
+      Rule *r;
+
+      rules.increase ();
+      r = rules.getRef (rules.size () - 1);
+      r->selector = sel;
+      r->props = props;
+      r->order = order;
+   }
+}
+
+void CssRuleSet::addImport (const DilloUrl *url) {
+   imports.increase ();
+   imports.set (imports.size () - 1, a_Url_dup (url));
+}
+
+/**
+ * \brief Add the rules to a context, as if they had just been parsed.
+ *
+ * The @import rules are left to the caller, which must load the imported
+ * stylesheets first.
+ */
+void CssRuleSet::addTo (CssContext *context) {
+   context->hold (this);
+   for (int i = 0; i < rules.size (); i++) {
+      Rule *r = rules.getRef (i);
+      context->addRule (r->selector, r->props, r->order);
+   }
+}
+
+/* ----------------------------------------------------------------------
+ *    Saving and loading rule sets
+ * ---------------------------------------------------------------------- */
+
+/*
+ * A saved rule set is a list of selectors, a list of property lists, and
+ * the rules as pairs of indexes into them, so that what the parser shared
+ * stays shared. Numbers are stored in 7-bit groups, low bits first, and
+ * strings with their length plus one (0 for NULL) and the terminating NUL.
+ * Element names are stored rather than their indexes.
+ */
+
+#define CSS_SAVE_MAGIC "DCSS"
+#define CSS_SAVE_VERSION 1
+
+enum {
+   CSS_SAVE_ELEMENT_ANY,
+   CSS_SAVE_ELEMENT_NONE,
+   CSS_SAVE_ELEMENT_NAME
+};
+
+typedef struct {
+   const char *p, *end;
+   bool ok;
+} CssReader;
+
+static void Css_put_uint (Dstr *ds, uint32_t v)
+{
+   while (v >= 0x80) {
+      dStr_append_c (ds, (v & 0x7f) | 0x80);
+      v >>= 7;
+   }
+   dStr_append_c (ds, v);
+}
+
+static void Css_put_str (Dstr *ds, const char *s)
+{
+   if (s) {
+      int len = strlen (s);
+
+      Css_put_uint (ds, len + 1);
+      dStr_append_l (ds, s, len + 1);
+   } else {
+      Css_put_uint (ds, 0);
+   }
+}
+
+static void Css_put_length (Dstr *ds, CssLength l)
+{
+   Css_put_uint (ds, l.type);
+   Css_put_uint (ds, (uint32_t) l.i); /* or the bits of l.f */
+}
+
+static uint32_t Css_get_uint (CssReader *r)
+{
+   uint32_t v = 0;
+
+   for (int shift = 0; r->ok && shift < 35; shift += 7) {
+      if (r->p >= r->end) {
+         r->ok = false;
+      } else {
+         unsigned char c = *r->p++;
+
+         v |= (uint32_t) (c & 0x7f) << shift;
+         if (!(c & 0x80))
+            return v;
+      }
+   }
+   r->ok = false;
+   return 0;
+}
+
+/*
+ * Return a string of the buffer, which stays valid as long as it.
+ */
+static const char *Css_get_str (CssReader *r)
+{
+   uint32_t len = Css_get_uint (r);
+   const char *s = r->p;
+
+   if (!r->ok || len == 0)
+      return NULL;
+   if (len > (uint32_t) (r->end - r->p) || s[len - 1] != '\0') {
+      r->ok = false;
+      return NULL;
+   }
+   r->p += len;
+   return s;
+}
+
+static CssLength Css_get_length (CssReader *r)
+{
+   CssLength l;
+
+   l.type = (CssLengthType) Css_get_uint (r);
+   l.i = (int) Css_get_uint (r);
+   if (l.type > CSS_LENGTH_TYPE_AUTO)
+      r->ok = false;
+   return l;
+}
+
+void CssSimpleSelector::save (Dstr *ds) {
+   const char *name;
+
+   if (element == ELEMENT_ANY) {
+      Css_put_uint (ds, CSS_SAVE_ELEMENT_ANY);
+   } else if (element >= 0 && (name = a_Html_tag_name (element))) {
+      Css_put_uint (ds, CSS_SAVE_ELEMENT_NAME);
+      Css_put_str (ds, name);
+   } else {
+      Css_put_uint (ds, CSS_SAVE_ELEMENT_NONE);
+   }
+   Css_put_str (ds, pseudo);
+   Css_put_str (ds, id);
+   Css_put_uint (ds, klass.size ());
+   for (int i = 0; i < klass.size (); i++)
+      Css_put_str (ds, klass.get (i));
+}
+
+void CssSelector::save (Dstr *ds) {
+   Css_put_uint (ds, selectorList.size ());
+   for (int i = 0; i < selectorList.size (); i++) {
+      Css_put_uint (ds, selectorList.getRef (i)->combinator);
+      selectorList.getRef (i)->selector->save (ds);
+   }
+}
+
+void CssPropertyList::save (Dstr *ds) {
+   Css_put_uint (ds, size ());
+   for (int i = 0; i < size (); i++) {
+      CssProperty *prop = getRef (i);
+
+      Css_put_uint (ds, prop->name);
+      Css_put_uint (ds, prop->type);
+      switch (prop->type) {
+      case CSS_TYPE_STRING:
+      case CSS_TYPE_SYMBOL:
+      case CSS_TYPE_URI:
+         Css_put_str (ds, prop->value.strVal);
+         break;
+      case CSS_TYPE_BACKGROUND_POSITION:
+         Css_put_length (ds, prop->value.posVal->posX);
+         Css_put_length (ds, prop->value.posVal->posY);
+         break;
+      case CSS_TYPE_LENGTH_PERCENTAGE:
+      case CSS_TYPE_LENGTH:
+      case CSS_TYPE_SIGNED_LENGTH:
+      case CSS_TYPE_LENGTH_PERCENTAGE_NUMBER:
+         Css_put_length (ds, prop->value.lenVal);
+         break;
+      default:
+         Css_put_uint (ds, (uint32_t) prop->value.intVal);
+         break;
+      }
+   }
+}
+
+static bool Css_load_selector (CssReader *r, CssSelector *sel) {
+   uint32_t n = Css_get_uint (r);
+
+   if (n == 0)
+      r->ok = false;
+   for (uint32_t i = 0; r->ok && i < n; i++) {
+      uint32_t comb = Css_get_uint (r), element = Css_get_uint (r), nclass;
+      CssSimpleSelector *simple;
+      const char *s;
+
+      if (comb > CssSelector::COMB_ADJACENT_SIBLING ||
+          (i == 0) != (comb == CssSelector::COMB_NONE)) {
+         r->ok = false;
+         break;
+      }
+      if (i > 0)
+         sel->addSimpleSelector ((CssSelector::Combinator) comb);
+      simple = sel->top ();
+
+      if (element == CSS_SAVE_ELEMENT_NAME)
+         simple->setElement ((s = Css_get_str (r)) ? a_Html_tag_index (s) :
+                             CssSimpleSelector::ELEMENT_NONE);
+      else if (element == CSS_SAVE_ELEMENT_NONE)
+         simple->setElement (CssSimpleSelector::ELEMENT_NONE);
+      else if (element != CSS_SAVE_ELEMENT_ANY)
+         r->ok = false;
+
+      if ((s = Css_get_str (r)))
+         simple->setSelect (CssSimpleSelector::SELECT_PSEUDO_CLASS, s);
+      if ((s = Css_get_str (r)))
+         simple->setSelect (CssSimpleSelector::SELECT_ID, s);
+      nclass = Css_get_uint (r);
+      for (uint32_t j = 0; r->ok && j < nclass; j++)
+         if ((s = Css_get_str (r)))
+            simple->setSelect (CssSimpleSelector::SELECT_CLASS, s);
+   }
+   return r->ok;
+}
+
+static bool Css_load_property_list (CssReader *r, CssPropertyList *props) {
+   uint32_t n = Css_get_uint (r);
+
+   for (uint32_t i = 0; r->ok && i < n; i++) {
+      uint32_t name = Css_get_uint (r), type = Css_get_uint (r);
+      CssPropertyValue value;
+      const char *s;
+
+      if (name >= CSS_PROPERTY_LAST || type > CSS_TYPE_UNUSED) {
+         r->ok = false;
+         break;
+      }
+
+      switch (type) {
+      case CSS_TYPE_STRING:
+      case CSS_TYPE_SYMBOL:
+      case CSS_TYPE_URI:
+         s = Css_get_str (r);
+         value.strVal = s ? dStrdup (s) : NULL;
+         break;
+      case CSS_TYPE_BACKGROUND_POSITION:
+         value.posVal = dNew (CssBackgroundPosition, 1);
+         value.posVal->posX = Css_get_length (r);
+         value.posVal->posY = Css_get_length (r);
+         break;
+      case CSS_TYPE_LENGTH_PERCENTAGE:
+      case CSS_TYPE_LENGTH:
+      case CSS_TYPE_SIGNED_LENGTH:
+      case CSS_TYPE_LENGTH_PERCENTAGE_NUMBER:
+         value.lenVal = Css_get_length (r);
+         break;
+      default:
+         value.intVal = (int32_t) Css_get_uint (r);
+         break;
+      }
+      /* the list owns its strings, so it frees them even on errors */
+      props->set ((CssPropertyName) name, (CssValueType) type, value);
+   }
+   return r->ok;
+}
+
+/**
+ * \brief Append the rules in a form that load () reads back.
+ *
+ * The @import rules are not saved.
+ */
+void CssRuleSet::save (Dstr *ds) {
+   int sel = 0, list = 0;
+
+   dStr_append (ds, CSS_SAVE_MAGIC);
+   Css_put_uint (ds, CSS_SAVE_VERSION);
+   Css_put_uint (ds, CSS_PROPERTY_LAST);
+
+   Css_put_uint (ds, selectors.size ());
+   for (int i = 0; i < selectors.size (); i++)
+      selectors.get (i)->save (ds);
+   Css_put_uint (ds, propertyLists.size ());
+   for (int i = 0; i < propertyLists.size (); i++)
+      propertyLists.get (i)->save (ds);
+
+   /* The parser creates the selectors and property lists in the order the
+    * rules use them, so the search for their index goes on where the
+    * previous one stopped. */
+   Css_put_uint (ds, rules.size ());
+   for (int i = 0; i < rules.size (); i++) {
+      Rule *r = rules.getRef (i);
+
+      for (int j = 0; selectors.get (sel) != r->selector; j++) {
+         assert (j < selectors.size ());
+         sel = (sel + 1) % selectors.size ();
+      }
+      for (int j = 0; propertyLists.get (list) != r->props; j++) {
+         assert (j < propertyLists.size ());
+         list = (list + 1) % propertyLists.size ();
+      }
+      Css_put_uint (ds, sel);
+      Css_put_uint (ds, list);
+      Css_put_uint (ds, r->order);
+   }
+}
+
+/**
+ * \brief Add the rules saved by save () to an empty rule set.
+ *
+ * Return false if the data is not a saved rule set of this version of
+ * dillo. The rule set is of no use then, and should be dropped.
+ */
+bool CssRuleSet::load (const char *buf, int len) {
+   CssReader reader = { buf, buf + len, true }, *r = &reader;
+   uint32_t n;
+   int firstSel = selectors.size (), firstList = propertyLists.size ();
+
+   if (len < 4 || memcmp (buf, CSS_SAVE_MAGIC, 4) != 0)
+      return false;
+   r->p += 4;
+   if (Css_get_uint (r) != CSS_SAVE_VERSION ||
+       Css_get_uint (r) != CSS_PROPERTY_LAST)
+      return false;
+
+   n = Css_get_uint (r);
+   for (uint32_t i = 0; r->ok && i < n; i++)
+      Css_load_selector (r, newSelector ());
+   n = Css_get_uint (r);
+   for (uint32_t i = 0; r->ok && i < n; i++)
+      Css_load_property_list (r, newPropertyList ());
+
+   n = Css_get_uint (r);
+   for (uint32_t i = 0; r->ok && i < n; i++) {
+      uint32_t sel = Css_get_uint (r), list = Css_get_uint (r),
+               order = Css_get_uint (r);
+
+      if (sel >= (uint32_t) (selectors.size () - firstSel) ||
+          list >= (uint32_t) (propertyLists.size () - firstList) ||
+          order >= CSS_PRIMARY_LAST)
+         r->ok = false;
+      else
+         addRule (selectors.get (firstSel + sel),
+                  propertyLists.get (firstList + list),
+                  (CssPrimaryOrder) order);
+   }
+   return r->ok && r->p == r->end;
+}
@@ -346,16 +346,26 @@ class CssPropertyList : public lout::misc::SimpleVector <CssProperty> {
       void set (CssPropertyName name, CssValueType type,
                 CssPropertyValue value);
       void apply (CssPropertyList *props);
+      bool equals (const CssPropertyList *props) const;
+      unsigned hashValue () const;
       bool isSafe () { return safe; };
       void print ();
+      void save (Dstr *ds);
       inline void ref () { refCount++; }
       inline void unref () { if (--refCount == 0) delete this; }
 };
 
+/**
+ * \brief A simple selector, e.g. "p.note".
+ *
+ * The strings are allocated from the zone of the CssRuleSet that the
+ * selector belongs to.
+ */
 class CssSimpleSelector {
    private:
+      lout::misc::ZoneAllocator *zone;
       int element;
-      char *pseudo, *id;
+      const char *pseudo, *id;
       lout::misc::SimpleVector <char *> klass;
 
    public:
@@ -371,8 +381,7 @@ class CssSimpleSelector {
          SELECT_ID,
       } SelectType;
 
-      CssSimpleSelector ();
-      ~CssSimpleSelector ();
+      CssSimpleSelector (lout::misc::ZoneAllocator *zone);
       inline void setElement (int e) { element = e; };
       void setSelect (SelectType t, const char *v);
       inline lout::misc::SimpleVector <char *> *getClass () { return &klass; };
@@ -382,6 +391,7 @@ class CssSimpleSelector {
       bool match (const DoctreeNode *node);
       int specificity ();
       void print ();
+      void save (Dstr *ds);
 };
 
 class MatchCache : public lout::misc::SimpleVector <int> {
@@ -409,14 +419,20 @@ class CssSelector {
          CssSimpleSelector *selector;
       };
 
-      int refCount, matchCacheOffset;
+      static const int maxAncestorHashes = 4;
+
+      lout::misc::ZoneAllocator *zone;
       lout::misc::SimpleVector <struct CombinatorAndSelector> selectorList;
+      int numAncestorHashes;    /**< -1 until computed */
+      unsigned ancestorHashes[maxAncestorHashes];
 
       bool match (Doctree *dt, const DoctreeNode *node, int i, Combinator comb,
-                  MatchCache *matchCache);
+                  MatchCache *matchCache, int matchCacheOffset);
+      void computeAncestorHashes ();
+      bool ancestorsMayMatch (Doctree *dt);
 
    public:
-      CssSelector ();
+      CssSelector (lout::misc::ZoneAllocator *zone);
       ~CssSelector ();
       void addSimpleSelector (Combinator c);
       inline CssSimpleSelector *top () {
@@ -424,39 +440,37 @@ class CssSelector {
       }
       inline int size () { return selectorList.size (); };
       inline bool match (Doctree *dt, const DoctreeNode *node,
-                         MatchCache *matchCache) {
-         return match (dt, node, selectorList.size () - 1, COMB_NONE,
-                       matchCache);
-      }
-      inline void setMatchCacheOffset (int mo) {
-         if (matchCacheOffset == -1)
-            matchCacheOffset = mo;
-      }
-      inline int getRequiredMatchCache () {
-         return matchCacheOffset + size ();
+                         MatchCache *matchCache, int matchCacheOffset) {
+         return ancestorsMayMatch (dt) &&
+                match (dt, node, selectorList.size () - 1, COMB_NONE,
+                       matchCache, matchCacheOffset);
       }
       int specificity ();
       bool checksPseudoClass ();
+      /** Whether the subject depends on its preceding siblings. */
+      inline bool matchesSiblings () {
+         return selectorList.getRef (selectorList.size () - 1)->combinator ==
+                COMB_ADJACENT_SIBLING;
+      }
       void print ();
-      inline void ref () { refCount++; }
-      inline void unref () { if (--refCount == 0) delete this; }
+      void save (Dstr *ds);
 };
 
 /**
  * \brief A CssSelector CssPropertyList pair.
  *
  *  The CssPropertyList is applied if the CssSelector matches.
+ *  Both belong to a CssRuleSet, which the context keeps alive.
  */
 class CssRule {
    private:
       CssPropertyList *props;
-      int spec, pos;
+      int spec, pos, matchCacheOffset;
 
    public:
       CssSelector *selector;
 
       CssRule (CssSelector *selector, CssPropertyList *props, int pos);
-      ~CssRule ();
 
       void apply (CssPropertyList *props, Doctree *docTree,
                   const DoctreeNode *node, MatchCache *matchCache) const;
@@ -465,6 +479,12 @@ class CssRule {
       };
       inline int specificity () { return spec; };
       inline int position () { return pos; };
+      /* The selector may be shared with other contexts, so the slots it
+       * uses in the context's MatchCache are kept here. */
+      inline void setMatchCacheOffset (int mo) { matchCacheOffset = mo; }
+      inline int getRequiredMatchCache () {
+         return matchCacheOffset + selector->size ();
+      }
       void print ();
 };
 
@@ -512,25 +532,94 @@ class CssStyleSheet {
       int getRequiredMatchCache () { return requiredMatchCache; }
 };
 
+class CssRuleSet;
+
 /**
  * \brief A set of CssStyleSheets.
  */
 class CssContext {
    private:
       static CssStyleSheet userAgentSheet;
+      static bool userAgentMatchesSiblings;
       CssStyleSheet sheet[CSS_PRIMARY_USER_IMPORTANT + 1];
       MatchCache matchCache;
+      lout::misc::SimpleVector <CssRuleSet*> ruleSets; /**< of the rules */
       int pos;
+      bool matchesSiblings;
+
+      void apply (CssPropertyList *props,
+         Doctree *docTree, DoctreeNode *node,
+         CssPropertyList *tagStyle, CssPropertyList *tagStyleImportant,
+         CssPropertyList *nonCssHints, MatchCache *matchCache);
 
    public:
       CssContext ();
+      ~CssContext ();
 
       void addRule (CssSelector *sel, CssPropertyList *props,
                     CssPrimaryOrder order);
+      void hold (CssRuleSet *ruleSet);
       void apply (CssPropertyList *props,
          Doctree *docTree, DoctreeNode *node,
          CssPropertyList *tagStyle, CssPropertyList *tagStyleImportant,
          CssPropertyList *nonCssHints);
+      void reapply (CssPropertyList *props, Doctree *docTree,
+                    DoctreeNode *node, CssPropertyList *nonCssHints);
+      /** Increases whenever a rule is added. */
+      inline int getRuleCount () { return pos; }
+      /** Whether siblings that only differ in their position can be told
+       *  apart by any rule (i.e. whether one uses the '+' combinator). */
+      inline bool canShareSiblingStyles () {
+         return !userAgentMatchesSiblings && !matchesSiblings;
+      }
+};
+
+/**
+ * \brief The result of parsing a stylesheet.
+ *
+ * The rules and the @import URLs are kept in the order they were found,
+ * so that the stylesheet can be added to any number of CssContexts
+ * without parsing it again. Selectors and property lists are shared
+ * with those contexts; they are not modified after parsing.
+ *
+ * The selectors, their strings and the property lists are allocated
+ * together from a zone, and freed all at once with the rule set. The
+ * contexts hold a reference to it for this reason.
+ */
+class CssRuleSet {
+   private:
+      struct Rule {
+         CssSelector *selector;
+         CssPropertyList *props;
+         CssPrimaryOrder order;
+      };
+
+      lout::misc::ZoneAllocator zone;
+      lout::misc::SimpleVector <Rule> rules;
+      lout::misc::SimpleVector <CssSelector*> selectors;
+      lout::misc::SimpleVector <CssPropertyList*> propertyLists;
+      lout::misc::SimpleVector <DilloUrl*> imports;
+      int refCount;
+
+   public:
+      CssRuleSet () : zone (8192), rules (16), selectors (16),
+                      propertyLists (16), imports (1) { refCount = 0; }
+      ~CssRuleSet ();
+
+      CssSelector *newSelector ();
+      CssPropertyList *newPropertyList ();
+
+      void addRule (CssSelector *sel, CssPropertyList *props,
+                    CssPrimaryOrder order);
+      void addImport (const DilloUrl *url);
+      inline int numImports () { return imports.size (); }
+      inline DilloUrl *getImport (int i) { return imports.get (i); }
+      inline int numRules () { return rules.size (); }
+      void addTo (CssContext *context);
+      void save (Dstr *ds);
+      bool load (const char *buf, int len);
+      inline void ref () { refCount++; }
+      inline void unref () { if (--refCount == 0) delete this; }
 };
 
 #endif
@@ -19,9 +19,11 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "msg.h"
 #include "colors.h"
+#include "charscan.h"
 #include "html_common.hh"
 #include "css.hh"
 #include "cssparser.hh"
@@ -455,11 +457,39 @@ static const CssShorthandInfo Css_shorthand_info[] = {
  *    Parsing
  * ---------------------------------------------------------------------- */
 
-CssParser::CssParser(CssContext *context, CssOrigin origin,
+/* Character classes for the tokenizer, looked up once per byte */
+enum {
+   CSS_CC_SPACE = 1 << 0,
+   CSS_CC_DIGIT = 1 << 1,
+   CSS_CC_XDIGIT = 1 << 2,
+   CSS_CC_NAME_START = 1 << 3,
+   CSS_CC_NAME = 1 << 4
+};
+
+static unsigned char Css_char_class[256];
+
+static void Css_char_class_init()
+{
+   for (int c = 0; c < 256; c++)
+      Css_char_class[c] =
+         (isspace(c) ? CSS_CC_SPACE : 0) |
+         (isdigit(c) ? CSS_CC_DIGIT : 0) |
+         (isxdigit(c) ? CSS_CC_XDIGIT : 0) |
+         (isalpha(c) || c == '_' || c == '-' ? CSS_CC_NAME_START : 0) |
+         (isalnum(c) || c == '_' || c == '-' ? CSS_CC_NAME : 0);
+}
+
+#define CSS_IS(cc, c) (Css_char_class[(unsigned char)(c)] & (cc))
+
+/* Skip over the characters of one class. */
+#define CSS_SPAN(p, end, cc) \
+   while ((p) < (end) && CSS_IS(cc, *(p))) (p)++
+
+CssParser::CssParser(CssRuleSet *ruleSet, CssOrigin origin,
                      const DilloUrl *baseUrl,
                      const char *buf, int buflen)
 {
-   this->context = context;
+   this->ruleSet = ruleSet;
    this->origin = origin;
    this->buf = buf;
    this->buflen = buflen;
@@ -468,199 +498,135 @@ CssParser::CssParser(CssContext *context, CssOrigin origin,
    this->withinBlock = false;
    this->baseUrl = baseUrl;
 
+   if (!Css_char_class[(unsigned char)' '])
+      Css_char_class_init();
    nextToken ();
 }
 
 /**
- * Gets the next character from the buffer, or EOF.
- */
-int CssParser::getChar()
-{
-   int c;
-
-   if (bufptr >= buflen)
-      c = EOF;
-   else
-      c = buf[bufptr];
-
-   /* The buffer pointer is increased in any case, so that ungetChar works
-    * correctly at the end of the buffer. */
-   bufptr++;
-   return c;
-}
-
-/**
- * Undoes the last getChar().
- */
-void CssParser::ungetChar()
-{
-   bufptr--;
-}
-
-/**
- * Skip string str if it is found in the input buffer.
- * If string is found leave bufptr pointing to last matched char.
- * If not wind back. The first char is passed as parameter c
- * to avoid unnecessary getChar() / ungetChar() calls.
+ * Set the token value to a span of the buffer (silently truncated).
  */
-inline bool CssParser::skipString(int c, const char *str)
+inline void CssParser::setTval(const char *s, int len)
 {
-   for (int n = 0; str[n]; n++) {
-      if (n > 0)
-         c = getChar();
-
-      if (str[n] != c) {
-         while (n--)
-            ungetChar();
-         return false;
-      }
-   }
-
-   return true;
+   if (len > maxStrLen - 1)
+      len = maxStrLen - 1;
+   memcpy(tval, s, len);
+   tval[len] = 0;
 }
 
 void CssParser::nextToken()
 {
-   int c, c1, d, j;
-   char hexbuf[5];
-   int i = 0;
+   static CharscanSet spaceSet = CHARSCAN_SET(" \t\n\v\f\r");
+   static CharscanSet dquoteSet = CHARSCAN_SET("\"\\");
+   static CharscanSet squoteSet = CHARSCAN_SET("'\\");
+   const char *p = buf + bufptr, *end = buf + buflen, *start, *q;
+   int c;
 
    ttype = CSS_TK_CHAR; /* init */
    spaceSeparated = false;
 
-   while (true) {
-      c = getChar();
-      if (isspace(c)) {                    // ignore whitespace
+   while (p < end) {
+      if (CSS_IS(CSS_CC_SPACE, *p)) {      // ignore whitespace
          spaceSeparated = true;
-      } else if (skipString(c, "/*")) {    // ignore comments
-         do {
-            c = getChar();
-         } while (c != EOF && ! skipString(c, "*/"));
-      } else if (skipString(c, "<!--")) {  // ignore XML comment markers
-      } else if (skipString(c, "-->")) {
+         /* Most runs are short, only long ones are worth the vector scan. */
+         for (q = p + 1; q < end && q < p + 16 && CSS_IS(CSS_CC_SPACE, *q);
+              q++) ;
+         if (q == p + 16)
+            q += a_Charscan_skip(q, end - q, &spaceSet);
+         p = q;
+      } else if (end - p >= 2 && p[0] == '/' && p[1] == '*') {
+         // ignore comments
+         for (q = p + 2;
+              (q = (const char *) memchr(q, '*', end - q)) &&
+              q + 1 < end && q[1] != '/';
+              q++) ;
+         p = (q && q + 1 < end) ? q + 2 : end;
+      } else if (end - p >= 4 && !memcmp(p, "<!--", 4)) {
+         p += 4;                           // ignore XML comment markers
+      } else if (end - p >= 3 && !memcmp(p, "-->", 3)) {
+         p += 3;
       } else {
          break;
       }
    }
 
-   // handle negative numbers
-   if (c == '-') {
-      if (i < maxStrLen - 1)
-         tval[i++] = c;
-      c = getChar();
+   if (p == end) {
+      bufptr = buflen;
+      DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token %s\n", "EOF");
+      ttype = CSS_TK_END;
+      return;
    }
 
-   if (isdigit(c)) {
-      ttype = CSS_TK_DECINT;
-      do {
-         if (i < maxStrLen - 1) {
-            tval[i++] = c;
-         }
-         /* else silently truncated */
-         c = getChar();
-      } while (isdigit(c));
-      if (c != '.')
-         ungetChar();
-
-      /* ...but keep going to see whether it's really a float */
-   }
+   start = p;
+   q = (*p == '-') ? p + 1 : p;   // handle negative numbers
 
-   if (c == '.') {
-      c = getChar();
-      if (isdigit(c)) {
+   if (q < end && (CSS_IS(CSS_CC_DIGIT, *q) ||
+                   (*q == '.' && q + 1 < end &&
+                    CSS_IS(CSS_CC_DIGIT, q[1])))) {
+      ttype = CSS_TK_DECINT;
+      CSS_SPAN(q, end, CSS_CC_DIGIT);
+      if (q + 1 < end && *q == '.' && CSS_IS(CSS_CC_DIGIT, q[1])) {
          ttype = CSS_TK_FLOAT;
-         if (i < maxStrLen - 1)
-            tval[i++] = '.';
-         do {
-            if (i < maxStrLen - 1)
-               tval[i++] = c;
-            /* else silently truncated */
-            c = getChar();
-         } while (isdigit(c));
-
-         ungetChar();
-         tval[i] = 0;
-         DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token number %s\n", tval);
-         return;
-      } else {
-         ungetChar();
-         if (ttype == CSS_TK_DECINT) {
-            ungetChar();
-         } else {
-            c = '.';
-         }
+         q++;
+         CSS_SPAN(q, end, CSS_CC_DIGIT);
       }
-   }
-
-   if (ttype == CSS_TK_DECINT) {
-      tval[i] = 0;
+      setTval(start, q - start);
+      bufptr = q - buf;
       DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token number %s\n", tval);
       return;
    }
 
-   if (i) {
-      ungetChar(); /* ungetChar '-' */
-      i--;
-      c = getChar();
-   }
+   c = (unsigned char)*p;
 
-   if (isalpha(c) || c == '_' || c == '-') {
+   if (CSS_IS(CSS_CC_NAME_START, c)) {
       ttype = CSS_TK_SYMBOL;
-
-      tval[0] = c;
-      i = 1;
-      c = getChar();
-      while (isalnum(c) || c == '_' || c == '-') {
-         if (i < maxStrLen - 1) {
-            tval[i] = c;
-            i++;
-         }                      /* else silently truncated */
-         c = getChar();
-      }
-      tval[i] = 0;
-      ungetChar();
+      q = p + 1;
+      CSS_SPAN(q, end, CSS_CC_NAME);
+      setTval(start, q - start);
+      bufptr = q - buf;
       DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token symbol '%s'\n", tval);
       return;
    }
 
    if (c == '"' || c == '\'') {
-      c1 = c;
-      ttype = CSS_TK_STRING;
+      CharscanSet *stopSet = (c == '"') ? &dquoteSet : &squoteSet;
+      int i = 0, len, d;
+      char hexbuf[5];
 
-      i = 0;
-      c = getChar();
-
-      while (c != EOF && c != c1) {
-         if (c == '\\') {
-            d = getChar();
-            if (isxdigit(d)) {
-               /* Read hex Unicode char. (Actually, strings are yet only 8
-                * bit.) */
-               hexbuf[0] = d;
-               j = 1;
-               d = getChar();
-               while (j < 4 && isxdigit(d)) {
-                  hexbuf[j] = d;
-                  j++;
-                  d = getChar();
-               }
-               hexbuf[j] = 0;
-               ungetChar();
-               c = strtol(hexbuf, NULL, 16);
-            } else {
-               /* Take character literally. */
-               c = d;
-            }
+      ttype = CSS_TK_STRING;
+      p++;
+      while (p < end && *p != c) {
+         if (*p != '\\') {
+            /* Copy up to the next quote or backslash in one go. */
+            q = p + a_Charscan_find(p, end - p, stopSet);
+            if (q == p)    // a NUL byte
+               q++;
+            len = lout::misc::min((int)(q - p), maxStrLen - 1 - i);
+            memcpy(tval + i, p, len);
+            i += len;
+            p = q;
+            continue;
          }
 
-         if (i < maxStrLen - 1) {
-            tval[i] = c;
-            i++;
-         }                      /* else silently truncated */
-         c = getChar();
+         if (++p == end)
+            break;
+         if (CSS_IS(CSS_CC_XDIGIT, *p)) {
+            /* Read hex Unicode char. (Actually, strings are yet only 8
+             * bit.) */
+            for (len = 0; len < 4 && p < end && CSS_IS(CSS_CC_XDIGIT, *p);
+                 len++)
+               hexbuf[len] = *p++;
+            hexbuf[len] = 0;
+            d = strtol(hexbuf, NULL, 16);
+         } else {
+            /* Take character literally. */
+            d = *p++;
+         }
+         if (i < maxStrLen - 1)
+            tval[i++] = d;
       }
       tval[i] = 0;
-      /* No ungetChar(). */
+      bufptr = (p < end) ? p + 1 - buf : buflen;  // skip the closing quote
       DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token string '%s'\n", tval);
       return;
    }
@@ -670,32 +636,18 @@ void CssParser::nextToken()
     */
    if (c == '#' && withinBlock) {
       ttype = CSS_TK_COLOR;
-
-      tval[0] = c;
-      i = 1;
-      c = getChar();
-      while (isxdigit(c)) {
-         if (i < maxStrLen - 1) {
-            tval[i] = c;
-            i++;
-         }                      /* else silently truncated */
-         c = getChar();
-      }
-      tval[i] = 0;
-      ungetChar();
+      q = p + 1;
+      CSS_SPAN(q, end, CSS_CC_XDIGIT);
+      setTval(start, q - start);
+      bufptr = q - buf;
       DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token color '%s'\n", tval);
       return;
    }
 
-   if (c == EOF) {
-      DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token %s\n", "EOF");
-      ttype = CSS_TK_END;
-      return;
-   }
-
    ttype = CSS_TK_CHAR;
    tval[0] = c;
    tval[1] = 0;
+   bufptr = p + 1 - buf;
    DEBUG_MSG(DEBUG_TOKEN_LEVEL, "token char '%c'\n", c);
 }
 
@@ -1478,11 +1430,11 @@ bool CssParser::parseSimpleSelector(CssSimpleSelector *selector)
 
 CssSelector *CssParser::parseSelector()
 {
-   CssSelector *selector = new CssSelector ();
+   /* An invalid selector is just dropped, it goes with the rule set. */
+   CssSelector *selector = ruleSet->newSelector ();
 
    while (true) {
       if (! parseSimpleSelector (selector->top ())) {
-         delete selector;
          selector = NULL;
          break;
       }
@@ -1499,7 +1451,6 @@ CssSelector *CssParser::parseSelector()
       } else if (ttype != CSS_TK_END && spaceSeparated) {
          selector->addSimpleSelector (CssSelector::COMB_DESCENDANT);
       } else {
-         delete selector;
          selector = NULL;
          break;
       }
@@ -1525,7 +1476,6 @@ void CssParser::parseRuleset()
       selector = parseSelector();
 
       if (selector) {
-         selector->ref();
          list->increase();
          list->set(list->size() - 1, selector);
       }
@@ -1544,10 +1494,8 @@ void CssParser::parseRuleset()
 
    DEBUG_MSG(DEBUG_PARSE_LEVEL, "end of %s\n", "selectors");
 
-   props = new CssPropertyList(true);
-   props->ref();
-   importantProps = new CssPropertyList(true);
-   importantProps->ref();
+   props = ruleSet->newPropertyList();
+   importantProps = ruleSet->newPropertyList();
 
    /* Read block. ('{' has already been read.) */
    if (ttype != CSS_TK_END) {
@@ -1564,21 +1512,16 @@ void CssParser::parseRuleset()
       CssSelector *s = list->get(i);
 
       if (origin == CSS_ORIGIN_USER_AGENT) {
-         context->addRule(s, props, CSS_PRIMARY_USER_AGENT);
+         ruleSet->addRule(s, props, CSS_PRIMARY_USER_AGENT);
       } else if (origin == CSS_ORIGIN_USER) {
-         context->addRule(s, props, CSS_PRIMARY_USER);
-         context->addRule(s, importantProps, CSS_PRIMARY_USER_IMPORTANT);
+         ruleSet->addRule(s, props, CSS_PRIMARY_USER);
+         ruleSet->addRule(s, importantProps, CSS_PRIMARY_USER_IMPORTANT);
       } else if (origin == CSS_ORIGIN_AUTHOR) {
-         context->addRule(s, props, CSS_PRIMARY_AUTHOR);
-         context->addRule(s, importantProps, CSS_PRIMARY_AUTHOR_IMPORTANT);
+         ruleSet->addRule(s, props, CSS_PRIMARY_AUTHOR);
+         ruleSet->addRule(s, importantProps, CSS_PRIMARY_AUTHOR_IMPORTANT);
       }
-
-      s->unref();
    }
 
-   props->unref();
-   importantProps->unref();
-
    delete list;
 
    if (ttype == CSS_TK_CHAR && tval[0] == '}')
@@ -1673,11 +1616,18 @@ void CssParser::parseImport(DilloHtml *html)
 
    if (urlStr) {
       if (importSyntaxIsOK && mediaIsSelected) {
+         DilloUrl *url;
+
          MSG("CssParser::parseImport(): @import %s\n", urlStr);
-         DilloUrl *url = a_Html_url_new (html, urlStr, a_Url_str(this->baseUrl),
-                                         this->baseUrl ? 1 : 0);
-         a_Html_load_stylesheet(html, url);
-         a_Url_free(url);
+         if (html)
+            url = a_Html_url_new (html, urlStr, a_Url_str(this->baseUrl),
+                                  this->baseUrl ? 1 : 0);
+         else
+            url = a_Url_new (urlStr, a_Url_str(this->baseUrl));
+         if (url) {
+            ruleSet->addImport(url);
+            a_Url_free(url);
+         }
       }
       dFree (urlStr);
    }
@@ -1768,11 +1718,11 @@ void CssParser::ignoreStatement()
 }
 
 void CssParser::parse(DilloHtml *html, const DilloUrl *baseUrl,
-                      CssContext *context,
+                      CssRuleSet *ruleSet,
                       const char *buf,
                       int buflen, CssOrigin origin)
 {
-   CssParser parser (context, origin, baseUrl, buf, buflen);
+   CssParser parser (ruleSet, origin, baseUrl, buf, buflen);
    bool importsAreAllowed = true;
 
    while (parser.ttype != CSS_TK_END) {
@@ -1799,6 +1749,31 @@ void CssParser::parse(DilloHtml *html, const DilloUrl *baseUrl,
    }
 }
 
+/**
+ * Collect the @import rules at the start of a stylesheet, which are the
+ * only ones that count, without parsing the rest of it.
+ *
+ * This lets the imported stylesheets be requested as soon as the one
+ * that imports them arrives.
+ */
+void CssParser::scanImports(const DilloUrl *baseUrl, CssRuleSet *ruleSet,
+                            const char *buf, int buflen)
+{
+   CssParser parser (ruleSet, CSS_ORIGIN_AUTHOR, baseUrl, buf, buflen);
+
+   while (parser.ttype == CSS_TK_CHAR && parser.tval[0] == '@') {
+      parser.nextToken();
+      if (parser.ttype == CSS_TK_SYMBOL &&
+          dStrAsciiCasecmp(parser.tval, "import") == 0)
+         parser.parseImport(NULL);
+      else if (parser.ttype == CSS_TK_SYMBOL &&
+               dStrAsciiCasecmp(parser.tval, "charset") == 0)
+         parser.ignoreStatement();
+      else
+         break;
+   }
+}
+
 void CssParser::parseDeclarationBlock(const DilloUrl *baseUrl,
                                       const char *buf, int buflen,
                                       CssPropertyList *props,
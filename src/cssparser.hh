@@ -13,7 +13,7 @@ class CssParser {
       } CssTokenType;
 
       static const int maxStrLen = 256;
-      CssContext *context;
+      CssRuleSet *ruleSet;
       CssOrigin origin;
       const DilloUrl *baseUrl;
 
@@ -25,12 +25,10 @@ class CssParser {
       bool withinBlock;
       bool spaceSeparated; /* used when parsing CSS selectors */
 
-      CssParser(CssContext *context, CssOrigin origin, const DilloUrl *baseUrl,
+      CssParser(CssRuleSet *ruleSet, CssOrigin origin, const DilloUrl *baseUrl,
                 const char *buf, int buflen);
-      int getChar();
-      void ungetChar();
+      inline void setTval(const char *s, int len);
       void nextToken();
-      bool skipString(int c, const char *string);
       bool tokenMatchesProperty(CssPropertyName prop, CssValueType * type);
       bool parseValue(CssPropertyName prop, CssValueType type,
                       CssPropertyValue * val);
@@ -53,8 +51,11 @@ class CssParser {
                                         const char *buf, int buflen,
                                         CssPropertyList *props,
                                         CssPropertyList *propsImortant);
-      static void parse(DilloHtml *html, const DilloUrl *baseUrl, CssContext *context,
-                        const char *buf, int buflen, CssOrigin origin);
+      static void parse(DilloHtml *html, const DilloUrl *baseUrl,
+                        CssRuleSet *ruleSet, const char *buf, int buflen,
+                        CssOrigin origin);
+      static void scanImports(const DilloUrl *baseUrl, CssRuleSet *ruleSet,
+                              const char *buf, int buflen);
       static const char *propertyNameString(CssPropertyName name);
 };
 
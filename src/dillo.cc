@@ -51,6 +51,7 @@
 
 #include "dns.h"
 #include "web.hh"
+#include "html.hh"
 #include "IO/tls.h"
 #include "IO/Url.h"
 #include "IO/mime.h"
@@ -480,6 +481,7 @@ int main(int argc, char **argv)
    dLib_show_messages(prefs.show_msg);
 
    // initialize internal modules
+   a_Html_init();
    a_Dpi_init();
    a_Dns_init();
    a_Web_init();
@@ -1,6 +1,8 @@
 #ifndef __DOCTREE_HH__
 #define __DOCTREE_HH__
 
+#include <new>
+#include <string.h>
 #include "lout/misc.hh"
 
 class DoctreeNode {
@@ -24,18 +26,10 @@ class DoctreeNode {
          element = 0;
       };
 
+      /* The node, its id and its class names live in the document's zone,
+       * only the vector itself needs to be freed. */
       ~DoctreeNode () {
-         dFree ((void*) id);
-         while (lastChild) {
-            DoctreeNode *n = lastChild;
-            lastChild = lastChild->sibling;
-            delete n;
-         }
-         if (klass) {
-            for (int i = 0; i < klass->size (); i++)
-               dFree (klass->get(i));
-            delete klass;
-         }
+         delete klass;
       }
 };
 
@@ -44,26 +38,82 @@ class DoctreeNode {
  *
  * The Doctree class defines the interface to the parsed HTML document tree
  * as it is used for CSS selector matching.
+ *
+ * The nodes are allocated from a zone that belongs to the document, and
+ * are all released together with it.
+ *
+ * The doctree also keeps a counting Bloom filter of the elements, ids and
+ * classes of the open nodes (i.e. the ancestors of the top node, and the
+ * top node itself). If a hash is not in it, no ancestor can match a
+ * selector that requires it, which lets CssSelector::match () skip the
+ * walk up the tree. The hashes are added by the StyleEngine as it learns
+ * about them, and removed here in pop ().
  */
 class Doctree {
    private:
+      static const int filterBits = 12;
+      static const unsigned filterMask = (1 << filterBits) - 1;
+
       DoctreeNode *topNode;
       DoctreeNode *rootNode;
       int num;
+      lout::misc::ZoneAllocator *zone;
+      unsigned char filter[1 << filterBits];
+
+      inline DoctreeNode *newNode () {
+         return new (zone->zoneAllocAligned (sizeof (DoctreeNode)))
+            DoctreeNode ();
+      }
+
+      inline void filterRemove (unsigned hash) {
+         unsigned char *c1 = &filter[hash & filterMask],
+                       *c2 = &filter[(hash >> filterBits) & filterMask];
+
+         /* saturated counters stay, the filter only gets less precise */
+         if (*c1 != 255)
+            (*c1)--;
+         if (*c2 != 255)
+            (*c2)--;
+      }
 
    public:
-      Doctree () {
-         rootNode = new DoctreeNode;
+      int filterRejected, filterWalked; /* statistics */
+      /* Off while a node that may be closed already is matched again, as
+       * the filter only knows about the ancestors of the open ones. */
+      bool filterEnabled;
+
+      Doctree (lout::misc::ZoneAllocator *zone) {
+         this->zone = zone;
+         rootNode = newNode ();
          topNode = rootNode;
          num = 0;
+         memset (filter, 0, sizeof (filter));
+         filterRejected = filterWalked = 0;
+         filterEnabled = true;
       };
 
       ~Doctree () {
-         delete rootNode;
+         DoctreeNode *n = rootNode;
+
+         /* Walk the tree bottom-up, without recursion. */
+         while (n) {
+            DoctreeNode *child = n->lastChild;
+
+            if (child) {
+               n->lastChild = child->sibling;
+               n = child;
+            } else {
+               DoctreeNode *parent = n->parent;
+               n->~DoctreeNode ();
+               n = parent;
+            }
+         }
       };
 
+      inline lout::misc::ZoneAllocator *getZone () { return zone; }
+
       DoctreeNode *push () {
-         DoctreeNode *dn = new DoctreeNode ();
+         DoctreeNode *dn = newNode ();
          dn->parent = topNode;
          dn->sibling = dn->parent->lastChild;
          dn->parent->lastChild = dn;
@@ -74,9 +124,49 @@ class Doctree {
 
       void pop () {
          assert (topNode != rootNode); // never pop the root node
+         filterRemove (elementHash (topNode->element));
+         if (topNode->id)
+            filterRemove (stringHash (topNode->id));
+         if (topNode->klass)
+            for (int i = 0; i < topNode->klass->size (); i++)
+               filterRemove (stringHash (topNode->klass->get (i)));
          topNode = topNode->parent;
       };
 
+      /**
+       * \brief Hash of an element, for the filter.
+       */
+      static inline unsigned elementHash (int element) {
+         return (unsigned) (element + 1) * 0x9e3779b1u;
+      }
+
+      /**
+       * \brief Hash of an id or class, for the filter (ASCII case
+       * insensitive, as the matching is).
+       */
+      static inline unsigned stringHash (const char *s) {
+         unsigned hash = 2166136261u;
+
+         for ( ; *s; s++)
+            hash = (hash ^ (unsigned char) D_ASCII_TOLOWER (*s)) * 16777619u;
+         return hash;
+      }
+
+      inline void filterAdd (unsigned hash) {
+         unsigned char *c1 = &filter[hash & filterMask],
+                       *c2 = &filter[(hash >> filterBits) & filterMask];
+
+         if (*c1 != 255)
+            (*c1)++;
+         if (*c2 != 255)
+            (*c2)++;
+      }
+
+      inline bool filterMayContain (unsigned hash) {
+         return filter[hash & filterMask] &&
+                filter[(hash >> filterBits) & filterMask];
+      }
+
       inline DoctreeNode *top () {
          if (topNode != rootNode)
             return topNode;
@@ -717,7 +717,9 @@ void Html_tag_close_textarea(DilloHtml *html)
       }
 
       /* The HTML3.2 spec says it can have "text and character entities". */
-      str = a_Html_parse_entities(html, html->Stash->str, html->Stash->len);
+      if (!(str = a_Html_parse_entities(html, html->Stash->str,
+                                        html->Stash->len)))
+         str = dStrndup(html->Stash->str, html->Stash->len);
       input = Html_get_current_input(html);
       if (input) {
          input->init_str = str;
@@ -22,17 +22,23 @@
 #include <stdlib.h>
 #include <stdio.h>      /* for sprintf */
 #include <errno.h>
+#include <time.h>       /* for clock_gettime */
+#include <pthread.h>
+#include <atomic>
 
 #include "bw.h"         /* for BrowserWindow */
 #include "msg.h"
 #include "binaryconst.h"
 #include "colors.h"
 #include "html_charrefs.h"
+#include "html_charref_trie.h"
 #include "utf8.hh"
 
 #include "misc.h"
+#include "charscan.h"
 #include "uicmd.hh"
 #include "history.h"
+#include "timeout.hh"
 #include "menu.hh"
 #include "prefs.h"
 #include "capi.h"
@@ -73,22 +79,15 @@ class DilloHtml;
 typedef void (*TagOpenFunct) (DilloHtml *html, const char *tag, int tagsize);
 typedef void (*TagCloseFunct) (DilloHtml *html);
 
-typedef enum {
-   SEEK_ATTR_START,
-   MATCH_ATTR_NAME,
-   SEEK_TOKEN_START,
-   SEEK_VALUE_START,
-   SKIP_VALUE,
-   GET_VALUE,
-   FINISHED
-} DilloHtmlTagParsingState;
-
 typedef enum {
    HTML_LeftTrim      = 1 << 0,
    HTML_RightTrim     = 1 << 1,
    HTML_ParseEntities = 1 << 2
 } DilloHtmlTagParsingFlags;
 
+/* Pages smaller than this are always tokenized on the main thread */
+#define HTML_TOKENIZER_MIN_SIZE (64 * 1024)
+
 
 /*
  * Exported function with C linkage.
@@ -101,10 +100,18 @@ void *a_Html_text(const char *type, void *P, CA_Callback_t *Call,void **Data);
  * Forward declarations
  *---------------------------------------------------------------------------*/
 static int Html_write_raw(DilloHtml *html, char *buf, int bufsize, int Eof);
+static int Html_write_tokens(DilloHtml *html, char *buf, int Eof);
+static HtmlTokenizer *Html_tokenizer_new(DilloHtml *html);
+static void Html_tokenizer_feed(HtmlTokenizer *tk, const char *Buf,
+                                int BufSize, int Eof);
+static void Html_tokenizer_pause(HtmlTokenizer *tk);
+static void Html_tokenizer_free(HtmlTokenizer *tk);
+static void Html_preload_scan(DilloHtml *html);
 static bool Html_load_image(BrowserWindow *bw, DilloUrl *url,
                             const DilloUrl *requester, DilloImage *image);
 static void Html_callback(int Op, CacheClient_t *Client);
 static void Html_tag_cleanup_at_close(DilloHtml *html, int TagIdx);
+static void Html_split_attrs(DilloHtml *html, const char *tag, int tagsize);
 int a_Html_tag_index(const char *tag);
 
 /*-----------------------------------------------------------------------------
@@ -123,17 +130,23 @@ typedef struct {
 /* Some element indexes required in scattered places */
 static int
    i_A = a_Html_tag_index("a"),
+   i_BASE = a_Html_tag_index("base"),
    i_BODY = a_Html_tag_index("body"),
    i_BUTTON = a_Html_tag_index("button"),
    i_DD = a_Html_tag_index("dd"),
    i_DT = a_Html_tag_index("dt"),
+   i_HEAD = a_Html_tag_index("head"),
    i_HTML = a_Html_tag_index("html"),
    i_HR = a_Html_tag_index("hr"),
+   i_IMG = a_Html_tag_index("img"),
    i_LI = a_Html_tag_index("li"),
+   i_LINK = a_Html_tag_index("link"),
    i_OPTGROUP = a_Html_tag_index("optgroup"),
    i_OPTION = a_Html_tag_index("option"),
    i_P  = a_Html_tag_index("p"),
+   i_SCRIPT = a_Html_tag_index("script"),
    i_SELECT = a_Html_tag_index("select"),
+   i_STYLE = a_Html_tag_index("style"),
    i_TEXTAREA = a_Html_tag_index("textarea"),
    i_TD = a_Html_tag_index("td"),
    i_TR = a_Html_tag_index("tr"),
@@ -308,9 +321,30 @@ static int Html_set_new_link(DilloHtml *html, DilloUrl **url)
    int nl = html->links->size();
    html->links->increase();
    html->links->set(nl, (*url) ? *url : NULL);
+   html->linkNodes->increase();
+   html->linkNodes->set(nl, html->styleEngine->getDoctreeNode());
    return nl;
 }
 
+/**
+ * Find the color a link gets once it is visited: what the stylesheets say
+ * for its element, or else the one computed for all the visited links of
+ * the page. Returns -1 if the link has the color already.
+ */
+static int32_t Html_visited_link_color(DilloHtml *html, int link)
+{
+   DoctreeNode *dn = html->linkNodes->get(link);
+   int32_t color = -1;
+
+   if (dn && dn->pseudo) {
+      if (strcmp(dn->pseudo, "visited") == 0)
+         return -1;
+      color = html->styleEngine->linkColor(dn, true,
+                                           html->non_css_visited_color);
+   }
+   return (color != -1) ? color : html->visited_color;
+}
+
 /**
  * Evaluates the ALIGN attribute (left|center|right|justify) and
  * sets the style at the top of the stack.
@@ -426,6 +460,72 @@ static bool Html_must_add_breaks(DilloHtml *html)
    return HT2TB(html)->mustAddBreaks (html->style ());
 }
 
+/*
+ * Documents waiting for their next parsing slice
+ */
+static Dlist *Html_slice_queue = NULL;
+static bool Html_slice_scheduled = false;
+
+/**
+ * Return a monotonic time in seconds.
+ */
+static double Html_now()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Has the current parsing slice used up its time?
+ * The clock is only read every 32 tokens.
+ */
+static inline bool Html_slice_expired(DilloHtml *html, int ntokens)
+{
+   if (html->slice_end > 0.0 && (ntokens & 31) == 0 &&
+       Html_now() >= html->slice_end) {
+      html->slice_yield = true;
+      return true;
+   }
+   return false;
+}
+
+/**
+ * Give each queued document one more slice.
+ */
+static void Html_slice_cb(void *data)
+{
+   DilloHtml *html;
+   int n = dList_length(Html_slice_queue);
+   (void) data;
+
+   /* The ones that yield again get queued for the next call */
+   Html_slice_scheduled = false;
+   while (n-- > 0 &&
+          (html = (DilloHtml *)dList_nth_data(Html_slice_queue, 0))) {
+      dList_remove(Html_slice_queue, html);
+      html->resumeParsing();
+   }
+   a_Timeout_remove();
+}
+
+/**
+ * Queue a document for another parsing slice, after pending UI events,
+ * and at least 'delay' seconds from now (unless the queue is already
+ * scheduled to run sooner).
+ */
+static void Html_slice_queue_add(DilloHtml *html, float delay)
+{
+   if (!Html_slice_queue)
+      Html_slice_queue = dList_new(4);
+   dList_append(Html_slice_queue, html);
+   if (!Html_slice_scheduled) {
+      a_Timeout_add(delay, Html_slice_cb, NULL);
+      Html_slice_scheduled = true;
+   }
+}
+
 /**
  * Create and initialize a new DilloHtml class
  */
@@ -447,6 +547,16 @@ DilloHtml::DilloHtml(BrowserWindow *p_bw, const DilloUrl *url,
    /* Init for-parsing variables */
    Start_Buf = NULL;
    Start_Ofs = 0;
+   Buf_Size = Buf_Eof = 0;
+   tokenizer = NULL;
+
+   slice_end = 0.0;
+   slice_yield = slice_pending = false;
+   finish_key = 0;
+
+   preload_ofs = preload_count = 0;
+   preload_skip = -1;
+   preload_css = preload_body = false;
 
    _MSG("DilloHtml(): content type: %s\n", content_type);
    this->content_type = dStrdup(content_type);
@@ -462,7 +572,9 @@ DilloHtml::DilloHtml(BrowserWindow *p_bw, const DilloUrl *url,
    DocType = DT_NONE;    /* assume Tag Soup 0.0!   :-) */
    DocTypeVersion = 0.0f;
 
-   styleEngine = new StyleEngine (HT2LT (this), page_url, base_url, bw->zoom);
+   zone = new misc::ZoneAllocator (16 * 1024);
+   styleEngine = new StyleEngine (HT2LT (this), page_url, base_url, bw->zoom,
+                                  zone);
 
    cssUrls = new misc::SimpleVector <DilloUrl*> (1);
 
@@ -498,7 +610,15 @@ DilloHtml::DilloHtml(BrowserWindow *p_bw, const DilloUrl *url,
 
    Num_HTML = Num_HEAD = Num_BODY = Num_TITLE = 0;
 
+   textRunBuf = dStr_sized_new(1024);
+   textRun = new misc::SimpleVector <Textblock::TextRunItem> (64);
+   textRunStyle = NULL;
+
+   word_data = dStr_sized_new(256);
    attr_data = dStr_sized_new(1024);
+   attr_tag = NULL;
+   attr_tagsize = 0;
+   attrs = new misc::SimpleVector <DilloHtmlAttr> (16);
 
    non_css_link_color = -1;
    non_css_visited_color = -1;
@@ -508,6 +628,7 @@ DilloHtml::DilloHtml(BrowserWindow *p_bw, const DilloUrl *url,
    forms = new misc::SimpleVector <DilloHtmlForm*> (1);
    inputs_outside_form = new misc::SimpleVector <DilloHtmlInput*> (1);
    links = new misc::SimpleVector <DilloUrl*> (64);
+   linkNodes = new misc::SimpleVector <DoctreeNode*> (64);
    images = new misc::SimpleVector <DilloHtmlImage*> (16);
 
    /* Initialize the main widget */
@@ -535,8 +656,13 @@ void DilloHtml::initDw()
  */
 DilloHtml::~DilloHtml()
 {
-   _MSG("::~DilloHtml(this=%p)\n", this);
+   _MSG("::~DilloHtml(this=%p) zone: %lu bytes\n", this,
+        (unsigned long)zone->zoneSize());
 
+   if (slice_pending) {
+      dList_remove(Html_slice_queue, this);
+      a_Capi_unref_buf(page_url);
+   }
    freeParseData();
 
    a_Bw_remove_doc(bw, this);
@@ -559,6 +685,7 @@ DilloHtml::~DilloHtml()
    for (int i = 0; i < links->size(); i++)
       a_Url_free(links->get(i));
    delete (links);
+   delete (linkNodes);
 
    for (int i = 0; i < images->size(); i++) {
       DilloHtmlImage *img = images->get(i);
@@ -569,6 +696,7 @@ DilloHtml::~DilloHtml()
    delete (images);
 
    delete styleEngine;
+   delete zone;
 }
 
 /**
@@ -577,10 +705,6 @@ DilloHtml::~DilloHtml()
  */
 void DilloHtml::write(char *Buf, int BufSize, int Eof)
 {
-   int token_start;
-   char *buf = Buf + Start_Ofs;
-   int bufsize = BufSize - Start_Ofs;
-
    _MSG("DilloHtml::write BufSize=%d Start_Ofs=%d\n", BufSize, Start_Ofs);
 #if 0
    char *aux = dStrndup(Buf, BufSize);
@@ -590,12 +714,99 @@ void DilloHtml::write(char *Buf, int BufSize, int Eof)
 
    /* Update Start_Buf. It may be used after the parser is stopped */
    Start_Buf = Buf;
+   Buf_Size = BufSize;
+   Buf_Eof = Eof;
 
    dReturn_if (dw == NULL);
    dReturn_if (stop_parser == true);
 
-   token_start = Html_write_raw(this, buf, bufsize, Eof);
-   Start_Ofs += token_start;
+   /* Even when the page came whole, the worker splits it into tokens
+    * while this thread builds the page */
+   if (!tokenizer && prefs.parse_in_thread &&
+       BufSize - Start_Ofs >= HTML_TOKENIZER_MIN_SIZE)
+      tokenizer = Html_tokenizer_new(this);
+
+   Html_preload_scan(this);
+
+   /* A queued slice will get to the new data */
+   dReturn_if (slice_pending == true);
+
+   parseSlice();
+}
+
+/**
+ * Parse the data given to write() for at most prefs.parse_time_slice
+ * milliseconds. If there's more left by then, queue another slice, so that
+ * input events and redraws are handled in between.
+ */
+void DilloHtml::parseSlice()
+{
+   char *Buf;
+   int BufSize;
+   bool timed = prefs.parse_time_slice > 0;
+
+   while (true) {
+      slice_end = timed ? Html_now() + prefs.parse_time_slice / 1000.0 : 0.0;
+      slice_yield = false;
+
+      if (tokenizer) {
+         Html_tokenizer_feed(tokenizer, Start_Buf, Buf_Size, Buf_Eof);
+         Start_Ofs += Html_write_tokens(this, Start_Buf + Start_Ofs, Buf_Eof);
+         if (Buf_Eof && !slice_yield) {
+            Html_tokenizer_free(tokenizer);
+            tokenizer = NULL;
+         }
+      } else {
+         Start_Ofs += Html_write_raw(this, Start_Buf + Start_Ofs,
+                                     Buf_Size - Start_Ofs, Buf_Eof);
+      }
+      slice_end = 0.0;
+
+      if (!slice_yield || stop_parser)
+         break;
+      /* Keep a reference, the cache may drop its buffer after EOF */
+      if (a_Capi_get_buf(page_url, &Buf, &BufSize)) {
+         slice_pending = true;
+         Html_slice_queue_add(this, 0.0);
+         break;
+      }
+      /* Not in the cache: nothing to come back to, so parse it all now */
+      timed = false;
+   }
+   /* The cache may move or free the buffer before the next slice */
+   if (tokenizer)
+      Html_tokenizer_pause(tokenizer);
+}
+
+/**
+ * Run the slice queued by parseSlice().
+ */
+void DilloHtml::resumeParsing()
+{
+   char *Buf;
+   int BufSize, found;
+
+   slice_pending = false;
+
+   /* The buffer may have moved since the last write() */
+   found = a_Capi_get_buf(page_url, &Buf, &BufSize);
+   if (found && !stop_parser && BufSize >= Buf_Size) {
+      Start_Buf = Buf;
+      Buf_Size = BufSize;
+      Html_preload_scan(this);
+      parseSlice();
+   }
+   if (found)
+      a_Capi_unref_buf(page_url);
+   /* drop the reference taken when this slice was queued */
+   a_Capi_unref_buf(page_url);
+
+   if (!slice_pending && finish_key) {
+      int ClientKey = finish_key;
+
+      finish_key = 0;
+      finishParsing(ClientKey);
+   }
 }
 
 /**
@@ -626,10 +837,18 @@ int DilloHtml::getCurrLineNumber()
  */
 void DilloHtml::freeParseData()
 {
+   if (tokenizer)
+      Html_tokenizer_free(tokenizer);
    delete(stack);
 
    dStr_free(Stash, TRUE);
+   dStr_free(textRunBuf, TRUE);
+   delete(textRun);
+   if (textRunStyle)
+      textRunStyle->unref ();
+   dStr_free(word_data, TRUE);
    dStr_free(attr_data, TRUE);
+   delete(attrs);
    dFree(content_type);
    dFree(charset);
 }
@@ -644,6 +863,12 @@ void DilloHtml::finishParsing(int ClientKey)
 
    dReturn_if (stop_parser == true);
 
+   if (slice_pending) {
+      /* not yet: resumeParsing() will call back */
+      finish_key = ClientKey;
+      return;
+   }
+
    /* flag we've already parsed up to the last byte */
    InFlags |= IN_EOF;
 
@@ -826,10 +1051,11 @@ bool DilloHtml::HtmlLinkReceiver::click (Widget *widget, int link, int img,
       }
 
       /* Change the link color to "visited" as visual feedback */
-      for (Widget *w = widget; w; w = w->getParent()) {
+      int32_t color = Html_visited_link_color(html, link);
+      for (Widget *w = widget; w && color != -1; w = w->getParent()) {
          _MSG("  ->%s\n", w->getClassName());
          if (w->instanceOf(dw::Textblock::CLASS_ID)) {
-            ((Textblock*)w)->changeLinkColor (link, html->visited_color);
+            ((Textblock*)w)->changeLinkColor (link, color);
             break;
          }
       }
@@ -953,73 +1179,127 @@ static const char *Html_parse_numeric_charref(DilloHtml *html, char *tok,
 }
 
 /**
- * Comparison function for binary search
+ * Return the child of 'node' for the character 'c', if any.
  */
-static int Html_charref_comp(const void *a, const void *b)
+static const Html_charref_node *Html_charref_child(
+   const Html_charref_node *node, char c)
 {
-   return strcmp(((Charref_t *)a)->ref, ((Charref_t *)b)->ref);
+   const Html_charref_node *child = Html_charref_trie + node->child,
+                           *last = child + node->nchild;
+
+   while (last - child > 8) {
+      /* wide nodes (i.e. the root) */
+      const Html_charref_node *mid = child + (last - child) / 2;
+      if (mid->c < c)
+         child = mid + 1;
+      else
+         last = mid + 1;
+   }
+   while (child < last && child->c < c)
+      ++child;
+   return (child < last && child->c == c) ? child : NULL;
 }
 
 /**
- * Binary search of 'key' in charref list
+ * Find the charref named by the 'len' bytes at 'name'.
  */
-static Charref_t *Html_charref_search(char *key)
+static const Charref_t *Html_charref_lookup(const char *name, int len)
 {
-   Charref_t RefKey;
+   const Html_charref_node *node = Html_charref_trie;
+   int i;
 
-   RefKey.ref = key;
-   return (Charref_t*) bsearch(&RefKey, Charrefs, NumRef,
-                       sizeof(Charref_t), Html_charref_comp);
+   for (i = 0; i < len && node; ++i)
+      node = Html_charref_child(node, name[i]);
+   return (node && node->ref >= 0) ? &Charrefs[node->ref] : NULL;
+}
+
+/**
+ * Parse a named character reference as HTML5 does: the longest name that
+ * is followed by a ';' wins, but the legacy names (those of HTML4 for
+ * Latin-1 characters) also match without one, as in "&notit;" ("¬it;").
+ * The "&" has already been consumed; 'tok' holds 'toksize' bytes.
+ */
+static const char *Html_parse_named_charref5(DilloHtml *html,
+                                             const char *tok, int toksize,
+                                             bool_t is_attr, int *entsize)
+{
+   const Html_charref_node *node = Html_charref_trie, *match = NULL;
+   int i, len = 0;
+
+   for (i = 0; i < toksize; ++i) {
+      if (!(node = Html_charref_child(node, tok[i])))
+         break;
+      if (node->ref >= 0 && i + 1 < toksize && tok[i + 1] == ';') {
+         match = node;
+         len = i + 2;
+         break;
+      }
+      if (node->legacy) {
+         match = node;
+         len = i + 1;
+      }
+   }
+
+   if (!match) {
+      for (i = 0; i < toksize && isalnum(tok[i]); ++i) ;
+      if (i < toksize && tok[i] == ';')
+         BUG_MSG("Undefined character reference '&%.*s'.", i + 1, tok);
+      return NULL;
+   }
+   /* "&copy=1" in a URL is left alone */
+   if (is_attr && tok[len - 1] != ';' && len < toksize &&
+       (tok[len] == '=' || isalnum(tok[len])))
+      return NULL;
+
+   *entsize = len + 1;
+   return Charrefs[match->ref].html5_str;
 }
 
 /**
  * Parse a named character reference (e.g., "&amp;" or "&hellip;").
- * The "&" has already been consumed.
+ * The "&" has already been consumed; 'tok' holds 'toksize' bytes.
  */
-static const char *Html_parse_named_charref(DilloHtml *html, char *tok,
-                                            bool_t is_attr, int *entsize)
+static const char *Html_parse_named_charref(DilloHtml *html, const char *tok,
+                                            int toksize, bool_t is_attr,
+                                            int *entsize)
 {
-   Charref_t *p;
+   const Charref_t *p;
    char c;
-   char *s = tok;
+   int len;
+   const char *s = tok, *end = tok + toksize;
    const char *ret = NULL;
 
-   while (*++s && (isalnum(*s) || strchr(":_.-", *s))) ;
-   c = *s;
-   *s = '\0';
+   if (html->DocType == DT_HTML && html->DocTypeVersion >= 5.0f)
+      return Html_parse_named_charref5(html, tok, toksize, is_attr, entsize);
+
+   while (++s < end && *s && (isalnum(*s) || strchr(":_.-", *s))) ;
+   c = (s < end) ? *s : '\0';
+   len = s - tok;
    if (c != ';') {
       if (prefs.show_extra_warnings && (html->DocType == DT_XHTML ||
           (html->DocType == DT_HTML && html->DocTypeVersion <= 4.01f)))
-         BUG_MSG("Character reference '&%s' lacks ';'.", tok);
+         BUG_MSG("Character reference '&%.*s' lacks ';'.", len, tok);
 
       /* Don't require ';' for old HTML, except that our current heuristic
        * is to require it in attributes to avoid cases like "&copy=1" found
        * in URLs.
        */
-      if (is_attr || html->DocType == DT_XHTML ||
-          (html->DocType == DT_HTML && html->DocTypeVersion >= 5.0f)) {
+      if (is_attr || html->DocType == DT_XHTML)
          return ret;
-      }
    }
 
-   if ((p = Html_charref_search(tok))) {
-      ret = (html->DocType == DT_HTML && html->DocTypeVersion >= 5.0f) ?
-            p->html5_str : p->html4_str;
-   }
+   if ((p = Html_charref_lookup(tok, len)))
+      ret = p->html4_str;
 
-   if (!ret && html->DocType == DT_XHTML && !strcmp(tok, "apos"))
+   if (!ret && html->DocType == DT_XHTML && len == 4 &&
+       !strncmp(tok, "apos", 4))
       ret = "'";
 
-   *s = c;
    if (c == ';')
       s++;
 
-   if (!ret) {
-      c = *s;
-      *s = '\0';
-      BUG_MSG("Undefined character reference '&%s'.", tok);
-      *s = c;
-   }
+   if (!ret)
+      BUG_MSG("Undefined character reference '&%.*s'.", (int)(s - tok), tok);
    *entsize = s-tok+1;
    return ret;
 }
@@ -1047,58 +1327,109 @@ static const char *Html_parse_entity(DilloHtml *html, const char *token,
    }
 
    token++;
-   tok = dStrndup(token, (uint_t)toksize);
+   toksize--;
 
-   if (*tok == '#') {
+   if (toksize > 0 && *token == '#') {
+      tok = dStrndup(token, (uint_t)toksize);
       ret = Html_parse_numeric_charref(html, tok+1, is_attr, entsize);
-   } else if (isalpha(*tok)) {
-      ret = Html_parse_named_charref(html, tok, is_attr, entsize);
+      dFree(tok);
+   } else if (toksize > 0 && isalpha(*token)) {
+      ret = Html_parse_named_charref(html, token, toksize, is_attr, entsize);
    } else if (prefs.show_extra_warnings &&
        (!(html->DocType == DT_HTML && html->DocTypeVersion >= 5.0f))) {
       // HTML5 doesn't mind literal '&'s.
       BUG_MSG("Literal '&'.");
    }
-   dFree(tok);
 
    return ret;
 }
 
+/**
+ * Parse all the entities in a token, appending the result to 'ds'.
+ * Text between entities is copied in runs; with no '&' at all, this is a
+ * single append.
+ */
+static void Html_append_entities(DilloHtml *html, Dstr *ds,
+                                 const char *token, int toksize)
+{
+   const char *p, *entstr, *end = token + toksize;
+   const bool_t is_attr = FALSE;
+   int entsize;
+
+   while ((p = (const char*) memchr(token, '&', end - token))) {
+      dStr_append_l(ds, token, p - token);
+      if ((entstr = Html_parse_entity(html, p, end - p, &entsize, is_attr))) {
+         dStr_append(ds, entstr);
+         token = p + entsize;
+      } else {
+         dStr_append_c(ds, '&');
+         token = p + 1;
+      }
+   }
+   dStr_append_l(ds, token, end - token);
+}
+
 /**
  * Parse all the entities in a token. Takes the token and its length, and
- * returns a newly allocated string.
+ * returns a newly allocated string, or NULL when there are no entities to
+ * parse (no '&'), so that the caller can use the token as it is.
  */
 char *a_Html_parse_entities(DilloHtml *html, const char *token, int toksize)
 {
-   const char *esc_set = "&";
-   int i, s, entsize;
+   Dstr *ds;
    char *str;
 
-   s = strcspn(token, esc_set);
-   if (s >= toksize) {
-      /* no ampersands */
-      str = dStrndup(token, toksize);
-   } else {
-      Dstr *ds = dStr_sized_new(toksize);
+   if (!memchr(token, '&', toksize))
+      return NULL;
 
-      dStr_append_l(ds, token, s);
+   ds = dStr_sized_new(toksize);
+   Html_append_entities(html, ds, token, toksize);
+   str = ds->str;
+   dStr_free(ds, 0);
+   return str;
+}
 
-      for (i = s; i < toksize; i++) {
-         const char *entstr;
-         const bool_t is_attr = FALSE;
+/**
+ * Add the pending run of text to the textblock.
+ */
+static void Html_text_run_flush(DilloHtml *html)
+{
+   if (html->textRun->size() > 0) {
+      HT2TB(html)->addTextRun(html->textRunBuf->str, html->textRun->getRef(0),
+                              html->textRun->size(), html->textRunStyle);
+      html->textRun->setSize(0);
+      dStr_truncate(html->textRunBuf, 0);
+   }
+   if (html->textRunStyle) {
+      html->textRunStyle->unref ();
+      html->textRunStyle = NULL;
+   }
+}
 
-         if (token[i] == '&' &&
-             (entstr = Html_parse_entity(html, token+i, toksize-i, &entsize,
-                                         is_attr))) {
-            dStr_append(ds, entstr);
-            i += entsize-1;
-         } else {
-            dStr_append_c(ds, token[i]);
-         }
-      }
-      str = ds->str;
-      dStr_free(ds, 0);
+/**
+ * Queue text, a space or a break option for the textblock.
+ * Consecutive ones in the same style are added together, when a tag or a
+ * change of style comes, or at the end of the data.
+ */
+static void Html_text_run_add(DilloHtml *html,
+                              Textblock::TextRunItem::Type type,
+                              const char *text, int len)
+{
+   Style *style = html->wordStyle ();
+   Textblock::TextRunItem *item;
+
+   if (style != html->textRunStyle) {
+      Html_text_run_flush(html);
+      html->textRunStyle = style;
+      style->ref ();
    }
-   return str;
+   html->textRun->increase();
+   item = html->textRun->getLastRef();
+   item->type = type;
+   item->start = html->textRunBuf->len;
+   item->len = len;
+   if (type == Textblock::TextRunItem::TEXT)
+      dStr_append_l(html->textRunBuf, text, len);
 }
 
 /**
@@ -1110,6 +1441,7 @@ static void Html_process_space_pre_line(DilloHtml *html, const char *space,
 {
    int i, breakCnt = 0;
 
+   Html_text_run_flush(html);
    for (i = 0; i < spacesize; i++) {
       /* Support for "\r", "\n" and "\r\n" line breaks */
       if (space[i] == '\r' || (space[i] == '\n' && !html->PrevWasCR)) {
@@ -1145,6 +1477,7 @@ static void Html_process_space(DilloHtml *html, const char *space,
    } else if (parse_mode == DILLO_HTML_PARSE_MODE_PRE) {
       int spaceCnt = 0;
 
+      Html_text_run_flush(html);
       /* re-scan the string for characters that cause line breaks */
       for (i = 0; i < spacesize; i++) {
          /* Support for "\r", "\n" and "\r\n" line breaks (skips the first) */
@@ -1197,7 +1530,7 @@ static void Html_process_space(DilloHtml *html, const char *space,
       } else if (html->wordStyle ()->whiteSpace == WHITE_SPACE_PRE_LINE) {
          Html_process_space_pre_line(html, space, spacesize);
       } else {
-         HT2TB(html)->addSpace(html->wordStyle ());
+         Html_text_run_add(html, Textblock::TextRunItem::SPACE, NULL, 0);
       }
 
       if (parse_mode == DILLO_HTML_PARSE_MODE_STASH_AND_BODY)
@@ -1232,9 +1565,7 @@ static void Html_process_word(DilloHtml *html, const char *word, int size)
          dStr_append_c(html->Stash, ' ');
          html->StashSpace = false;
       }
-      Pword = a_Html_parse_entities(html, word, size);
-      dStr_append(html->Stash, Pword);
-      dFree(Pword);
+      Html_append_entities(html, html->Stash, word, size);
 
    } else if (parse_mode == DILLO_HTML_PARSE_MODE_VERBATIM) {
       /* word goes in untouched, it is not processed here. */
@@ -1247,7 +1578,10 @@ static void Html_process_word(DilloHtml *html, const char *word, int size)
 
    } else if (parse_mode == DILLO_HTML_PARSE_MODE_PRE) {
       /* all this overhead is to catch white-space entities */
-      Pword = a_Html_parse_entities(html, word, size);
+      Html_text_run_flush(html);
+      dStr_truncate(html->word_data, 0);
+      Html_append_entities(html, html->word_data, word, size);
+      Pword = html->word_data->str;
       for (start = i = 0; Pword[i]; start = i)
          if (isspace(Pword[i])) {
             while (Pword[++i] && isspace(Pword[i])) ;
@@ -1258,19 +1592,19 @@ static void Html_process_word(DilloHtml *html, const char *word, int size)
             html->pre_column += i - start;
             html->PreFirstChar = false;
          }
-      dFree(Pword);
 
    } else {
       const char *word2, *beyond_word2;
 
-      Pword = NULL;
       if (!memchr(word,'&', size)) {
          /* No entities */
          word2 = word;
          beyond_word2 = word + size;
       } else {
          /* Collapse white-space entities inside the word (except &nbsp;) */
-         Pword = a_Html_parse_entities(html, word, size);
+         dStr_truncate(html->word_data, 0);
+         Html_append_entities(html, html->word_data, word, size);
+         Pword = html->word_data->str;
          /* Collapse adjacent " \t\f\n\r" characters into a single space */
          for (i = j = 0; (Pword[i] = Pword[j]); ++i, ++j) {
             if (strchr(" \t\f\n\r", Pword[i])) {
@@ -1292,22 +1626,24 @@ static void Html_process_word(DilloHtml *html, const char *word, int size)
             Html_process_space(html, word2 + start, i - start);
          } else if (!strncmp(word2+i, utf8_zero_width_space, 3)) {
             i += 3;
-            HT2TB(html)->addBreakOption(html->wordStyle (), false);
+            Html_text_run_add(html, Textblock::TextRunItem::BREAK_OPTION,
+                              NULL, 0);
          } else if (a_Utf8_ideographic(word2+i, beyond_word2, &len)) {
             i += len;
-            HT2TB(html)->addText(word2 + start, i - start, html->wordStyle ());
-            HT2TB(html)->addBreakOption(html->wordStyle (), false);
+            Html_text_run_add(html, Textblock::TextRunItem::TEXT,
+                              word2 + start, i - start);
+            Html_text_run_add(html, Textblock::TextRunItem::BREAK_OPTION,
+                              NULL, 0);
          } else {
             do {
                i += len;
             } while (word2[i] && !isspace(word2[i]) &&
                      strncmp(word2+i, utf8_zero_width_space, 3) &&
                      (!a_Utf8_ideographic(word2+i, beyond_word2, &len)));
-            HT2TB(html)->addText(word2 + start, i - start, html->wordStyle ());
+            Html_text_run_add(html, Textblock::TextRunItem::TEXT,
+                              word2 + start, i - start);
          }
       }
-      if (Pword == word2)
-         dFree(Pword);
    }
 }
 
@@ -1315,7 +1651,7 @@ static void Html_process_word(DilloHtml *html, const char *word, int size)
  * Does the tag in tagstr (e.g. "p") match the tag in the tag, tagsize
  * structure, with the initial < skipped over (e.g. "P align=center>")?
  */
-static bool Html_match_tag(const char *tagstr, char *tag, int tagsize)
+static bool Html_match_tag(const char *tagstr, const char *tag, int tagsize)
 {
    int i;
 
@@ -3093,14 +3429,21 @@ static int Html_tag_pre_excludes(DilloHtml *html, int tag_idx)
  */
 static void Html_update_content_type(DilloHtml *html, const char *content)
 {
-   const char *new_content = a_Capi_set_content_type(html->page_url, content,
-                                                     "meta");
+   const char *new_content;
+
+   /* The cache may drop the buffer that the tokenizer reads */
+   if (html->tokenizer)
+      Html_tokenizer_pause(html->tokenizer);
+   new_content = a_Capi_set_content_type(html->page_url, content, "meta");
    /* Cannot ask cache whether the content type was changed, as
     * this code in another bw might have already changed it for us.
     */
    if (a_Misc_content_type_cmp(html->content_type, new_content)) {
       html->stop_parser = true; /* The cache buffer is no longer valid */
       a_UIcmd_repush(html->bw);
+   } else if (html->tokenizer) {
+      Html_tokenizer_feed(html->tokenizer, html->Start_Buf, html->Buf_Size,
+                          html->Buf_Eof);
    }
 }
 
@@ -3202,9 +3545,12 @@ static void Html_tag_open_meta(DilloHtml *html, const char *tag, int tagsize)
             {
                int o_InFlags = html->InFlags;
                int o_TagSoup = html->TagSoup;
+               double o_slice_end = html->slice_end;
                html->InFlags = IN_BODY + IN_META_HACK;
                html->TagSoup = false;
+               html->slice_end = 0.0;     /* parse it all */
                Html_write_raw(html, ds_msg->str, ds_msg->len, 0);
+               html->slice_end = o_slice_end;
                html->TagSoup = o_TagSoup;
                html->InFlags = o_InFlags;
             }
@@ -3227,6 +3573,45 @@ static void Html_tag_open_meta(DilloHtml *html, const char *tag, int tagsize)
    }
 }
 
+static void Html_css_load_callback(int Op, CacheClient_t *Client);
+
+/**
+ * Ask the cache for a stylesheet; the page is repushed once all of the
+ * requested ones have arrived.
+ */
+static void Html_css_request(BrowserWindow *bw, const DilloUrl *url,
+                             const DilloUrl *requester)
+{
+   int ClientKey;
+   DilloWeb *Web = a_Web_new(bw, url, requester);
+   Web->flags |= WEB_Stylesheet;
+   if ((ClientKey = a_Capi_open_url(Web, Html_css_load_callback, NULL))) {
+      ++bw->NumPendingStyleSheets;
+      a_Bw_add_client(bw, ClientKey, 0);
+      a_Bw_add_url(bw, url);
+      MSG("NumPendingStyleSheets=%d\n", bw->NumPendingStyleSheets);
+   }
+}
+
+/**
+ * Request the stylesheets that a newly arrived one imports, so that a
+ * chain of @import rules is fetched before the repush, and not one
+ * repush per level. They are added to the CssContext when the page is
+ * parsed again, in the usual order.
+ */
+static void Html_css_request_imports(DilloWeb *web, const char *buf, int len)
+{
+   CssRuleSet ruleSet;
+
+   CssParser::scanImports(web->url, &ruleSet, buf, len);
+   for (int i = 0; i < ruleSet.numImports(); i++) {
+      DilloUrl *url = ruleSet.getImport(i);
+
+      if (!(a_Capi_get_flags_with_redirection(url) & CAPI_Completed))
+         Html_css_request(web->bw, url, web->requester);
+   }
+}
+
 /**
  * Called by the network engine when a stylesheet has new data.
  */
@@ -3234,7 +3619,12 @@ static void Html_css_load_callback(int Op, CacheClient_t *Client)
 {
    _MSG("Html_css_load_callback: Op=%d\n", Op);
    if (Op) { /* EOF */
-      BrowserWindow *bw = ((DilloWeb *)Client->Web)->bw;
+      DilloWeb *Web = (DilloWeb *)Client->Web;
+      BrowserWindow *bw = Web->bw;
+
+      if (Op == CA_Close && prefs.load_stylesheets && Client->Buf)
+         Html_css_request_imports(Web, (const char *)Client->Buf,
+                                  Client->BufSize);
       /* Repush when we've got them all */
       if (--bw->NumPendingStyleSheets == 0)
          a_UIcmd_repush(bw);
@@ -3253,7 +3643,10 @@ void a_Html_load_stylesheet(DilloHtml *html, DilloUrl *url)
 
    _MSG("Html_load_stylesheet: ");
    if ((a_Capi_get_flags_with_redirection(url) & CAPI_Completed) &&
-       a_Capi_get_buf(url, &data, &len)) {
+       html->styleEngine->addCachedStyleSheet(html, url)) {
+      _MSG("parsed before URL=%s", URL_STR(url));
+   } else if ((a_Capi_get_flags_with_redirection(url) & CAPI_Completed) &&
+              a_Capi_get_buf(url, &data, &len)) {
       _MSG("cached URL=%s len=%d", URL_STR(url), len);
       if (strncmp("@charset \"", data, 10) == 0) {
          char *endq = strchr(data+10, '"');
@@ -3271,19 +3664,10 @@ void a_Html_load_stylesheet(DilloHtml *html, DilloUrl *url)
             a_Capi_get_buf(url, &data, &len);
          }
       }
-      html->styleEngine->parse(html, url, data, len, CSS_ORIGIN_AUTHOR);
+      html->styleEngine->parseStyleSheet(html, url, data, len);
       a_Capi_unref_buf(url);
    } else {
-      /* Fill a Web structure for the cache query */
-      int ClientKey;
-      DilloWeb *Web = a_Web_new(html->bw, url, html->page_url);
-      Web->flags |= WEB_Stylesheet;
-      if ((ClientKey = a_Capi_open_url(Web, Html_css_load_callback, NULL))) {
-         ++html->bw->NumPendingStyleSheets;
-         a_Bw_add_client(html->bw, ClientKey, 0);
-         a_Bw_add_url(html->bw, url);
-         MSG("NumPendingStyleSheets=%d\n", html->bw->NumPendingStyleSheets);
-      }
+      Html_css_request(html->bw, url, html->page_url);
    }
    _MSG("\n");
 }
@@ -3603,13 +3987,108 @@ static int Html_tag_compare(const char *p1, const char *p2)
    return !strchr(" >/\n\r\t", *p1);
 }
 
+/**
+ * Case-insensitive FNV-1a hash of a tag or attribute name.
+ */
+static uint32_t Html_name_hash(const char *name, int len)
+{
+   uint32_t h = 2166136261U;
+   int i;
+
+   for (i = 0; i < len; ++i)
+      h = (h ^ (uchar_t)D_ASCII_TOLOWER(name[i])) * 16777619U;
+   return h;
+}
+
+/*
+ * Perfect hash over the names in Tags[] (hash and displace): a name's hash
+ * picks a bucket, and the bucket's displacement is chosen so that all its
+ * names land on free slots. It's built by a_Html_init() from Tags[] itself,
+ * so it can't go out of sync; until then, or should that ever fail, the
+ * binary search is used.
+ */
+#define HTML_TAG_HASH_BUCKETS 32
+#define HTML_TAG_HASH_SIZE 128   /* a power of two */
+
+static struct {
+   int state;                            /* 0: unset, 1: ok, -1: failed */
+   ushort_t disp[HTML_TAG_HASH_BUCKETS];
+   signed char slot[HTML_TAG_HASH_SIZE]; /* Tags[] index or -1 */
+} Html_tag_hash;
+
+static inline int Html_tag_hash_slot(uint32_t h, uint_t disp)
+{
+   h ^= disp * 0x9e3779b9U;
+   h = (h ^ (h >> 16)) * 0x85ebca6bU;
+   return (int)((h ^ (h >> 13)) & (HTML_TAG_HASH_SIZE - 1));
+}
+
+static void Html_tag_hash_init(void)
+{
+   uint32_t hashes[NTAGS];
+   int order[HTML_TAG_HASH_BUCKETS], count[HTML_TAG_HASH_BUCKETS] = {0};
+   int slots[NTAGS], b, i, j, k, n, tmp;
+   uint_t d;
+
+   Html_tag_hash.state = -1;
+   memset(Html_tag_hash.slot, -1, sizeof(Html_tag_hash.slot));
+   for (i = 0; i < (int)NTAGS; ++i) {
+      hashes[i] = Html_name_hash(Tags[i].name, strlen(Tags[i].name));
+      count[hashes[i] % HTML_TAG_HASH_BUCKETS]++;
+   }
+   /* place the fullest buckets first */
+   for (b = 0; b < HTML_TAG_HASH_BUCKETS; ++b) {
+      for (j = b; j > 0 && count[order[j - 1]] < count[b]; --j)
+         order[j] = order[j - 1];
+      order[j] = b;
+   }
+   for (k = 0; k < HTML_TAG_HASH_BUCKETS && count[order[k]]; ++k) {
+      b = order[k];
+      for (d = 0; d < 0xffff; ++d) {
+         for (n = 0, i = 0; i < (int)NTAGS; ++i) {
+            if (hashes[i] % HTML_TAG_HASH_BUCKETS != (uint_t)b)
+               continue;
+            tmp = Html_tag_hash_slot(hashes[i], d);
+            for (j = 0; j < n && slots[j] != tmp; ++j) ;
+            if (Html_tag_hash.slot[tmp] != -1 || j < n)
+               break;
+            slots[n++] = tmp;
+         }
+         if (i == (int)NTAGS)
+            break;
+      }
+      if (d == 0xffff) {
+         MSG_ERR("Html_tag_hash_init: can't place tags, using bsearch\n");
+         return;
+      }
+      Html_tag_hash.disp[b] = d;
+      for (n = 0, i = 0; i < (int)NTAGS; ++i)
+         if (hashes[i] % HTML_TAG_HASH_BUCKETS == (uint_t)b)
+            Html_tag_hash.slot[slots[n++]] = i;
+   }
+   Html_tag_hash.state = 1;
+}
+
 /**
  * Get 'tag' index.
  * return -1 if tag is not handled yet
  */
 int a_Html_tag_index(const char *tag)
 {
-   int low, high, mid, cond;
+   int low, high, mid, cond, len, idx;
+
+   if (Html_tag_hash.state == 1) {
+      /* the name ends like in Html_tag_compare() */
+      uint32_t h = 2166136261U;
+      for (len = 0; tag[len] && tag[len] != ' ' && tag[len] != '>' &&
+                    tag[len] != '/' && tag[len] != '\n' &&
+                    tag[len] != '\r' && tag[len] != '\t'; ++len)
+         h = (h ^ (uchar_t)D_ASCII_TOLOWER(tag[len])) * 16777619U;
+      idx = Html_tag_hash.slot[Html_tag_hash_slot(h,
+                 Html_tag_hash.disp[h % HTML_TAG_HASH_BUCKETS])];
+      return (idx >= 0 && Html_tag_compare(tag, Tags[idx].name) == 0) ?
+             idx : -1;
+   }
 
    /* Binary search */
    low = 0;
@@ -3626,6 +4105,14 @@ int a_Html_tag_index(const char *tag)
    return -1;
 }
 
+/**
+ * Get the name of the tag with index 'idx', or NULL.
+ */
+const char *a_Html_tag_name(int idx)
+{
+   return (idx >= 0 && idx < NTAGS) ? Tags[idx].name : NULL;
+}
+
 /**
  * For elements with optional close, check whether is time to close,
  * by also following Firefox's de facto rules.
@@ -4029,6 +4516,7 @@ static void Html_process_tag(DilloHtml *html, char *tag, int tagsize)
 
    dReturn_if (html->stop_parser == true);
 
+   Html_text_run_flush(html);
    ni = a_Html_tag_index(start + IsCloseTag);
    if (ni == -1) {
       /* TODO: doctype parsing is a bit fuzzy, but enough for the time being */
@@ -4074,6 +4562,9 @@ static void Html_process_tag(DilloHtml *html, char *tag, int tagsize)
       html->startElement (ni);
       _MSG("Open : %*s%s\n", html->stack->size(), " ", Tags[ni].name);
 
+      /* Split the attributes once for all the lookups below */
+      Html_split_attrs(html, tag, tagsize);
+
       /* Parse attributes that can appear on any tag */
       Html_parse_common_attrs(html, tag, tagsize);
 
@@ -4149,6 +4640,71 @@ static void Html_process_tag(DilloHtml *html, char *tag, int tagsize)
          html->ReqTagClose = false;
       }
    }
+   /* The tag's buffer may be reused, don't keep its attributes around */
+   html->attr_tag = NULL;
+}
+
+/**
+ * Split the attributes of 'tag' into html->attrs, so that looking them up
+ * doesn't need to scan the whole tag again.
+ *  Tags start with '<' and end with a '>' (Ex: "<P align=center>")
+ *  tagsize = strlen(tag) from '<' to '>', inclusive.
+ */
+static void Html_split_attrs(DilloHtml *html, const char *tag, int tagsize)
+{
+   DilloHtmlAttr *attr;
+   int i = 1, end = tagsize - 1, delimiter;
+
+   html->attrs->setSize(0);
+   html->attr_tag = tag;
+   html->attr_tagsize = tagsize;
+
+   /* skip the element name */
+   while (i < end && !isspace(tag[i]) && tag[i] != '=')
+      ++i;
+
+   while (i < end) {
+      if (isspace(tag[i])) {
+         ++i;
+         continue;
+      }
+      attr = NULL;
+      if (tag[i] != '=') {
+         html->attrs->increase();
+         attr = html->attrs->getLastRef();
+         attr->name = i;
+         while (i < end && !isspace(tag[i]) && tag[i] != '=')
+            ++i;
+         attr->nameLen = i - attr->name;
+         attr->nameHash = Html_name_hash(tag + attr->name, attr->nameLen);
+         attr->value = -1;
+         attr->valueLen = 0;
+         while (i < end && isspace(tag[i]))
+            ++i;
+         if (i == end || tag[i] != '=')
+            continue;
+      }
+      /* tag[i] is '=': get the value (a nameless one is dropped) */
+      for (++i; i < end && isspace(tag[i]); ++i) ;
+      if (i < end && (tag[i] == '"' || tag[i] == '\'')) {
+         delimiter = tag[i++];
+         if (attr)
+            attr->value = i;
+         /* an unterminated quote takes up to the end of the tag */
+         while (i < tagsize && tag[i] != delimiter)
+            ++i;
+         if (attr)
+            attr->valueLen = i - attr->value;
+         ++i;
+      } else {
+         if (attr)
+            attr->value = i;
+         while (i < end && !isspace(tag[i]))
+            ++i;
+         if (attr)
+            attr->valueLen = i - attr->value;
+      }
+   }
 }
 
 /**
@@ -4167,87 +4723,52 @@ static const char *Html_get_attr2(DilloHtml *html,
                                   const char *attrname,
                                   int tag_parsing_flags)
 {
-   int i, entsize, Found = 0, delimiter = 0, attr_pos = 0;
+   int i, j, n, entsize;
+   uint32_t h;
    Dstr *Buf = html->attr_data;
-   DilloHtmlTagParsingState state = SEEK_ATTR_START;
+   DilloHtmlAttr *attr = NULL;
+   const char *val;
 
    dReturn_val_if_fail(*attrname, NULL);
 
-   dStr_truncate(Buf, 0);
-
-   for (i = 1; i < tagsize; ++i) {
-      switch (state) {
-      case SEEK_ATTR_START:
-         if (isspace(tag[i]))
-            state = SEEK_TOKEN_START;
-         else if (tag[i] == '=')
-            state = SEEK_VALUE_START;
-         break;
-
-      case MATCH_ATTR_NAME:
-         if (!attrname[attr_pos] &&
-             (tag[i] == '=' || isspace(tag[i]) || tag[i] == '>')) {
-            Found = 1;
-            state = SEEK_TOKEN_START;
-            --i;
-         } else if (!tag[i]) {
-            state = SEEK_ATTR_START; // NULL byte is not allowed
-         } else {
-            if (D_ASCII_TOLOWER(tag[i]) != D_ASCII_TOLOWER(attrname[attr_pos]))
-               state = SEEK_ATTR_START;
-            attr_pos++;
-         }
-         break;
+   if (tag != html->attr_tag || tagsize != html->attr_tagsize)
+      Html_split_attrs(html, tag, tagsize);
+
+   n = strlen(attrname);
+   h = Html_name_hash(attrname, n);
+   for (i = 0; i < html->attrs->size(); ++i) {
+      attr = html->attrs->getRef(i);
+      if (attr->nameHash == h && attr->nameLen == n) {
+         for (j = 0; j < n && (D_ASCII_TOLOWER(tag[attr->name + j]) ==
+                               D_ASCII_TOLOWER(attrname[j])); ++j) ;
+         if (j == n)
+            break;
+      }
+   }
+   if (i == html->attrs->size())
+      return NULL;
 
-      case SEEK_TOKEN_START:
-         if (tag[i] == '=') {
-            state = SEEK_VALUE_START;
-         } else if (!isspace(tag[i])) {
-            attr_pos = 0;
-            state = (Found) ? FINISHED : MATCH_ATTR_NAME;
-            --i;
-         }
-         break;
-      case SEEK_VALUE_START:
-         if (!isspace(tag[i])) {
-            delimiter = (tag[i] == '"' || tag[i] == '\'') ? tag[i] : ' ';
-            i -= (delimiter == ' ');
-            state = (Found) ? GET_VALUE : SKIP_VALUE;
-         }
-         break;
+   dStr_truncate(Buf, 0);
+   val = (attr->value >= 0) ? tag + attr->value : "";
+   for (i = 0; i < attr->valueLen; ++i) {
+      if (val[i] == '&' && (tag_parsing_flags & HTML_ParseEntities)) {
+         const char *entstr;
+         const bool_t is_attr = TRUE;
 
-      case SKIP_VALUE:
-         if ((delimiter == ' ' && isspace(tag[i])) || tag[i] == delimiter)
-            state = SEEK_TOKEN_START;
-         break;
-      case GET_VALUE:
-         if ((delimiter == ' ' && (isspace(tag[i]) || tag[i] == '>')) ||
-             tag[i] == delimiter) {
-            state = FINISHED;
-         } else if (tag[i] == '&' &&
-                    (tag_parsing_flags & HTML_ParseEntities)) {
-            const char *entstr;
-            const bool_t is_attr = TRUE;
-
-            if ((entstr = Html_parse_entity(html, tag+i, tagsize-i, &entsize,
-                                            is_attr))) {
-               dStr_append(Buf, entstr);
-               i += entsize-1;
-            } else {
-               dStr_append_c(Buf, tag[i]);
-            }
-         } else if (tag[i] == '\r' || tag[i] == '\t') {
-            dStr_append_c(Buf, ' ');
-         } else if (tag[i] == '\n') {
-            /* ignore */
+         if ((entstr = Html_parse_entity(html, val + i, tagsize -
+                                         (attr->value + i), &entsize,
+                                         is_attr))) {
+            dStr_append(Buf, entstr);
+            i += entsize-1;
          } else {
-            dStr_append_c(Buf, tag[i]);
+            dStr_append_c(Buf, val[i]);
          }
-         break;
-
-      case FINISHED:
-         i = tagsize;
-         break;
+      } else if (val[i] == '\r' || val[i] == '\t') {
+         dStr_append_c(Buf, ' ');
+      } else if (val[i] == '\n') {
+         /* ignore */
+      } else {
+         dStr_append_c(Buf, val[i]);
       }
    }
 
@@ -4258,7 +4779,7 @@ static const char *Html_get_attr2(DilloHtml *html,
       while (Buf->len && isspace(Buf->str[Buf->len - 1]))
          dStr_truncate(Buf, Buf->len - 1);
 
-   return (Found) ? Buf->str : NULL;
+   return Buf->str;
 }
 
 /**
@@ -4309,138 +4830,836 @@ static void Html_callback(int Op, CacheClient_t *Client)
    }
 }
 
+/*
+ * Delimiter sets for Html_scan_token()
+ */
+static CharscanSet Html_scan_lt = CHARSCAN_SET("<");
+static CharscanSet Html_scan_space = CHARSCAN_SET(" \t\n\v\f\r");
+static CharscanSet Html_scan_word = CHARSCAN_SET(" <\n\r\t\f\v");
+static CharscanSet Html_scan_tag = CHARSCAN_SET(">\"'<");
+static CharscanSet Html_scan_dq = CHARSCAN_SET("\">");
+static CharscanSet Html_scan_sq = CHARSCAN_SET("'>");
+static CharscanSet Html_scan_dq_lt = CHARSCAN_SET("\"<");
+static CharscanSet Html_scan_sq_lt = CHARSCAN_SET("'<");
+
+/**
+ * Build the tag hash and the delimiter tables at startup, as the tokenizer
+ * thread reads them.
+ */
+void a_Html_init(void)
+{
+   Html_tag_hash_init();
+   a_Charscan_prepare(&Html_scan_lt);
+   a_Charscan_prepare(&Html_scan_space);
+   a_Charscan_prepare(&Html_scan_word);
+   a_Charscan_prepare(&Html_scan_tag);
+   a_Charscan_prepare(&Html_scan_dq);
+   a_Charscan_prepare(&Html_scan_sq);
+   a_Charscan_prepare(&Html_scan_dq_lt);
+   a_Charscan_prepare(&Html_scan_sq_lt);
+}
+
+/*
+ * Token types returned by Html_scan_token()
+ */
+typedef enum {
+   HTML_TOKEN_NONE,        /* the token isn't complete yet */
+   HTML_TOKEN_SPACE,
+   HTML_TOKEN_TAG,
+   HTML_TOKEN_COMMENT,
+   HTML_TOKEN_WORD,
+   HTML_TOKEN_VERBATIM     /* content of a VERBATIM element, up to its end */
+} HtmlTokenType;
+
+/* Token flags: problems found while scanning a tag */
+#define HTML_TOKEN_LACKS_QUOTE  (1 << 0)
+#define HTML_TOKEN_LACKS_GT     (1 << 1)
+
+/**
+ * Find the token that starts at buf[start].
+ * 'verbatim' is the name of the element whose content is being skipped,
+ * or NULL. This only reads the buffer, so it may run on any thread.
+ * Return value: the token type, and its end in 'end'.
+ */
+static int Html_scan_token(const char *buf, int bufsize, int start,
+                           const char *verbatim, int Eof, int *end,
+                           int *flags)
+{
+   const char *p;
+   char ch;
+   int buf_index = start;
+
+   *flags = 0;
+   if (verbatim) {
+      /* Non HTML code here, let's skip until closing tag */
+      int taglen = strlen(verbatim);
+
+      do {
+         buf_index += a_Charscan_find(buf + buf_index, bufsize - buf_index,
+                                      &Html_scan_lt);
+         if (buf_index + taglen + 3 > bufsize) {
+            return HTML_TOKEN_NONE;
+         } else if (strncmp(buf + buf_index, "</", 2) == 0 &&
+                    Html_match_tag(verbatim, buf+buf_index+2, taglen+1)) {
+            *end = buf_index;
+            return HTML_TOKEN_VERBATIM;
+         } else
+            ++buf_index;
+      } while (buf_index < bufsize);
+      return HTML_TOKEN_NONE;
+   }
+
+   if (isspace(buf[buf_index])) {
+      /* whitespace: group all available whitespace */
+      ++buf_index;
+      buf_index += a_Charscan_skip(buf + buf_index, bufsize - buf_index,
+                                   &Html_scan_space);
+      *end = buf_index;
+      return HTML_TOKEN_SPACE;
+
+   } else if (buf[buf_index] == '<' && (ch = buf[buf_index + 1]) &&
+              (isalpha(ch) || strchr("/!?", ch)) ) {
+      if (buf_index + 3 < bufsize && !strncmp(buf + buf_index, "<!--", 4)) {
+         /* Comment: search for close of comment, skipping over
+          * everything except a matching "-->" tag. */
+         while ( (p = (const char*) memchr(buf + buf_index, '>',
+                                           bufsize - buf_index)) ){
+            buf_index = p - buf + 1;
+            if (p[-1] == '-' && p[-2] == '-') {
+               *end = buf_index;
+               return HTML_TOKEN_COMMENT;
+            }
+         }
+         return HTML_TOKEN_NONE;
+      }
+
+      /* Tag: search end of tag (skipping over quoted strings) */
+      while ( buf_index < bufsize ) {
+         buf_index++;
+         buf_index += a_Charscan_find(buf + buf_index, bufsize - buf_index,
+                                      &Html_scan_tag);
+         if ((ch = buf[buf_index]) == '>') {
+            break;
+         } else if (ch == '"' || ch == '\'') {
+            /* Skip over quoted string */
+            buf_index++;
+            buf_index += a_Charscan_find(buf + buf_index, bufsize - buf_index,
+                                         (ch == '"') ? &Html_scan_dq :
+                                                       &Html_scan_sq);
+            if (buf[buf_index] == '>') {
+               /* Unterminated string value? Let's look ahead and test:
+                * (<: unterminated, closing-quote: terminated) */
+               int offset = buf_index + 1;
+               offset += a_Charscan_find(buf + offset, bufsize - offset,
+                                         (ch == '"') ? &Html_scan_dq_lt :
+                                                       &Html_scan_sq_lt);
+               if (buf[offset] == ch || !buf[offset]) {
+                  buf_index = offset;
+               } else {
+                  *flags |= HTML_TOKEN_LACKS_QUOTE;
+                  break;
+               }
+            }
+         } else if (ch == '<') {
+            /* unterminated tag detected */
+            *flags |= HTML_TOKEN_LACKS_GT;
+            --buf_index;
+            break;
+         }
+      }
+      if (buf_index < bufsize) {
+         *end = buf_index + 1;
+         return HTML_TOKEN_TAG;
+      }
+      return HTML_TOKEN_NONE;
+   }
+
+   /* A Word: search for whitespace or tag open */
+   while (++buf_index < bufsize) {
+      buf_index += a_Charscan_find(buf + buf_index, bufsize - buf_index,
+                                   &Html_scan_word);
+      if (buf[buf_index] == '<' && (ch = buf[buf_index + 1]) &&
+          !isalpha(ch) && !strchr("/!?", ch))
+         continue;
+      break;
+   }
+   if (buf_index < bufsize || Eof) {
+      /* successfully found end of token */
+      *end = buf_index;
+      return HTML_TOKEN_WORD;
+   }
+   return HTML_TOKEN_NONE;
+}
+
+/**
+ * Put the token buf[start..end) into the page.
+ */
+static void Html_process_token(DilloHtml *html, char *buf, int type,
+                               int start, int end, int flags)
+{
+   char ch, *p;
+
+   switch (type) {
+   case HTML_TOKEN_SPACE:
+      Html_process_space(html, buf + start, end - start);
+      break;
+   case HTML_TOKEN_TAG:
+      html->CurrOfs = html->Start_Ofs + start;
+      if (flags & HTML_TOKEN_LACKS_QUOTE)
+         BUG_MSG("Attribute lacks closing quote.");
+      if (flags & HTML_TOKEN_LACKS_GT) {
+         p = dStrndup(buf+start+1, strcspn(buf+start+1, " <\n\r\t"));
+         BUG_MSG("<%s> lacks its closing '>'.", p);
+         dFree(p);
+      }
+      Html_process_tag(html, buf + start, end - start);
+      break;
+   case HTML_TOKEN_WORD:
+      html->CurrOfs = html->Start_Ofs + start;
+      ch = buf[end];
+      buf[end] = 0;
+      Html_process_word(html, buf + start, end - start);
+      buf[end] = ch;
+      break;
+   case HTML_TOKEN_VERBATIM:
+      /* copy VERBATIM text into the stash buffer */
+      p = dStrndup(buf + start, end - start);
+      dStr_append(html->Stash, p);
+      dFree(p);
+      break;
+   default:
+      /* Got the whole comment. Let's throw it away! :) */
+      break;
+   }
+}
+
+/**
+ * Return the element whose content the next token belongs to, or -1.
+ * 'verbatim_done' tells that the content has already been taken.
+ */
+static inline int Html_verbatim_idx(DilloHtml *html, bool verbatim_done)
+{
+   return (S_TOP(html)->parse_mode == DILLO_HTML_PARSE_MODE_VERBATIM &&
+           !verbatim_done) ? S_TOP(html)->tag_idx : -1;
+}
+
 /**
  * Here's where we parse the html and put it into the Textblock structure.
  * Return value: number of bytes parsed
  */
 static int Html_write_raw(DilloHtml *html, char *buf, int bufsize, int Eof)
 {
-   char ch = 0, *p, *text;
-   int token_start, buf_index;
+   int type, vidx, end, flags, token_start = 0, ntokens = 0;
+   bool verbatim_done = false;
 
    /* Now, 'buf' and 'bufsize' define a buffer aligned to start at a token
     * boundary. Iterate through tokens until end of buffer is reached. */
-   buf_index = 0;
-   token_start = buf_index;
-   while ((buf_index < bufsize) && !html->stop_parser) {
-      /* invariant: buf_index == bufsize || token_start == buf_index */
-
-      if (S_TOP(html)->parse_mode ==
-          DILLO_HTML_PARSE_MODE_VERBATIM) {
-         /* Non HTML code here, let's skip until closing tag */
-         do {
-            const char *tag = Tags[S_TOP(html)->tag_idx].name;
-            buf_index += strcspn(buf + buf_index, "<");
-            if (buf_index + (int)strlen(tag) + 3 > bufsize) {
-               buf_index = bufsize;
-            } else if (strncmp(buf + buf_index, "</", 2) == 0 &&
-                       Html_match_tag(tag, buf+buf_index+2, strlen(tag)+1)) {
-               /* copy VERBATIM text into the stash buffer */
-               text = dStrndup(buf + token_start, buf_index - token_start);
-               dStr_append(html->Stash, text);
-               dFree(text);
-               token_start = buf_index;
-               break;
-            } else
-               ++buf_index;
-         } while (buf_index < bufsize);
+   while ((token_start < bufsize) && !html->stop_parser) {
+      if (!verbatim_done && Html_slice_expired(html, ++ntokens))
+         break;
+      vidx = Html_verbatim_idx(html, verbatim_done);
+      type = Html_scan_token(buf, bufsize, token_start,
+                             vidx == -1 ? NULL : Tags[vidx].name, Eof,
+                             &end, &flags);
+      if (type == HTML_TOKEN_NONE)
+         break;
+      Html_process_token(html, buf, type, token_start, end, flags);
+      verbatim_done = (type == HTML_TOKEN_VERBATIM);
+      token_start = end;
+   }
 
-         if (buf_index == bufsize)
-            break;
+   Html_text_run_flush(html);
+   HT2TB(html)->flush ();
+
+   return token_start;
+}
+
+/*
+ * Tokenizer thread
+ *
+ * With "parse_in_thread", large pages are split into tokens by a worker
+ * thread, that passes them to the main thread through a single-producer
+ * single-consumer ring. The main thread builds the page from the tokens
+ * that are ready, and when the ring is empty, it waits for the worker on
+ * a condition variable (for no longer than the rest of its slice).
+ *
+ * The worker reads the page straight from the cache's buffer, but only
+ * during the parser's slices: the cache may move the buffer whenever data
+ * arrives, and that only happens between slices, on the main thread. So
+ * each slice hands the buffer over with Html_tokenizer_feed(), and takes
+ * it back with Html_tokenizer_pause() before it returns.
+ *
+ * The worker can't know the parse mode, so after an opening SCRIPT, STYLE
+ * or TEXTAREA tag it guesses that their content is VERBATIM. Each token
+ * records the guess, and when it doesn't match what the parser did, the
+ * worker is restarted at that point.
+ *
+ * The tokens don't depend on how the bytes arrive, so the page is the same
+ * as with Html_write_raw(); turning "parse_in_thread" off gives the
+ * reference to compare against.
+ */
+
+#define HTML_TOKEN_RING_SIZE  1024   /* must be a power of two */
+
+typedef struct {
+   uchar_t type;
+   uchar_t flags;
+   short verbatim;         /* Tags[] index of the VERBATIM guess, or -1 */
+   int start, end;         /* offsets into the page */
+} HtmlToken;
+
+struct HtmlTokenizer {
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+
+   /* Protected by the mutex */
+   const char *buf;        /* the cache's buffer; the worker reads it without
+                            * the lock while 'scanning' */
+   int bufsize, eof;
+   int feed_gen, scan_gen; /* to know whether the last scan saw all bytes */
+   bool scanning, stalled;
+
+   /* Owned by the worker */
+   int pos;
+   int verbatim;
+
+   /* The ring; 'head' is written by the worker, 'tail' by the parser */
+   std::atomic<unsigned> head, tail;
+   std::atomic<bool> worker_waiting, parser_waiting, paused, quit;
+   HtmlToken ring[HTML_TOKEN_RING_SIZE];
+};
+
+/**
+ * Wake up whoever waits on the condition variable.
+ */
+static void Html_tokenizer_wake(HtmlTokenizer *tk)
+{
+   pthread_mutex_lock(&tk->mutex);
+   pthread_cond_broadcast(&tk->cond);
+   pthread_mutex_unlock(&tk->mutex);
+}
+
+/**
+ * Scan all the tokens available in 'buf'.
+ * Return value: whether it stopped because the ring is full.
+ */
+static bool Html_tokenizer_scan(HtmlTokenizer *tk, const char *buf,
+                                int bufsize, int eof)
+{
+   unsigned head;
+   int type, end, flags, idx;
+   HtmlToken *t;
+
+   while (tk->pos < bufsize && !tk->quit.load(std::memory_order_relaxed) &&
+          !tk->paused.load(std::memory_order_relaxed)) {
+      head = tk->head.load(std::memory_order_relaxed);
+      if (head - tk->tail.load() == HTML_TOKEN_RING_SIZE)
+         return true;
+
+      type = Html_scan_token(buf, bufsize, tk->pos,
+                             tk->verbatim == -1 ? NULL :
+                                Tags[tk->verbatim].name,
+                             eof, &end, &flags);
+      if (type == HTML_TOKEN_NONE)
+         break;
+
+      t = &tk->ring[head & (HTML_TOKEN_RING_SIZE - 1)];
+      t->type = type;
+      t->flags = flags;
+      t->verbatim = tk->verbatim;
+      t->start = tk->pos;
+      t->end = end;
+      tk->head.store(head + 1);
+      if (tk->parser_waiting.load())
+         Html_tokenizer_wake(tk);
+
+      /* guess the parse mode for the next token */
+      if (type == HTML_TOKEN_TAG && buf[tk->pos + 1] != '/') {
+         idx = a_Html_tag_index(buf + tk->pos + 1);
+         tk->verbatim = (idx == i_SCRIPT || idx == i_STYLE ||
+                         idx == i_TEXTAREA) ? idx : -1;
+      } else {
+         tk->verbatim = -1;
       }
+      tk->pos = end;
+   }
+   return false;
+}
 
-      if (isspace(buf[buf_index])) {
-         /* whitespace: group all available whitespace */
-         while (++buf_index < bufsize && isspace(buf[buf_index])) ;
-         Html_process_space(html, buf + token_start, buf_index - token_start);
-         token_start = buf_index;
-
-      } else if (buf[buf_index] == '<' && (ch = buf[buf_index + 1]) &&
-                 (isalpha(ch) || strchr("/!?", ch)) ) {
-         /* Tag */
-         if (buf_index + 3 < bufsize && !strncmp(buf + buf_index, "<!--", 4)) {
-            /* Comment: search for close of comment, skipping over
-             * everything except a matching "-->" tag. */
-            while ( (p = (char*) memchr(buf + buf_index, '>',
-                                        bufsize - buf_index)) ){
-               buf_index = p - buf + 1;
-               if (p[-1] == '-' && p[-2] == '-') break;
-            }
-            if (p) {
-               /* Got the whole comment. Let's throw it away! :) */
-               token_start = buf_index;
-            } else
-               buf_index = bufsize;
-         } else {
-            /* Tag: search end of tag (skipping over quoted strings) */
-            html->CurrOfs = html->Start_Ofs + token_start;
+/**
+ * Worker thread main loop.
+ */
+static void *Html_tokenizer_run(void *data)
+{
+   HtmlTokenizer *tk = (HtmlTokenizer *)data;
+   const char *buf;
+   int bufsize, eof;
+   bool full;
 
-            while ( buf_index < bufsize ) {
-               buf_index++;
-               buf_index += strcspn(buf + buf_index, ">\"'<");
-               if ((ch = buf[buf_index]) == '>') {
-                  break;
-               } else if (ch == '"' || ch == '\'') {
-                  /* Skip over quoted string */
-                  buf_index++;
-                  buf_index += strcspn(buf + buf_index,
-                                       (ch == '"') ? "\">" : "'>");
-                  if (buf[buf_index] == '>') {
-                     /* Unterminated string value? Let's look ahead and test:
-                      * (<: unterminated, closing-quote: terminated) */
-                     int offset = buf_index + 1;
-                     offset += strcspn(buf + offset,
-                                       (ch == '"') ? "\"<" : "'<");
-                     if (buf[offset] == ch || !buf[offset]) {
-                        buf_index = offset;
-                     } else {
-                        BUG_MSG("Attribute lacks closing quote.");
-                        break;
-                     }
-                  }
-               } else if (ch == '<') {
-                  /* unterminated tag detected */
-                  p = dStrndup(buf+token_start+1,
-                               strcspn(buf+token_start+1, " <\n\r\t"));
-                  BUG_MSG("<%s> lacks its closing '>'.", p);
-                  dFree(p);
-                  --buf_index;
-                  break;
-               }
-            }
-            if (buf_index < bufsize) {
-               buf_index++;
-               Html_process_tag(html, buf + token_start,
-                                buf_index - token_start);
-               token_start = buf_index;
-            }
-         }
+   pthread_mutex_lock(&tk->mutex);
+   while (!tk->quit.load()) {
+      if (tk->paused.load()) {
+         /* the buffer belongs to the main thread until the next feed */
+         pthread_cond_wait(&tk->cond, &tk->mutex);
+         continue;
+      }
+      buf = tk->buf;
+      bufsize = tk->bufsize;
+      eof = tk->eof;
+      tk->scan_gen = tk->feed_gen;
+      tk->scanning = true;
+      pthread_mutex_unlock(&tk->mutex);
+
+      full = Html_tokenizer_scan(tk, buf, bufsize, eof);
+
+      pthread_mutex_lock(&tk->mutex);
+      tk->scanning = false;
+      if (tk->paused.load()) {
+         /* Html_tokenizer_pause() waits for this */
+         pthread_cond_broadcast(&tk->cond);
+      } else if (full) {
+         tk->worker_waiting.store(true);
+         while (tk->head.load() - tk->tail.load() == HTML_TOKEN_RING_SIZE &&
+                !tk->quit.load() && !tk->paused.load())
+            pthread_cond_wait(&tk->cond, &tk->mutex);
+         tk->worker_waiting.store(false);
       } else {
-         /* A Word: search for whitespace or tag open */
-         html->CurrOfs = html->Start_Ofs + token_start;
+         tk->stalled = true;
+         /* the parser may be waiting for the rest */
+         pthread_cond_broadcast(&tk->cond);
+         while (tk->scan_gen == tk->feed_gen && !tk->quit.load() &&
+                !tk->paused.load())
+            pthread_cond_wait(&tk->cond, &tk->mutex);
+         tk->stalled = false;
+      }
+   }
+   pthread_mutex_unlock(&tk->mutex);
+   return NULL;
+}
 
-         while (++buf_index < bufsize) {
-            buf_index += strcspn(buf + buf_index, " <\n\r\t\f\v");
-            if (buf[buf_index] == '<' && (ch = buf[buf_index + 1]) &&
-                !isalpha(ch) && !strchr("/!?", ch))
-               continue;
+/**
+ * Start the worker at 'pos' in the page.
+ */
+static void Html_tokenizer_start(HtmlTokenizer *tk, int pos, int verbatim)
+{
+   tk->head.store(0);
+   tk->tail.store(0);
+   tk->worker_waiting.store(false);
+   tk->parser_waiting.store(false);
+   tk->quit.store(false);
+   tk->pos = pos;
+   tk->verbatim = verbatim;
+   tk->scanning = tk->stalled = false;
+   tk->scan_gen = tk->feed_gen - 1;
+   pthread_create(&tk->thread, NULL, Html_tokenizer_run, tk);
+}
+
+/**
+ * Stop the worker and wait for it. It checks for this after every token.
+ */
+static void Html_tokenizer_stop(HtmlTokenizer *tk)
+{
+   pthread_mutex_lock(&tk->mutex);
+   tk->quit.store(true);
+   pthread_cond_broadcast(&tk->cond);
+   pthread_mutex_unlock(&tk->mutex);
+   pthread_join(tk->thread, NULL);
+}
+
+/**
+ * Create a tokenizer for the page from Start_Ofs on, and start it.
+ * It waits for its first Html_tokenizer_feed().
+ */
+static HtmlTokenizer *Html_tokenizer_new(DilloHtml *html)
+{
+   HtmlTokenizer *tk = new HtmlTokenizer;
+
+   pthread_mutex_init(&tk->mutex, NULL);
+   pthread_cond_init(&tk->cond, NULL);
+   tk->buf = NULL;
+   tk->bufsize = tk->eof = 0;
+   tk->feed_gen = 0;
+   tk->paused.store(true);
+   Html_tokenizer_start(tk, html->Start_Ofs, Html_verbatim_idx(html, false));
+   return tk;
+}
+
+/**
+ * Stop the worker and free the tokenizer.
+ */
+static void Html_tokenizer_free(HtmlTokenizer *tk)
+{
+   Html_tokenizer_stop(tk);
+   pthread_cond_destroy(&tk->cond);
+   pthread_mutex_destroy(&tk->mutex);
+   delete tk;
+}
+
+/**
+ * Let the worker read the page from 'Buf' (the cache's buffer), until the
+ * next Html_tokenizer_pause().
+ */
+static void Html_tokenizer_feed(HtmlTokenizer *tk, const char *Buf,
+                                int BufSize, int Eof)
+{
+   pthread_mutex_lock(&tk->mutex);
+   tk->buf = Buf;
+   tk->bufsize = BufSize;
+   tk->eof = Eof;
+   tk->feed_gen++;
+   tk->paused.store(false);
+   pthread_cond_broadcast(&tk->cond);
+   pthread_mutex_unlock(&tk->mutex);
+}
+
+/**
+ * Make the worker stop reading the page buffer, and wait until it has.
+ * This comes before anything that may let the cache change the buffer.
+ */
+static void Html_tokenizer_pause(HtmlTokenizer *tk)
+{
+   pthread_mutex_lock(&tk->mutex);
+   tk->paused.store(true);
+   while (tk->scanning)
+      pthread_cond_wait(&tk->cond, &tk->mutex);
+   pthread_mutex_unlock(&tk->mutex);
+}
+
+/**
+ * Return the next token, if the worker has it ready, or NULL.
+ */
+static HtmlToken *Html_tokenizer_next(HtmlTokenizer *tk)
+{
+   unsigned tail = tk->tail.load(std::memory_order_relaxed);
+
+   if (tk->head.load() == tail)
+      return NULL;
+   return &tk->ring[tail & (HTML_TOKEN_RING_SIZE - 1)];
+}
+
+/**
+ * Release the token returned by Html_tokenizer_next().
+ */
+static void Html_tokenizer_pop(HtmlTokenizer *tk)
+{
+   tk->tail.store(tk->tail.load(std::memory_order_relaxed) + 1);
+   if (tk->worker_waiting.load())
+      Html_tokenizer_wake(tk);
+}
+
+/**
+ * Wait until the worker has a token ready, or has scanned all the bytes it
+ * was fed (then its state can be read, and no more tokens will come before
+ * the next feed), or until 'deadline' (as Html_now(); 0.0 for none).
+ * Return value: false if the deadline came first.
+ */
+static bool Html_tokenizer_wait(HtmlTokenizer *tk, double deadline)
+{
+   struct timespec ts;
+   double left;
+   bool ready;
+
+   pthread_mutex_lock(&tk->mutex);
+   tk->parser_waiting.store(true);
+   while (!(ready = tk->head.load() != tk->tail.load() ||
+                    (tk->stalled && tk->scan_gen == tk->feed_gen))) {
+      if (deadline == 0.0) {
+         pthread_cond_wait(&tk->cond, &tk->mutex);
+         continue;
+      }
+      if ((left = deadline - Html_now()) <= 0.0)
+         break;
+      /* pthread_cond_timedwait() takes a CLOCK_REALTIME time */
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += (time_t)left;
+      ts.tv_nsec += (long)((left - (time_t)left) * 1e9);
+      if (ts.tv_nsec >= 1000000000L) {
+         ts.tv_sec++;
+         ts.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&tk->cond, &tk->mutex, &ts);
+   }
+   tk->parser_waiting.store(false);
+   pthread_mutex_unlock(&tk->mutex);
+   return ready;
+}
+
+/**
+ * Html_write_raw() with tokens from the worker thread.
+ * When the worker hasn't got the next token by the end of the slice, this
+ * returns with html->slice_yield set.
+ * Return value: number of bytes parsed
+ */
+static int Html_write_tokens(DilloHtml *html, char *buf, int Eof)
+{
+   HtmlTokenizer *tk = html->tokenizer;
+   HtmlToken *t;
+   int type, start, end, flags, vidx, ntokens = 0;
+   int shift = html->Start_Ofs, ofs = shift;
+   bool verbatim_done = false;
+
+   /* 'buf' is the page from Start_Ofs on, and 'ofs' is the current token
+    * in the page */
+   while (!html->stop_parser) {
+      if (!verbatim_done && Html_slice_expired(html, ++ntokens))
+         break;
+      vidx = Html_verbatim_idx(html, verbatim_done);
+      if (!(t = Html_tokenizer_next(tk))) {
+         if (!Html_tokenizer_wait(tk, html->slice_end)) {
+            /* come back for it in the next slice */
+            html->slice_yield = true;
             break;
          }
-         if (buf_index < bufsize || Eof) {
-            /* successfully found end of token */
-            ch = buf[buf_index];
-            buf[buf_index] = 0;
-            Html_process_word(html, buf + token_start,
-                              buf_index - token_start);
-            buf[buf_index] = ch;
-            token_start = buf_index;
-         }
+         if (!(t = Html_tokenizer_next(tk)) && tk->verbatim == vidx)
+            break;
       }
-   }/*while*/
+      if (t ? (t->start != ofs || t->verbatim != vidx) :
+              (tk->verbatim != vidx)) {
+         /* the worker guessed the parse mode wrong */
+         Html_tokenizer_stop(tk);
+         Html_tokenizer_start(tk, ofs, vidx);
+         continue;
+      }
+      start = t->start;
+      type = t->type;
+      end = t->end;
+      flags = t->flags;
+      Html_tokenizer_pop(tk);
+
+      Html_process_token(html, buf, type, start - shift, end - shift, flags);
+      verbatim_done = (type == HTML_TOKEN_VERBATIM);
+      ofs = end;
+   }
 
+   Html_text_run_flush(html);
    HT2TB(html)->flush ();
 
-   return token_start;
+   return ofs - shift;
+}
+
+/*
+ * Preload scanner
+ *
+ * While the parser works its way through a large page, it looks ahead over
+ * the bytes received so far for images, stylesheets and @import rules, and
+ * asks the cache for them. By the time the parser gets to those elements,
+ * their data is on the way or already there, and the parser's own request
+ * joins it.
+ *
+ * It's a guess: it skips comments and the content of SCRIPT, STYLE and
+ * TEXTAREA, but doesn't know about the rest of the parse modes, and it
+ * waits at a BASE element until the parser has taken it. It follows the
+ * parser's rules for what is loaded at all (SpamSafe pages, LINK outside
+ * the HEAD, type and media), and the requests belong to the browser
+ * window like the parser's own, so that they stop with the page.
+ */
+
+#define HTML_PRELOAD_MAX 32    /* requests per document */
+
+/**
+ * The data is only wanted in the cache.
+ */
+static void Html_preload_callback(int Op, CacheClient_t *Client)
+{
+   DilloWeb *Web = (DilloWeb *)Client->Web;
+
+   /* Remove this client from the bw's list (see Html_preload_url) */
+   if (Op == CA_Close)
+      a_Bw_close_client(Web->bw, Client->Key);
+}
+
+/**
+ * Ask the cache for 'url_str', unless it already has it.
+ */
+static void Html_preload_url(DilloHtml *html, const char *url_str)
+{
+   DilloUrl *url;
+   DilloWeb *Web;
+   int ClientKey;
+   char *str = dStrdup(url_str), *p;
+
+   /* &amp; is the only character reference common in URLs */
+   for (p = str; (p = strstr(p, "&amp;")); ++p)
+      memmove(p + 1, p + 5, strlen(p + 5) + 1);
+
+   if (*str && (url = a_Url_new(str, URL_STR_(html->base_url)))) {
+      if ((!dStrAsciiCasecmp(URL_SCHEME(url), "http") ||
+           !dStrAsciiCasecmp(URL_SCHEME(url), "https")) &&
+          !(a_Capi_get_flags(url) & CAPI_IsCached)) {
+         _MSG("Html_preload_url: %s\n", URL_STR(url));
+         Web = a_Web_new(html->bw, url, html->page_url);
+         ClientKey = a_Capi_open_url(Web, Html_preload_callback, NULL);
+         if (ClientKey) {
+            /* so that it's stopped with the page */
+            a_Bw_add_client(html->bw, ClientKey, 0);
+            a_Bw_add_url(html->bw, url);
+         }
+         html->preload_count++;
+      }
+      a_Url_free(url);
+   }
+   dFree(str);
+}
+
+/**
+ * Whether a LINK or STYLE with this media attribute is loaded
+ * (the test in Html_tag_open_link() and Html_tag_open_style()).
+ */
+static bool Html_preload_media(const char *media)
+{
+   return !media || !dStrAsciiCasecmp(media, "all") ||
+          dStriAsciiStr(media, "screen");
+}
+
+/**
+ * Whether an @import rule with this media list is loaded: it's empty, or
+ * it has "all" or "screen" (as in CssParser::parseImport()).
+ */
+static bool Html_preload_import_media(const char *media, int len)
+{
+   int i, j;
+   bool empty = true;
+
+   for (i = 0; i < len; i = j) {
+      for ( ; i < len && !isalnum(media[i]); ++i) ;
+      for (j = i; j < len && (isalnum(media[j]) || media[j] == '-'); ++j) ;
+      if (j > i) {
+         empty = false;
+         if ((j - i == 3 && !dStrnAsciiCasecmp(media + i, "all", 3)) ||
+             (j - i == 6 && !dStrnAsciiCasecmp(media + i, "screen", 6)))
+            return true;
+      }
+   }
+   return empty;
+}
+
+/**
+ * Preload the @import rules at the start of a STYLE element.
+ */
+static void Html_preload_imports(DilloHtml *html, const char *css, int len)
+{
+   char *url;
+   int i = 0, j;
+   char delim;
+
+   while (html->preload_count < HTML_PRELOAD_MAX) {
+      for ( ; i < len && (isspace(css[i]) || css[i] == ';'); ++i) ;
+      if (len - i < 7 || dStrnAsciiCasecmp(css + i, "@import", 7))
+         break;
+      for (i += 7; i < len && isspace(css[i]); ++i) ;
+      if (len - i > 4 && !dStrnAsciiCasecmp(css + i, "url(", 4))
+         for (i += 4; i < len && isspace(css[i]); ++i) ;
+      delim = (i < len && (css[i] == '"' || css[i] == '\'')) ? css[i++] : ')';
+      for (j = i; j < len && css[j] != delim && css[j] != ';' &&
+                  (delim != ')' || !isspace(css[j])); ++j) ;
+      if (j == len)
+         break;
+      url = dStrndup(css + i, j - i);
+      /* the media list, if any */
+      for (i = j; i < len && css[i] != ';'; ++i) ;
+      if (Html_preload_import_media(css + j, i - j))
+         Html_preload_url(html, url);
+      dFree(url);
+   }
+}
+
+/**
+ * Look at an open tag of element 'idx' for something to preload.
+ * Return value: the element whose content must be skipped, or -1.
+ */
+static int Html_preload_tag(DilloHtml *html, const char *tag, int tagsize,
+                            int idx)
+{
+   const char *attrbuf;
+   int flags = HTML_LeftTrim | HTML_RightTrim;
+
+   if (idx == i_IMG && prefs.load_images) {
+      if ((attrbuf = Html_get_attr2(html, tag, tagsize, "src", flags)))
+         Html_preload_url(html, attrbuf);
+   } else if (idx == i_LINK && prefs.load_stylesheets &&
+              !html->preload_body) {
+      /* only what Html_tag_open_link() would load */
+      if ((attrbuf = Html_get_attr2(html, tag, tagsize, "rel", flags)) &&
+          !dStrAsciiCasecmp(attrbuf, "stylesheet") &&
+          (!(attrbuf = Html_get_attr2(html, tag, tagsize, "type", flags)) ||
+           !dStrAsciiCasecmp(attrbuf, "text/css")) &&
+          Html_preload_media(Html_get_attr2(html, tag, tagsize, "media",
+                                            flags)) &&
+          (attrbuf = Html_get_attr2(html, tag, tagsize, "href", flags)))
+         Html_preload_url(html, attrbuf);
+   } else if (idx == i_STYLE) {
+      /* as in Html_tag_open_style() */
+      html->preload_css =
+         (!(attrbuf = Html_get_attr2(html, tag, tagsize, "type", flags)) ||
+          !dStrAsciiCasecmp(attrbuf, "text/css")) &&
+         Html_preload_media(Html_get_attr2(html, tag, tagsize, "media",
+                                           flags));
+   } else if ((Tags[idx].Flags & 8) && !(Tags[idx].Flags & 16)) {
+      /* a body element ends the HEAD (see Html_test_section()) */
+      html->preload_body = true;
+   }
+   html->attr_tag = NULL;
+
+   return (idx == i_SCRIPT || idx == i_STYLE || idx == i_TEXTAREA) ? idx : -1;
+}
+
+/**
+ * Scan the bytes ahead of the parser for resources to preload.
+ */
+static void Html_preload_scan(DilloHtml *html)
+{
+   const char *buf = html->Start_Buf;
+   int type, end, flags, idx, skip = html->preload_skip;
+   int i = html->preload_ofs, bufsize = html->Buf_Size;
+
+   /* When viewing suspicious HTML email, don't load anything */
+   dReturn_if (URL_FLAGS(html->base_url) & URL_SpamSafe);
+
+   if (i < html->Start_Ofs) {
+      /* the parser got ahead, and knows better */
+      i = html->Start_Ofs;
+      skip = Html_verbatim_idx(html, false);
+      html->preload_css = html->loadCssFromStash;
+      html->preload_body = (html->InFlags & IN_BODY) ||
+                           (html->Num_HEAD > 0 && !(html->InFlags & IN_HEAD));
+   }
+
+   while (i < bufsize && html->preload_count < HTML_PRELOAD_MAX) {
+      if (skip != -1) {
+         type = Html_scan_token(buf, bufsize, i, Tags[skip].name,
+                                html->Buf_Eof, &end, &flags);
+         if (type == HTML_TOKEN_NONE)
+            break;
+         if (skip == i_STYLE && html->preload_css &&
+             prefs.load_stylesheets)
+            Html_preload_imports(html, buf + i, end - i);
+         skip = -1;
+         i = end;
+         continue;
+      }
+
+      /* only tags matter here, so go from '<' to '<' */
+      i += a_Charscan_find(buf + i, bufsize - i, &Html_scan_lt);
+      if (i == bufsize)
+         break;
+      type = Html_scan_token(buf, bufsize, i, NULL, html->Buf_Eof,
+                             &end, &flags);
+      if (type == HTML_TOKEN_NONE)
+         break;
+      if (type == HTML_TOKEN_TAG && buf[i + 1] == '/') {
+         if (a_Html_tag_index(buf + i + 2) == i_HEAD)
+            html->preload_body = true;
+      } else if (type == HTML_TOKEN_TAG &&
+                 (idx = a_Html_tag_index(buf + i + 1)) != -1) {
+         if (idx == i_BASE)
+            break;   /* wait until the parser has the new base URL */
+         skip = Html_preload_tag(html, buf + i, end - i, idx);
+      }
+      i = end;
+   }
+   html->preload_ofs = i;
+   html->preload_skip = skip;
 }
 
 
@@ -26,6 +26,7 @@ extern "C" {
 /*
  * Exported functions
  */
+void a_Html_init(void);
 void a_Html_load_images(void *v_html, DilloUrl *pattern);
 void a_Html_form_submit(void *v_html, void *v_form);
 void a_Html_form_reset(void *v_html, void *v_form);
@@ -0,0 +1,112 @@
+#
+# File: html_charref_trie.awk
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# Build a trie of the names in html_charrefs.h, as C tables for html.cc.
+# Usage: LC_ALL=C awk -f html_charref_trie.awk html_charrefs.h
+#
+# Node 0 is the root. The children of a node are contiguous and sorted,
+# which comes for free from Charrefs[] being sorted: the names below a
+# node are a contiguous range of it. Nodes are numbered depth first.
+#
+# A name is "legacy" when HTML5 also recognizes it without a ';': those
+# that stand for a Latin-1 character in HTML4 (or for '&', '<', '>' and
+# '"'), and the upper case AMP, COPY, GT, LT, QUOT and REG.
+#
+
+function unquote(s)
+{
+   s = substr(s, 2, length(s) - 2)
+   gsub(/\\"/, "\"", s)
+   gsub(/\\\\/, "\\", s)
+   return s
+}
+
+function is_legacy(name, html4,   c)
+{
+   if (name ~ /^(AMP|COPY|GT|LT|QUOT|REG)$/)
+      return 1
+   if (html4 == "NULL")
+      return 0
+   html4 = unquote(html4)
+   c = substr(html4, 1, 1)
+   if (length(html4) == 1)
+      return (c == "&" || c == "<" || c == ">" || c == "\"")
+   # U+00A0 to U+00FF are C2 A0 to C3 BF in UTF-8
+   return (length(html4) == 2 && (c == "\302" || c == "\303"))
+}
+
+# Fill in node 'n' for names[lo..hi), which share 'k' characters.
+function build(n, lo, hi, k,   i, j, first)
+{
+   ref[n] = -1
+   legacy[n] = 0
+   if (lo < hi && length(names[lo]) == k) {
+      ref[n] = lo
+      legacy[n] = legacies[lo]
+      lo++
+   }
+
+   # one child per distinct k-th character
+   child[n] = first = used
+   nchild[n] = 0
+   for (i = lo; i < hi; i = j) {
+      for (j = i + 1; j < hi && substr(names[j], k + 1, 1) == \
+                                substr(names[i], k + 1, 1); ++j) ;
+      chars[used++] = substr(names[i], k + 1, 1)
+      nchild[n]++
+   }
+   for (i = lo; i < hi; i = j) {
+      for (j = i + 1; j < hi && substr(names[j], k + 1, 1) == \
+                                substr(names[i], k + 1, 1); ++j) ;
+      build(first++, i, j, k + 1)
+   }
+}
+
+BEGIN {
+   n = 0
+}
+
+/^\{"/ {
+   name = substr($0, 3)
+   name = substr(name, 1, index(name, "\"") - 1)
+   if (!match($0, /, (NULL|"([^"\\]|\\.)*")},[ \t]*$/)) {
+      print "html_charref_trie.awk: can't read line " NR > "/dev/stderr"
+      exit 1
+   }
+   html4 = substr($0, RSTART + 2, RLENGTH - 2)
+   sub(/},[ \t]*$/, "", html4)
+   if (n > 0 && name <= names[n - 1]) {
+      print "html_charref_trie.awk: " name " is out of order" > "/dev/stderr"
+      exit 1
+   }
+   legacies[n] = is_legacy(name, html4)
+   names[n++] = name
+}
+
+END {
+   if (n == 0)
+      exit 1
+   used = 1
+   chars[0] = ""
+   build(0, 0, n, 0)
+
+   print "/* Generated from html_charrefs.h by html_charref_trie.awk */"
+   print ""
+   print "typedef struct {"
+   print "   char c;"
+   print "   char legacy;        /* HTML5 also takes it without ';' */"
+   print "   short ref;          /* index in Charrefs[] or -1 */"
+   print "   ushort_t child, nchild;"
+   print "} Html_charref_node;"
+   print ""
+   print "static const Html_charref_node Html_charref_trie[" used "] = {"
+   for (i = 0; i < used; ++i)
+      printf("{%s, %d, %d, %d, %d},\n", i ? "'" chars[i] "'" : "'\\0'",
+             legacy[i], ref[i], child[i], nchild[i])
+   print "};"
+}
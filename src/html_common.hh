@@ -21,6 +21,7 @@
 #include "dw/core.hh"
 #include "dw/image.hh"
 #include "dw/style.hh"
+#include "dw/textblock.hh"
 
 #include "image.hh"
 
@@ -110,11 +111,20 @@ typedef enum {
  * Data Structures
  */
 
+struct HtmlTokenizer;
+
 typedef struct {
    DilloUrl *url;
    DilloImage *image;
 } DilloHtmlImage;
 
+/** An attribute of the tag being processed, as offsets into the tag */
+typedef struct {
+   int name, nameLen;
+   uint32_t nameHash;      /**< case-insensitive hash of the name */
+   int value, valueLen;    /**< value is -1 for an attribute without one */
+} DilloHtmlAttr;
+
 typedef struct {
    DilloHtmlParseMode parse_mode;
    DilloHtmlTableMode table_mode;
@@ -167,6 +177,21 @@ public:  //BUG: for now everything is public
    /* -------------------------------------------------------------------*/
    char *Start_Buf;
    int Start_Ofs;
+   int Buf_Size, Buf_Eof;   /**< as given to write() last time */
+   HtmlTokenizer *tokenizer; /**< worker thread that splits into tokens */
+
+   /* Time slicing (see DilloHtml::parseSlice) */
+   double slice_end;      /**< when the current slice must yield, or 0 */
+   bool slice_yield;      /**< the last slice ran out of time */
+   bool slice_pending;    /**< queued for another slice */
+   int finish_key;        /**< client key for a deferred finishParsing() */
+
+   /* Preload scanner (see Html_preload_scan) */
+   int preload_ofs;       /**< how far it got */
+   int preload_skip;      /**< element whose content it's skipping, or -1 */
+   int preload_count;     /**< requests made so far */
+   bool preload_css;      /**< the STYLE it's skipping is loaded */
+   bool preload_body;     /**< it got past the HEAD */
    char *content_type, *charset;
    bool stop_parser;
 
@@ -180,6 +205,7 @@ public:  //BUG: for now everything is public
 
    lout::misc::SimpleVector<DilloHtmlState> *stack;
    StyleEngine *styleEngine;
+   lout::misc::ZoneAllocator *zone; /**< memory freed with the document */
 
    int InFlags; /**< tracks which elements we are in */
 
@@ -201,7 +227,16 @@ public:  //BUG: for now everything is public
     * ATM they're used as three state flags {0,1,>1} */
    uchar_t Num_HTML, Num_HEAD, Num_BODY, Num_TITLE;
 
+   /* Text waiting to be added to the current textblock in one go */
+   Dstr *textRunBuf;
+   lout::misc::SimpleVector<dw::Textblock::TextRunItem> *textRun;
+   dw::core::style::Style *textRunStyle;
+
+   Dstr *word_data;       /**< Buffer for words with entities */
    Dstr *attr_data;       /**< Buffer for attribute value */
+   const char *attr_tag;  /**< The tag described by 'attrs' */
+   int attr_tagsize;
+   lout::misc::SimpleVector<DilloHtmlAttr> *attrs; /**< its attributes */
 
    int32_t non_css_link_color; /**< as provided by link attribute in BODY */
    int32_t non_css_visited_color; /**< as provided by vlink attribute in BODY */
@@ -213,12 +248,14 @@ public:  //BUG: for now everything is public
    lout::misc::SimpleVector<DilloHtmlForm*> *forms;
    lout::misc::SimpleVector<DilloHtmlInput*> *inputs_outside_form;
    lout::misc::SimpleVector<DilloUrl*> *links;
+   lout::misc::SimpleVector<DoctreeNode*> *linkNodes; /**< element of each */
    lout::misc::SimpleVector<DilloHtmlImage*> *images;
    dw::ImageMapsList maps;
 
 private:
    void freeParseData();
    void initDw();  /* Used by the constructor */
+   void parseSlice();
 
 public:
    DilloHtml(BrowserWindow *bw, const DilloUrl *url, const char *content_type);
@@ -226,6 +263,7 @@ public:
    void bugMessage(const char *format, ... );
    void connectSignals(dw::core::Widget *dw);
    void write(char *Buf, int BufSize, int Eof);
+   void resumeParsing();
    int getCurrLineNumber();
    void finishParsing(int ClientKey);
    int formNew(DilloHtmlMethod method, const DilloUrl *action,
@@ -257,6 +295,7 @@ public:
  */
 
 int a_Html_tag_index(const char *tag);
+const char *a_Html_tag_name(int idx);
 
 const char *a_Html_get_attr(DilloHtml *html,
                             const char *tag,
@@ -418,15 +418,37 @@ int a_Misc_parse_search_url(char *source, char **label, char **urlstr)
    return ret;
 }
 
+static const char *const Misc_base64_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                                 "abcdefghijklmnopqrstuvwxyz"
+                                                 "0123456789+/";
+
+/** Reverse of Misc_base64_alphabet; 255 marks characters outside of it. */
+static const unsigned char Misc_base64_table[256] = {
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* 00-0F */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* 10-1F */
+   255,255,255,255,255,255,255,255,255,255,255, 62,255,255,255, 63,  /* 20-2F */
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255,255,255,255,  /* 30-3F */
+   255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  /* 40-4F */
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255,255,  /* 50-5F */
+   255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,  /* 60-6F */
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255,  /* 70-7F */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* 80-8F */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* 90-9F */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* A0-AF */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* B0-BF */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* C0-CF */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* D0-DF */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,  /* E0-EF */
+   255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255   /* F0-FF */
+};
+
 /**
  * Encodes string using base64 encoding.
  * Return value: new string or NULL if input string is empty.
  */
 char *a_Misc_encode_base64(const char *in)
 {
-   static const char *const base64_hex = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                         "abcdefghijklmnopqrstuvwxyz"
-                                         "0123456789+/";
+   const char *const base64_hex = Misc_base64_alphabet;
    char *out = NULL;
    int len, i = 0;
 
@@ -456,6 +478,70 @@ char *a_Misc_encode_base64(const char *in)
    return out;
 }
 
+/**
+ * Decodes 'len' bytes of base64 encoded data.
+ *
+ * Whole quanta of four alphabet characters are decoded at once into a
+ * 24 bit word; only when a quantum holds something else (line breaks,
+ * blanks, padding) the slow path takes over, skipping characters outside
+ * the alphabet. Decoding stops at the first '='.
+ *
+ * Return value: new Dstr holding the decoded bytes.
+ */
+Dstr *a_Misc_decode_base64(const char *in, size_t len)
+{
+   const unsigned char *s = (const unsigned char *)in, *end = s + len;
+   const unsigned char *const tbl = Misc_base64_table;
+   unsigned char *out;
+   uint_t a, b, c, d, acc = 0;
+   int n = 0;
+   Dstr *ds;
+
+   ds = dStr_sized_new((int)(len / 4 * 3 + 3));
+   out = (unsigned char *)ds->str;
+
+   while (s < end) {
+      if (n == 0) {
+         /* fast path */
+         while (end - s >= 4) {
+            a = tbl[s[0]]; b = tbl[s[1]]; c = tbl[s[2]]; d = tbl[s[3]];
+            if ((a | b | c | d) & 0x80)
+               break;
+            acc = (a << 18) | (b << 12) | (c << 6) | d;
+            out[0] = (unsigned char)(acc >> 16);
+            out[1] = (unsigned char)(acc >> 8);
+            out[2] = (unsigned char)acc;
+            out += 3;
+            s += 4;
+         }
+         if (s == end)
+            break;
+      }
+      if (*s == '=')
+         break;
+      if ((d = tbl[*s++]) & 0x80)
+         continue;
+      acc = (acc << 6) | d;
+      if (++n == 4) {
+         out[0] = (unsigned char)(acc >> 16);
+         out[1] = (unsigned char)(acc >> 8);
+         out[2] = (unsigned char)acc;
+         out += 3;
+         n = 0;
+      }
+   }
+   /* trailing partial quantum */
+   if (n == 2) {
+      *out++ = (unsigned char)(acc >> 4);
+   } else if (n == 3) {
+      *out++ = (unsigned char)(acc >> 10);
+      *out++ = (unsigned char)(acc >> 2);
+   }
+   ds->len = (int)(out - (unsigned char *)ds->str);
+   ds->str[ds->len] = 0;
+   return ds;
+}
+
 /**
  * Load a local file into a dStr.
  * Return value: dStr on success, NULL on error.
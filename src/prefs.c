@@ -88,6 +88,8 @@ void a_Prefs_init(void)
    prefs.link_actions = dList_new(16);
    prefs.panel_size = P_medium;
    prefs.parse_embedded_css=TRUE;
+   prefs.parse_in_thread=FALSE;
+   prefs.parse_time_slice = 8;
    prefs.save_dir = dStrdup(PREFS_SAVE_DIR);
    prefs.scroll_step = 100;
    prefs.scroll_page_overlap = 50;
@@ -129,6 +131,7 @@ void a_Prefs_init(void)
    prefs.ui_tab_height = 20;
    prefs.ui_tab_fg_color = -1;
    prefs.ui_text_bg_color = -1;
+   prefs.view_source_plain = FALSE;
 
    prefs.penalty_hyphen = 100;
    prefs.penalty_hyphen_2 = 800;
@@ -101,6 +101,8 @@ typedef struct {
    bool_t load_background_images;
    bool_t load_stylesheets;
    bool_t parse_embedded_css;
+   bool_t parse_in_thread;
+   int32_t parse_time_slice;
    bool_t http_persistent_conns;
    bool_t http_strict_transport_security;
    bool_t http_force_https;
@@ -120,6 +122,7 @@ typedef struct {
    char *save_dir;
    bool_t show_msg;
    bool_t show_extra_warnings;
+   bool_t view_source_plain;
    bool_t middle_click_drags_page;
    int penalty_hyphen, penalty_hyphen_2;
    int penalty_em_dash_left, penalty_em_dash_right, penalty_em_dash_right_2;
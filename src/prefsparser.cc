@@ -199,6 +199,8 @@ void PrefsParser::parse(FILE *fp)
       { "no_proxy", &prefs.no_proxy, PREFS_STRING, 0 },
       { "panel_size", &prefs.panel_size, PREFS_PANEL_SIZE, 0 },
       { "parse_embedded_css", &prefs.parse_embedded_css, PREFS_BOOL, 0 },
+      { "parse_in_thread", &prefs.parse_in_thread, PREFS_BOOL, 0 },
+      { "parse_time_slice", &prefs.parse_time_slice, PREFS_INT32, 0 },
       { "save_dir", &prefs.save_dir, PREFS_STRING, 0 },
       { "scroll_step", &prefs.scroll_step, PREFS_INT32, 0 },
       { "scroll_page_overlap", &prefs.scroll_page_overlap, PREFS_INT32, 0 },
@@ -238,6 +240,7 @@ void PrefsParser::parse(FILE *fp)
       { "ui_tab_fg_color", &prefs.ui_tab_fg_color, PREFS_COLOR, 0 },
       { "ui_tab_height", &prefs.ui_tab_height, PREFS_INT32, 0 },
       { "ui_text_bg_color", &prefs.ui_text_bg_color, PREFS_COLOR, 0 },
+      { "view_source_plain", &prefs.view_source_plain, PREFS_BOOL, 0 },
       { "penalty_hyphen", &prefs.penalty_hyphen, PREFS_FRACTION_100, 0 },
       { "penalty_hyphen_2", &prefs.penalty_hyphen_2, PREFS_FRACTION_100, 0 },
       { "penalty_em_dash_left", &prefs.penalty_em_dash_left,
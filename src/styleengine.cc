@@ -10,6 +10,10 @@
  * (at your option) any later version.
  */
 
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "../dlib/dlib.h"
 #include "msg.h"
 #include "prefs.h"
@@ -18,6 +22,7 @@
 #include "styleengine.hh"
 #include "web.hh"
 #include "capi.h"
+#include "uarules.h"
 
 using namespace lout::misc;
 using namespace dw::core::style;
@@ -61,18 +66,25 @@ void StyleImageDeletionReceiver::deleted (lout::signal::ObservedObject *object)
 
 StyleEngine::StyleEngine (dw::core::Layout *layout,
                           const DilloUrl *pageUrl, const DilloUrl *baseUrl,
-                          float zoom) {
+                          float zoom, lout::misc::ZoneAllocator *zone) {
    StyleAttrs style_attrs;
    FontAttrs font_attrs;
 
-   doctree = new Doctree ();
+   /* Style engines for a widget (plain text, images) don't outlive it
+    * and have no document zone to borrow; they get a small one. */
+   ownZone = zone ? NULL : new lout::misc::ZoneAllocator (1024);
+   doctree = new Doctree (zone ? zone : ownZone);
    stack = new lout::misc::SimpleVector <Node> (1);
    cssContext = new CssContext ();
+   inlineStyles = new lout::container::typed::HashTable
+      <lout::object::ConstString, InlineStyle> (true, true);
    buildUserStyle ();
    this->layout = layout;
    this->pageUrl = pageUrl ? a_Url_dup(pageUrl) : NULL;
    this->baseUrl = baseUrl ? a_Url_dup(baseUrl) : NULL;
    importDepth = 0;
+   sharedStyles = memoizedStyles = computedStyles = 0;
+   memset (computedStyleCache, 0, sizeof (computedStyleCache));
    dpmm = layout->dpiX () / 25.4; /* assume dpiX == dpiY */
    this->zoom = zoom;
 
@@ -106,17 +118,27 @@ StyleEngine::~StyleEngine () {
    stackPop (); // dummy node on the bottom of the stack
    assert (stack->size () == 0);
 
+   _MSG("StyleEngine: ancestor filter rejected %d selectors, %d walked\n",
+        doctree->filterRejected, doctree->filterWalked);
+   _MSG("StyleEngine: %d styles shared with a sibling, %d memoized, "
+        "%d computed\n", sharedStyles, memoizedStyles, computedStyles);
+
+   clearComputedStyles ();
+
    a_Url_free(pageUrl);
    a_Url_free(baseUrl);
 
    delete stack;
    delete doctree;
+   delete ownZone;
    delete cssContext;
+   delete inlineStyles;
 }
 
 void StyleEngine::stackPush () {
    static const Node emptyNode = {
-      NULL, NULL, NULL, NULL, NULL, NULL, false, false, NULL
+      NULL, NULL, NULL, NULL, NULL, NULL, false, false, NULL, 0,
+      { NULL, NULL, NULL, NULL, NULL, 0, false, false }
    };
 
    stack->setSize (stack->size () + 1, emptyNode);
@@ -125,8 +147,34 @@ void StyleEngine::stackPush () {
 void StyleEngine::stackPop () {
    Node *n = stack->getRef (stack->size () - 1);
 
-   delete n->styleAttrProperties;
-   delete n->styleAttrPropertiesImportant;
+   clearSiblingStyle (&n->lastChild);
+
+   if (stack->size () > 1) {
+      /* offer the style to the next sibling */
+      Node *pn = stack->getRef (stack->size () - 2);
+      SiblingStyle *s = &pn->lastChild;
+
+      clearSiblingStyle (s);
+      if (n->style) {
+         s->doctreeNode = n->doctreeNode;
+         s->style = n->style;
+         s->styleAttrProperties = n->styleAttrProperties;
+         s->styleAttrPropertiesImportant = n->styleAttrPropertiesImportant;
+         s->nonCssProperties = n->nonCssProperties;
+         s->ruleCount = n->ruleCount;
+         s->parentInheritBackgroundColor = pn->inheritBackgroundColor;
+         s->displayNone = n->displayNone;
+         n->style = NULL;
+         n->styleAttrProperties = NULL;
+         n->styleAttrPropertiesImportant = NULL;
+         n->nonCssProperties = NULL;
+      }
+   }
+
+   if (n->styleAttrProperties)
+      n->styleAttrProperties->unref ();
+   if (n->styleAttrPropertiesImportant)
+      n->styleAttrPropertiesImportant->unref ();
    delete n->nonCssProperties;
    if (n->style)
       n->style->unref ();
@@ -137,6 +185,152 @@ void StyleEngine::stackPop () {
    stack->setSize (stack->size () - 1);
 }
 
+void StyleEngine::clearSiblingStyle (SiblingStyle *s) {
+   if (s->style)
+      s->style->unref ();
+   if (s->styleAttrProperties)
+      s->styleAttrProperties->unref ();
+   if (s->styleAttrPropertiesImportant)
+      s->styleAttrPropertiesImportant->unref ();
+   delete s->nonCssProperties;
+   s->doctreeNode = NULL;
+   s->style = NULL;
+   s->styleAttrProperties = NULL;
+   s->styleAttrPropertiesImportant = NULL;
+   s->nonCssProperties = NULL;
+}
+
+static inline bool sameString (const char *s1, const char *s2) {
+   return s1 == s2 || (s1 && s2 && strcmp (s1, s2) == 0);
+}
+
+/**
+ * \brief Take over the style of the previous sibling, if none of the rules
+ * can tell the two elements apart.
+ *
+ * Both have the same parent, and thereby the same ancestors and inherited
+ * values, so this holds if they have the same element, id, classes,
+ * pseudo class, style attribute (see setStyle ()) and non-CSS hints, and
+ * no rule looks at preceding siblings.
+ */
+bool StyleEngine::shareSiblingStyle (int i) {
+   Node *n = stack->getRef (i), *pn = stack->getRef (i - 1);
+   SiblingStyle *s = &pn->lastChild;
+   DoctreeNode *dn = n->doctreeNode, *sn = s->doctreeNode;
+
+   if (!s->style ||
+       n->styleAttrProperties != s->styleAttrProperties ||
+       n->styleAttrPropertiesImportant != s->styleAttrPropertiesImportant ||
+       s->ruleCount != cssContext->getRuleCount () ||
+       !cssContext->canShareSiblingStyles () ||
+       s->parentInheritBackgroundColor != pn->inheritBackgroundColor ||
+       sn->element != dn->element ||
+       !sameString (sn->id, dn->id) ||
+       !sameString (sn->pseudo, dn->pseudo))
+      return false;
+
+   if (sn->klass || dn->klass) {
+      if (!sn->klass || !dn->klass ||
+          sn->klass->size () != dn->klass->size ())
+         return false;
+      for (int j = 0; j < dn->klass->size (); j++)
+         if (strcmp (sn->klass->get (j), dn->klass->get (j)) != 0)
+            return false;
+   }
+
+   if (n->nonCssProperties ?
+       !n->nonCssProperties->equals (s->nonCssProperties) :
+       s->nonCssProperties != NULL)
+      return false;
+
+   n->style = s->style;
+   n->style->ref ();
+   n->displayNone = s->displayNone;
+   n->ruleCount = s->ruleCount;
+   sharedStyles++;
+   return true;
+}
+
+/**
+ * \brief Take over a style that was computed before from the same
+ * parent style and the same declarations.
+ *
+ * This is where elements end up that match the same rules as an earlier
+ * one which is not their previous sibling, e.g. the cells of a table.
+ */
+bool StyleEngine::lookupComputedStyle (int i, CssPropertyList *props,
+                                       unsigned hash) {
+   Node *n = stack->getRef (i), *pn = stack->getRef (i - 1);
+   ComputedStyle *set =
+      computedStyleCache + (hash % computedStyleSets) * computedStyleWays;
+
+   for (int j = 0; j < computedStyleWays && set[j].style; j++) {
+      ComputedStyle *c = &set[j];
+
+      if (c->hash == hash &&
+          c->parentStyle == pn->style &&
+          c->parentInheritBackgroundColor == pn->inheritBackgroundColor &&
+          c->displayNone == n->displayNone &&
+          c->props->equals (props)) {
+         ComputedStyle found = *c;
+
+         memmove (set + 1, set, j * sizeof (ComputedStyle));
+         set[0] = found;
+
+         n->style = found.style;
+         n->style->ref ();
+         n->displayNone = found.resultDisplayNone;
+         memoizedStyles++;
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * \brief Remember the style that was just computed for stack entry i.
+ *
+ * props must not be modified by StyleEngine::apply () yet, and
+ * displayNone is the inherited value from before.
+ */
+void StyleEngine::storeComputedStyle (int i, CssPropertyList *props,
+                                      unsigned hash, bool displayNone) {
+   Node *n = stack->getRef (i), *pn = stack->getRef (i - 1);
+   ComputedStyle *set =
+      computedStyleCache + (hash % computedStyleSets) * computedStyleWays;
+   ComputedStyle *last = &set[computedStyleWays - 1];
+
+   if (last->style) {
+      last->style->unref ();
+      last->parentStyle->unref ();
+      delete last->props;
+   }
+   memmove (set + 1, set, (computedStyleWays - 1) * sizeof (ComputedStyle));
+
+   set[0].hash = hash;
+   set[0].props = props;
+   set[0].parentStyle = pn->style;
+   set[0].parentStyle->ref ();
+   set[0].parentInheritBackgroundColor = pn->inheritBackgroundColor;
+   set[0].displayNone = displayNone;
+   set[0].resultDisplayNone = n->displayNone;
+   set[0].style = n->style;
+   set[0].style->ref ();
+}
+
+void StyleEngine::clearComputedStyles () {
+   for (int i = 0; i < computedStyleSets * computedStyleWays; i++) {
+      ComputedStyle *c = &computedStyleCache[i];
+
+      if (c->style) {
+         c->style->unref ();
+         c->parentStyle->unref ();
+         delete c->props;
+         c->style = NULL;
+      }
+   }
+}
+
 /**
  * \brief tell the styleEngine that a new html element has started.
  */
@@ -148,6 +342,7 @@ void StyleEngine::startElement (int element, BrowserWindow *bw) {
    DoctreeNode *dn = doctree->push ();
 
    dn->element = element;
+   doctree->filterAdd (Doctree::elementHash (element));
    n->doctreeNode = dn;
    if (stack->size () > 1)
       n->displayNone = stack->getRef (stack->size () - 2)->displayNone;
@@ -160,13 +355,15 @@ void StyleEngine::startElement (const char *tagname, BrowserWindow *bw) {
 void StyleEngine::setId (const char *id) {
    DoctreeNode *dn = doctree->top ();
    assert (dn->id == NULL);
-   dn->id = dStrdup (id);
+   dn->id = doctree->getZone ()->strdup (id);
+   doctree->filterAdd (Doctree::stringHash (dn->id));
 }
 
 /**
  * \brief split a string at sep chars and return a SimpleVector of strings
  */
-static lout::misc::SimpleVector<char *> *splitStr (const char *str, char sep) {
+static lout::misc::SimpleVector<char *> *splitStr (const char *str, char sep,
+                                                   ZoneAllocator *zone) {
    const char *p1 = NULL;
    lout::misc::SimpleVector<char *> *list =
       new lout::misc::SimpleVector<char *> (1);
@@ -177,7 +374,7 @@ static lout::misc::SimpleVector<char *> *splitStr (const char *str, char sep) {
             p1 = str;
       } else if (p1) {
          list->increase ();
-         list->set (list->size () - 1, dStrndup (p1, str - p1));
+         list->set (list->size () - 1, (char *) zone->strndup (p1, str - p1));
          p1 = NULL;
       }
 
@@ -191,20 +388,35 @@ static lout::misc::SimpleVector<char *> *splitStr (const char *str, char sep) {
 void StyleEngine::setClass (const char *klass) {
    DoctreeNode *dn = doctree->top ();
    assert (dn->klass == NULL);
-   dn->klass = splitStr (klass, ' ');
+   dn->klass = splitStr (klass, ' ', doctree->getZone ());
+   for (int i = 0; i < dn->klass->size (); i++)
+      doctree->filterAdd (Doctree::stringHash (dn->klass->get (i)));
 }
 
 void StyleEngine::setStyle (const char *styleAttr) {
    Node *n = stack->getRef (stack->size () - 1);
    assert (n->styleAttrProperties == NULL);
    // parse style information from style="" attribute, if it exists
+   // Identical attributes are parsed only once per document.
    if (styleAttr && prefs.parse_embedded_css) {
-      n->styleAttrProperties = new CssPropertyList (true);
-      n->styleAttrPropertiesImportant = new CssPropertyList (true);
+      lout::object::ConstString key (styleAttr);
+      InlineStyle *inlineStyle = inlineStyles->get (&key);
+
+      if (inlineStyle == NULL) {
+         inlineStyle = new InlineStyle (new CssPropertyList (true),
+                                        new CssPropertyList (true));
+         CssParser::parseDeclarationBlock (baseUrl, styleAttr,
+                                           strlen (styleAttr),
+                                           inlineStyle->props,
+                                           inlineStyle->propsImportant);
+         inlineStyles->put (new lout::object::String (styleAttr),
+                            inlineStyle);
+      }
 
-      CssParser::parseDeclarationBlock (baseUrl, styleAttr, strlen (styleAttr),
-                                        n->styleAttrProperties,
-                                        n->styleAttrPropertiesImportant);
+      n->styleAttrProperties = inlineStyle->props;
+      n->styleAttrProperties->ref ();
+      n->styleAttrPropertiesImportant = inlineStyle->propsImportant;
+      n->styleAttrPropertiesImportant->ref ();
    }
 }
 
@@ -293,6 +505,40 @@ void StyleEngine::setPseudoVisited () {
    dn->pseudo = "visited";
 }
 
+/**
+ * \brief Compute the color of a link in the other state, e.g. after it
+ * was visited.
+ *
+ * Only the node of the link is matched again, with its pseudo class
+ * switched, as that is all the rules can tell apart. The elements inside
+ * the link inherit the color from it. A style attribute is not known
+ * anymore at this point and thereby not taken into account.
+ * Returns -1 if nothing sets a color.
+ */
+int32_t StyleEngine::linkColor (DoctreeNode *dn, bool visited,
+                                int32_t nonCssColor) {
+   CssPropertyList props, nonCssProperties;
+   const char *pseudo = dn->pseudo;
+   int32_t color = -1;
+
+   if (nonCssColor != -1) {
+      CssPropertyValue v;
+      v.intVal = nonCssColor;
+      nonCssProperties.set (CSS_PROPERTY_COLOR, CSS_TYPE_COLOR, v);
+   }
+
+   dn->pseudo = visited ? "visited" : "link";
+   cssContext->reapply (&props, doctree, dn, &nonCssProperties);
+   dn->pseudo = pseudo;
+
+   for (int i = 0; i < props.size (); i++)
+      if (props.getRef (i)->name == CSS_PROPERTY_COLOR &&
+          props.getRef (i)->type == CSS_TYPE_COLOR)
+         color = props.getRef (i)->value.intVal;
+
+   return color;
+}
+
 /**
  * \brief tell the styleEngine that a html element has ended.
  */
@@ -918,9 +1164,10 @@ Style * StyleEngine::backgroundStyle (BrowserWindow *bw) {
  */
 Style * StyleEngine::style0 (int i, BrowserWindow *bw) {
    CssPropertyList props, *styleAttrProperties, *styleAttrPropertiesImportant;
-   CssPropertyList *nonCssProperties;
-   // get previous style from the stack
-   StyleAttrs attrs = *stack->getRef (i - 1)->style;
+   CssPropertyList *nonCssProperties, *computedFrom;
+   StyleAttrs attrs;
+   unsigned hash;
+   bool displayNone;
 
    // Ensure that StyleEngine::style0() has not been called before for
    // this element.
@@ -930,9 +1177,8 @@ Style * StyleEngine::style0 (int i, BrowserWindow *bw) {
    // style() or wordStyle() for each new element.
    assert (stack->getRef (i)->style == NULL);
 
-   // reset values that are not inherited according to CSS
-   attrs.resetValues ();
-   preprocessAttrs (&attrs);
+   if (shareSiblingStyle (i))
+      return stack->getRef (i)->style;
 
    styleAttrProperties = stack->getRef (i)->styleAttrProperties;
    styleAttrPropertiesImportant = stack->getRef(i)->styleAttrPropertiesImportant;
@@ -942,6 +1188,23 @@ Style * StyleEngine::style0 (int i, BrowserWindow *bw) {
    cssContext->apply (&props, doctree, stack->getRef(i)->doctreeNode,
                       styleAttrProperties, styleAttrPropertiesImportant,
                       nonCssProperties);
+   stack->getRef (i)->ruleCount = cssContext->getRuleCount ();
+
+   hash = props.hashValue ();
+   if (lookupComputedStyle (i, &props, hash))
+      return stack->getRef (i)->style;
+   computedStyles++;
+
+   // apply () may modify the strings, so keep a copy from before
+   computedFrom = new CssPropertyList (props, true);
+   displayNone = stack->getRef (i)->displayNone;
+
+   // get previous style from the stack
+   attrs = *stack->getRef (i - 1)->style;
+
+   // reset values that are not inherited according to CSS
+   attrs.resetValues ();
+   preprocessAttrs (&attrs);
 
    // apply style
    apply (i, &attrs, &props, bw);
@@ -949,6 +1212,7 @@ Style * StyleEngine::style0 (int i, BrowserWindow *bw) {
    postprocessAttrs (&attrs);
 
    stack->getRef (i)->style = Style::create (&attrs);
+   storeComputedStyle (i, computedFrom, hash, displayNone);
 
    return stack->getRef (i)->style;
 }
@@ -980,6 +1244,9 @@ Style * StyleEngine::wordStyle0 (BrowserWindow *bw) {
  * Note that restyle() does not change any styles in the widget tree.
  */
 void StyleEngine::restyle (BrowserWindow *bw) {
+   for (int i = 0; i < stack->size (); i++)
+      clearSiblingStyle (&stack->getRef (i)->lastChild);
+
    for (int i = 1; i < stack->size (); i++) {
       Node *n = stack->getRef (i);
       if (n->style) {
@@ -999,92 +1266,243 @@ void StyleEngine::restyle (BrowserWindow *bw) {
    }
 }
 
-void StyleEngine::parse (DilloHtml *html, DilloUrl *url, const char *buf,
-                         int buflen, CssOrigin origin) {
+/* ----------------------------------------------------------------------
+ *    Parsed stylesheets, shared by all documents
+ * ---------------------------------------------------------------------- */
+
+#define STYLE_SHEET_CACHE_SIZE 32
+
+typedef struct {
+   DilloUrl *url;
+   uint_t serial;       /* of the cache entry it was parsed from */
+   CssRuleSet *ruleSet;
+} StyleSheetCacheEntry;
+
+static lout::misc::SimpleVector <StyleSheetCacheEntry> styleSheetCache (4);
+
+/**
+ * \brief Find the rules of an external stylesheet, if it was parsed from
+ * the same cache entry before.
+ */
+static CssRuleSet *styleSheetCacheGet (const DilloUrl *url, uint_t serial) {
+   for (int i = styleSheetCache.size () - 1; i >= 0; i--) {
+      StyleSheetCacheEntry e = styleSheetCache.get (i);
+
+      if (a_Url_cmp (e.url, url) == 0) {
+         if (e.serial != serial)
+            return NULL;
+         /* move it to the end, so that the oldest go first */
+         for ( ; i < styleSheetCache.size () - 1; i++)
+            styleSheetCache.set (i, styleSheetCache.get (i + 1));
+         styleSheetCache.set (i, e);
+         return e.ruleSet;
+      }
+   }
+   return NULL;
+}
+
+static void styleSheetCacheRemove (int i) {
+   StyleSheetCacheEntry *e = styleSheetCache.getRef (i);
+
+   a_Url_free (e->url);
+   e->ruleSet->unref ();
+   for ( ; i < styleSheetCache.size () - 1; i++)
+      styleSheetCache.set (i, styleSheetCache.get (i + 1));
+   styleSheetCache.setSize (styleSheetCache.size () - 1);
+}
+
+static void styleSheetCachePut (const DilloUrl *url, uint_t serial,
+                                CssRuleSet *ruleSet) {
+   StyleSheetCacheEntry *e;
+
+   for (int i = 0; i < styleSheetCache.size (); i++)
+      if (a_Url_cmp (styleSheetCache.get (i).url, url) == 0) {
+         styleSheetCacheRemove (i);
+         break;
+      }
+   if (styleSheetCache.size () >= STYLE_SHEET_CACHE_SIZE)
+      styleSheetCacheRemove (0);
+
+   styleSheetCache.increase ();
+   e = styleSheetCache.getLastRef ();
+   e->url = a_Url_dup (url);
+   e->serial = serial;
+   e->ruleSet = ruleSet;
+   ruleSet->ref ();
+}
+
+/**
+ * \brief Load the stylesheets a rule set imports, and then add its rules.
+ */
+void StyleEngine::addRuleSet (DilloHtml *html, CssRuleSet *ruleSet) {
    if (importDepth > 10) { // avoid looping with recursive @import directives
       MSG_WARN("Maximum depth of CSS @import reached--ignoring stylesheet.\n");
       return;
    }
 
    importDepth++;
-   CssParser::parse (html, url, cssContext, buf, buflen, origin);
+   ruleSet->ref (); // loading the imports may drop it from the cache
+   for (int i = 0; i < ruleSet->numImports (); i++)
+      a_Html_load_stylesheet (html, ruleSet->getImport (i));
+   ruleSet->addTo (cssContext);
+   ruleSet->unref ();
    importDepth--;
 }
 
+void StyleEngine::parse (DilloHtml *html, DilloUrl *url, const char *buf,
+                         int buflen, CssOrigin origin) {
+   CssRuleSet *ruleSet = new CssRuleSet ();
+
+   ruleSet->ref ();
+   CssParser::parse (html, url, ruleSet, buf, buflen, origin);
+   addRuleSet (html, ruleSet);
+   ruleSet->unref ();
+}
+
+/**
+ * \brief Parse an external stylesheet from the cache, and keep the result
+ * for the next documents that use it.
+ */
+void StyleEngine::parseStyleSheet (DilloHtml *html, const DilloUrl *url,
+                                   const char *buf, int buflen) {
+   CssRuleSet *ruleSet = new CssRuleSet ();
+
+   ruleSet->ref ();
+   CssParser::parse (html, url, ruleSet, buf, buflen, CSS_ORIGIN_AUTHOR);
+   styleSheetCachePut (url, a_Capi_get_serial (url), ruleSet);
+   addRuleSet (html, ruleSet);
+   ruleSet->unref ();
+}
+
+/**
+ * \brief Add an external stylesheet without parsing it, if its current
+ * cache entry was parsed before.
+ */
+bool StyleEngine::addCachedStyleSheet (DilloHtml *html, const DilloUrl *url) {
+   CssRuleSet *ruleSet = styleSheetCacheGet (url, a_Capi_get_serial (url));
+
+   if (ruleSet)
+      addRuleSet (html, ruleSet);
+   return ruleSet != NULL;
+}
+
 /**
  * \brief Create the user agent style.
  *
  * The user agent style defines how dillo renders HTML in the absence of
- * author or user styles.
+ * author or user styles. Its rules are parsed from uastyle.css at build
+ * time, see uarules.cc.
  */
 void StyleEngine::init () {
-   const char *cssBuf =
-      "body  {margin: 5px}"
-      "big {font-size: 1.17em}"
-      "blockquote, dd {margin-left: 40px; margin-right: 40px}"
-      "center {text-align: center}"
-      "dt {font-weight: bolder}"
-      ":link {color: blue; text-decoration: underline; cursor: pointer}"
-      ":visited {color: #800080; text-decoration: underline; cursor: pointer}"
-      "h1, h2, h3, h4, h5, h6, b, strong {font-weight: bolder}"
-      "address, article, aside, center, div, figure, figcaption, footer,"
-      " h1, h2, h3, h4, h5, h6, header, main, nav, ol, p, pre, section, ul"
-      " {display: block}"
-      "i, em, cite, address, var {font-style: italic}"
-      "frameset, ul, ol, dir {margin-left: 40px}"
-      /* WORKAROUND: It should be margin: 1em 0
-       * but as we don't collapse these margins yet, it
-       * look better like this.
-       */
-      "p {margin: 0.5em 0}"
-      "figure {margin: 1em 40px}"
-      "h1 {font-size: 2em; margin-top: .67em; margin-bottom: 0}"
-      "h2 {font-size: 1.5em; margin-top: .75em; margin-bottom: 0}"
-      "h3 {font-size: 1.17em; margin-top: .83em; margin-bottom: 0}"
-      "h4 {margin-top: 1.12em; margin-bottom: 0}"
-      "h5 {font-size: 0.83em; margin-top: 1.5em; margin-bottom: 0}"
-      "h6 {font-size: 0.75em; margin-top: 1.67em; margin-bottom: 0}"
-      "hr {width: 100%; border: 1px inset}"
-      "li {margin-top: 0.1em; display: list-item}"
-      "pre {white-space: pre}"
-      "ol {list-style-type: decimal}"
-      "ul {list-style-type: disc}"
-      "ul ul {list-style-type: circle}"
-      "ul ul ul {list-style-type: square}"
-      "ul ul ul ul {list-style-type: disc}"
-      "ins, u {text-decoration: underline}"
-      "small, sub, sup {font-size: 0.83em}"
-      "sub {vertical-align: sub}"
-      "sup {vertical-align: super}"
-      "s, strike, del {text-decoration: line-through}"
-      /* HTML5 spec notes that mark styling "is just a suggestion and can be
-       * changed based on implementation feedback"
-       */
-      "mark {background: yellow; color: black;}"
-      "table {border-spacing: 2px}"
-      "td, th {padding: 2px}"
-      "thead, tbody, tfoot {vertical-align: middle}"
-      "th {font-weight: bolder; text-align: center}"
-      "code, tt, pre, samp, kbd {font-family: monospace}"
-      /* WORKAROUND: Reset font properties in tables as some
-       * pages rely on it (e.g. gmail).
-       * http://developer.mozilla.org/en-US/Fixing_Table_Inheritance_in_Quirks_Mode
-       * has a detailed description of the issue.
-       */
-      "table, caption {font-size: medium; font-weight: normal}";
-
    CssContext context;
-   CssParser::parse (NULL, NULL, &context, cssBuf, strlen (cssBuf),
-                     CSS_ORIGIN_USER_AGENT);
+   CssRuleSet *ruleSet = new CssRuleSet ();
+   ruleSet->ref (); // never released, the user agent rules are static
+   if (!ruleSet->load ((const char *) Css_ua_rules, sizeof (Css_ua_rules)))
+      MSG_ERR("StyleEngine: can't load the built-in user agent rules\n");
+   ruleSet->addTo (&context);
+}
+
+/**
+ * \brief Load the rules of the user stylesheet from its cache file.
+ *
+ * The cache starts with the modification time and size of the stylesheet
+ * it was made from, which must be those in 'st'.
+ */
+static CssRuleSet *userStyleCacheLoad (const char *cacheFile,
+                                       const struct stat *st) {
+   Dstr *data = a_Misc_file2dstr (cacheFile);
+   CssRuleSet *ruleSet = NULL;
+   long long mtime, size;
+   int n;
+
+   if (data &&
+       sscanf (data->str, "dillo style.css %lld %lld\n%n",
+               &mtime, &size, &n) == 2 &&
+       mtime == (long long) st->st_mtime && size == (long long) st->st_size) {
+      ruleSet = new CssRuleSet ();
+      ruleSet->ref ();
+      if (!ruleSet->load (data->str + n, data->len - n)) {
+         MSG("StyleEngine: ignoring the broken cache %s\n", cacheFile);
+         ruleSet->unref ();
+         ruleSet = NULL;
+      }
+   }
+   if (data)
+      dStr_free (data, 1);
+   return ruleSet;
+}
+
+/**
+ * \brief Save the rules of the user stylesheet in its cache file.
+ */
+static void userStyleCacheSave (const char *cacheFile, const struct stat *st,
+                                CssRuleSet *ruleSet) {
+   Dstr *data = dStr_sized_new (4096);
+   char *tmpFile = dStrconcat (cacheFile, ".tmp", NULL);
+   FILE *f;
+   bool ok = false;
+
+   dStr_sprintf (data, "dillo style.css %lld %lld\n",
+                 (long long) st->st_mtime, (long long) st->st_size);
+   ruleSet->save (data);
+
+   /* write a new file and rename it, so that no one reads half of it */
+   if ((f = fopen (tmpFile, "w"))) {
+      ok = fwrite (data->str, 1, data->len, f) == (size_t) data->len;
+      ok = (fclose (f) == 0) && ok && rename (tmpFile, cacheFile) == 0;
+      if (!ok)
+         unlink (tmpFile);
+   }
+   if (!ok)
+      MSG("StyleEngine: can't write %s\n", cacheFile);
+   dFree (tmpFile);
+   dStr_free (data, 1);
 }
 
+/**
+ * \brief Add the rules of ~/.dillo/style.css.
+ *
+ * The file is parsed once, and the rules are shared by all documents
+ * until its modification time or size changes. The parsed rules are also
+ * saved in ~/.dillo/style.css.cache, so that the next dillo can load them
+ * without parsing, as long as the stylesheet stays the same.
+ */
 void StyleEngine::buildUserStyle () {
+   static CssRuleSet *userRuleSet = NULL;
+   static time_t userMtime;
+   static off_t userSize;
+   struct stat st;
    Dstr *style;
    char *filename = dStrconcat(dGethomedir(), "/.dillo/style.css", NULL);
+   char *cacheFile = dStrconcat(filename, ".cache", NULL);
 
-   if ((style = a_Misc_file2dstr(filename))) {
-      CssParser::parse (NULL,NULL,cssContext,style->str, style->len,CSS_ORIGIN_USER);
-      dStr_free (style, 1);
+   if (stat (filename, &st) != 0) {
+      if (userRuleSet) {
+         userRuleSet->unref ();
+         userRuleSet = NULL;
+      }
+   } else if (!userRuleSet ||
+              st.st_mtime != userMtime || st.st_size != userSize) {
+      if (userRuleSet)
+         userRuleSet->unref ();
+      userMtime = st.st_mtime;
+      userSize = st.st_size;
+
+      if (!(userRuleSet = userStyleCacheLoad (cacheFile, &st))) {
+         userRuleSet = new CssRuleSet ();
+         userRuleSet->ref ();
+
+         if ((style = a_Misc_file2dstr(filename))) {
+            CssParser::parse (NULL, NULL, userRuleSet, style->str,
+                              style->len, CSS_ORIGIN_USER);
+            dStr_free (style, 1);
+            userStyleCacheSave (cacheFile, &st, userRuleSet);
+         }
+      }
    }
+   dFree (cacheFile);
    dFree (filename);
+
+   if (userRuleSet)
+      userRuleSet->addTo (cssContext);
 }
@@ -31,6 +31,61 @@ class StyleEngine;
  */
 class StyleEngine {
    private:
+      /**
+       * The last child element that was closed, so that its next sibling
+       * can take over its style instead of running the cascade again.
+       */
+      struct SiblingStyle {
+         DoctreeNode *doctreeNode;
+         dw::core::style::Style *style;
+         CssPropertyList *styleAttrProperties;
+         CssPropertyList *styleAttrPropertiesImportant;
+         CssPropertyList *nonCssProperties;
+         int ruleCount;       /**< CssContext::getRuleCount () back then */
+         bool parentInheritBackgroundColor;
+         bool displayNone;
+      };
+
+      /**
+       * The parsed style="" attributes of the document, shared by all
+       * elements with the same attribute string.
+       */
+      class InlineStyle : public lout::object::Object {
+         public:
+            CssPropertyList *props, *propsImportant;
+
+            InlineStyle (CssPropertyList *props,
+                         CssPropertyList *propsImportant) {
+               this->props = props;
+               this->propsImportant = propsImportant;
+               props->ref ();
+               propsImportant->ref ();
+            };
+            ~InlineStyle () {
+               props->unref ();
+               propsImportant->unref ();
+            };
+      };
+
+      /**
+       * A computed style, together with what it was computed from: the
+       * style of the parent and the declarations that the cascade
+       * resulted in (see style0 ()).
+       */
+      struct ComputedStyle {
+         unsigned hash;       /**< of props */
+         CssPropertyList *props;
+         dw::core::style::Style *parentStyle;
+         bool parentInheritBackgroundColor;
+         bool displayNone;    /**< inherited, before the style is applied */
+         bool resultDisplayNone;
+         dw::core::style::Style *style;
+      };
+
+      /* The computed styles are kept in sets of computedStyleWays entries,
+       * the most recently used first. */
+      enum { computedStyleSets = 128, computedStyleWays = 4 };
+
       struct Node {
          CssPropertyList *styleAttrProperties;
          CssPropertyList *styleAttrPropertiesImportant;
@@ -41,20 +96,34 @@ class StyleEngine {
          bool inheritBackgroundColor;
          bool displayNone;
          DoctreeNode *doctreeNode;
+         int ruleCount;       /**< CssContext::getRuleCount () for style */
+         SiblingStyle lastChild;
       };
 
       dw::core::Layout *layout;
       lout::misc::SimpleVector <Node> *stack;
       CssContext *cssContext;
+      lout::container::typed::HashTable
+         <lout::object::ConstString, InlineStyle> *inlineStyles;
       Doctree *doctree;
+      lout::misc::ZoneAllocator *ownZone; /**< when no zone was given */
+      ComputedStyle computedStyleCache[computedStyleSets * computedStyleWays];
       int importDepth;
+      int sharedStyles, memoizedStyles, computedStyles; /* statistics */
       float dpmm;
       float zoom;
       DilloUrl *pageUrl, *baseUrl;
 
       void stackPush ();
       void stackPop ();
+      void clearSiblingStyle (SiblingStyle *s);
+      bool shareSiblingStyle (int i);
+      bool lookupComputedStyle (int i, CssPropertyList *props, unsigned hash);
+      void storeComputedStyle (int i, CssPropertyList *props, unsigned hash,
+                               bool displayNone);
+      void clearComputedStyles ();
       void buildUserStyle ();
+      void addRuleSet (DilloHtml *html, CssRuleSet *ruleSet);
       dw::core::style::Style *style0 (int i, BrowserWindow *bw);
       dw::core::style::Style *wordStyle0 (BrowserWindow *bw);
       inline void setNonCssHint(CssPropertyName name, CssValueType type,
@@ -82,20 +151,26 @@ class StyleEngine {
       static void init ();
 
       StyleEngine (dw::core::Layout *layout,
-                   const DilloUrl *pageUrl, const DilloUrl *baseUrl, float zoom);
+                   const DilloUrl *pageUrl, const DilloUrl *baseUrl, float zoom,
+                   lout::misc::ZoneAllocator *zone = NULL);
       ~StyleEngine ();
 
       void parse (DilloHtml *html, DilloUrl *url, const char *buf, int buflen,
                   CssOrigin origin);
+      void parseStyleSheet (DilloHtml *html, const DilloUrl *url,
+                            const char *buf, int buflen);
+      bool addCachedStyleSheet (DilloHtml *html, const DilloUrl *url);
       void startElement (int tag, BrowserWindow *bw);
       void startElement (const char *tagname, BrowserWindow *bw);
       void setId (const char *id);
       const char * getId () { return doctree->top ()->id; };
+      DoctreeNode *getDoctreeNode () { return doctree->top (); };
       void setClass (const char *klass);
       void setStyle (const char *style);
       void endElement (int tag);
       void setPseudoLink ();
       void setPseudoVisited ();
+      int32_t linkColor (DoctreeNode *dn, bool visited, int32_t nonCssColor);
       inline void setNonCssHint(CssPropertyName name, CssValueType type,
                                 int value) {
          CssPropertyValue v;
@@ -119,6 +194,11 @@ class StyleEngine {
       void restyle (BrowserWindow *bw);
       void inheritBackgroundColor (); /* \todo get rid of this somehow */
       dw::core::style::Style *backgroundStyle (BrowserWindow *bw);
+      inline void getStatistics (int *shared, int *memoized, int *computed) {
+         *shared = sharedStyles;
+         *memoized = memoizedStyles;
+         *computed = computedStyles;
+      };
       dw::core::style::Color *backgroundColor ();
       dw::core::style::StyleImage *backgroundImage
          (dw::core::style::BackgroundRepeat *bgRepeat,
@@ -0,0 +1,106 @@
+/*
+ * File: uarules.cc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Build the user agent rules into dillo: parse uastyle.css and write the
+ * rule set, as saved by CssRuleSet::save (), as a C table that
+ * StyleEngine::init () loads without parsing CSS at run time.
+ *
+ * Usage: uarules uastyle.css > uarules.h
+ *
+ * This program runs at build time, without the HTML parser. Element names
+ * get indexes of their own here, which is enough as the saved rules refer
+ * to elements by name.
+ */
+
+#include <stdio.h>
+
+#include "../dlib/dlib.h"
+#include "html_common.hh"
+#include "hsts.h"
+#include "css.hh"
+#include "cssparser.hh"
+
+static lout::misc::SimpleVector <char *> tagNames (16);
+
+int a_Html_tag_index (const char *tag)
+{
+   for (int i = 0; i < tagNames.size (); i++)
+      if (dStrAsciiCasecmp (tag, tagNames.get (i)) == 0)
+         return i;
+   tagNames.increase ();
+   tagNames.set (tagNames.size () - 1, dStrdup (tag));
+   return tagNames.size () - 1;
+}
+
+const char *a_Html_tag_name (int idx)
+{
+   return (idx >= 0 && idx < tagNames.size ()) ? tagNames.get (idx) : NULL;
+}
+
+/* The user agent stylesheet has no @import, so these are never called */
+DilloUrl *a_Html_url_new (DilloHtml *html, const char *url_str,
+                          const char *base_url, int use_base_url)
+{
+   return NULL;
+}
+
+void a_Html_load_stylesheet (DilloHtml *html, DilloUrl *url)
+{
+}
+
+bool_t a_Hsts_require_https (const char *host)
+{
+   return FALSE;
+}
+
+int main (int argc, char **argv)
+{
+   FILE *f;
+   Dstr *css, *saved;
+   CssRuleSet *ruleSet;
+   char buf[4096];
+   size_t n;
+
+   if (argc != 2) {
+      fprintf (stderr, "usage: uarules uastyle.css > uarules.h\n");
+      return 2;
+   }
+   if (!(f = fopen (argv[1], "r"))) {
+      perror (argv[1]);
+      return 1;
+   }
+   css = dStr_new ("");
+   while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+      dStr_append_l (css, buf, n);
+   fclose (f);
+
+   ruleSet = new CssRuleSet ();
+   ruleSet->ref ();
+   CssParser::parse (NULL, NULL, ruleSet, css->str, css->len,
+                     CSS_ORIGIN_USER_AGENT);
+   if (ruleSet->numRules () == 0) {
+      fprintf (stderr, "uarules: no rules in %s\n", argv[1]);
+      return 1;
+   }
+   saved = dStr_new ("");
+   ruleSet->save (saved);
+
+   printf ("/* Generated from uastyle.css by uarules, %d rules */\n\n"
+           "static const unsigned char Css_ua_rules[%d] = {",
+           ruleSet->numRules (), saved->len);
+   for (int i = 0; i < saved->len; i++)
+      printf ("%s%d,", i % 16 ? " " : "\n", (unsigned char) saved->str[i]);
+   printf ("\n};\n");
+
+   ruleSet->unref ();
+   dStr_free (saved, 1);
+   dStr_free (css, 1);
+   return ferror (stdout) ? 1 : 0;
+}
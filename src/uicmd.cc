@@ -1327,7 +1327,8 @@ void a_UIcmd_view_page_source(BrowserWindow *bw, const DilloUrl *url)
    if (major && dStrAsciiCasecmp(major, "image") &&
        a_Nav_get_buf(url, &buf, &buf_size)) {
       a_Nav_set_vsource_url(url);
-      dstr_url = dStr_new("dpi:/vsource/:");
+      dstr_url = dStr_new(prefs.view_source_plain ?
+                          "dpi:/vsource/plain:" : "dpi:/vsource/:");
       dStr_append(dstr_url, URL_STR(url));
       if (URL_FLAGS(url) & URL_Post) {
          /* append a custom string to differentiate POST URLs */
@@ -27,8 +27,9 @@ fi
 function render_page() {
   htmlfile="$1"
   outpic="$2"
+  homedir="${3:-$HOME}"
 
-  "$DILLOBIN" -f "$htmlfile" &
+  HOME="$homedir" "$DILLOBIN" -f "$htmlfile" &
   dillopid=$!
 
   # TODO: We need a better system to determine when the page loaded
@@ -78,7 +79,17 @@ function test_file() {
   read dispnum < "$wdir/display.fifo"
   export DISPLAY=":$dispnum"
 
-  render_page "$html_file" "$wdir/html.png"
+  # A test may come with a dillorc for its page, the reference is
+  # rendered with the defaults
+  rc_file="${html_file%.html}.dillorc"
+  html_home="$HOME"
+  if [ -e "$rc_file" ]; then
+    html_home="$PWD/$wdir/home"
+    mkdir -p "$html_home/.dillo"
+    cp "$rc_file" "$html_home/.dillo/dillorc"
+  fi
+
+  render_page "$html_file" "$wdir/html.png" "$html_home"
   render_page "$ref_file" "$wdir/ref.png"
 
   # AE = Absolute Error count of the number of different pixels
@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+# Writes a table with 10000 alike rows to stdout, a benchmark page for the
+# style engine: most of the row and cell styles should come from the
+# sibling cache or the memoized computed styles.
+#
+# Usage: table-10k-rows.sh [rows] > table-10k-rows.html
+
+rows=${1:-10000}
+
+cat <<END
+<!DOCTYPE html>
+<html>
+<head>
+<title>Table with $rows rows</title>
+<style>
+table { border-collapse: collapse }
+td { padding: 0 4px; border: 1px solid #ccc }
+tr.a td { background: #eef }
+</style>
+</head>
+<body>
+<table>
+END
+
+awk -v rows="$rows" 'BEGIN {
+   for (i = 1; i <= rows; i++)
+      printf "<tr class=%s><td>%d<td>x<td>y\n", (i % 2) ? "b" : "a", i
+}'
+
+cat <<END
+</table>
+</body>
+</html>
+END
@@ -0,0 +1,232 @@
+/*
+ * Dillo CSS ancestor filter benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for the ancestor Bloom filter of the Doctree. A sheet with
+ * thousands of descendant rules, most of them bucketed under a few common
+ * right-most classes and elements (".theme-7 .nav-link", ".page-12 .card
+ * p"), is matched against every node of a generated page, with the filter
+ * and without it. The nodes are pushed, given their ids and classes, and
+ * popped the way StyleEngine does it. It prints how many selectors the
+ * filter rejected and how many still had to be walked, and the match time
+ * both ways, and checks that the computed properties are the same.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/css.hh"
+#include "src/cssparser.hh"
+#include "src/doctree.hh"
+
+#define NUM_THEMES 400
+#define NUM_CARDS 60
+#define NUM_ROUNDS 20
+
+extern int a_Html_tag_index (const char *tag);
+
+/*
+ * Rules that the page never matches, because it lacks their ancestor
+ * classes and ids, sharing right-most selectors with those it does match.
+ */
+static Dstr *gen_sheet ()
+{
+   Dstr *s = dStr_new ("");
+
+   for (int i = 0; i < NUM_THEMES; i++)
+      dStr_sprintfa (s,
+         ".theme-%d .nav-link{color:#%06x}\n"
+         ".theme-%d .navbar .nav-item .nav-link:hover{color:#fff}\n"
+         ".page-%d .card p{margin-bottom:%dpx}\n"
+         ".page-%d .card-body > p a{text-decoration:none}\n"
+         "#widget-%d a{color:#%06x}\n"
+         ".modal-%d .table td{padding:%dpx}\n"
+         "body.layout-%d .sidebar li{list-style-type:none}\n"
+         "article.post-%d p em{font-style:normal}\n",
+         i, i * 0x10101 & 0xffffff, i, i, i % 20, i, i, i * 0x30507 & 0xffffff,
+         i, i % 9, i, i);
+   /* ... and the ones it does */
+   dStr_append (s,
+      ".navbar .nav .nav-link{color:#0d6efd}\n"
+      ".card .card-body p{line-height:1.5}\n"
+      "#sidebar .menu a{color:#6c757d}\n"
+      ".table td{padding:4px}\n"
+      "main section.card h2{font-size:20px}\n"
+      "footer p{color:#999}\n");
+   return s;
+}
+
+static void push (Doctree *dt, const char *tag, const char *id,
+                  const char *klass)
+{
+   DoctreeNode *dn = dt->push ();
+
+   dn->element = a_Html_tag_index (tag);
+   dt->filterAdd (Doctree::elementHash (dn->element));
+   if (id) {
+      dn->id = dt->getZone ()->strdup (id);
+      dt->filterAdd (Doctree::stringHash (dn->id));
+   }
+   if (klass) {
+      dn->klass = new lout::misc::SimpleVector <char *> (1);
+      for (const char *p = klass, *q; *p; p = q + !!*q) {
+         q = strchr (p, ' ');
+         if (!q)
+            q = p + strlen (p);
+         dn->klass->increase ();
+         dn->klass->set (dn->klass->size () - 1,
+                         (char *) dt->getZone ()->strndup (p, q - p));
+      }
+      for (int i = 0; i < dn->klass->size (); i++)
+         dt->filterAdd (Doctree::stringHash (dn->klass->get (i)));
+   }
+}
+
+static unsigned long apply (CssContext *context, Doctree *dt)
+{
+   CssPropertyList props (true);
+
+   context->apply (&props, dt, dt->top (), NULL, NULL, NULL);
+   return props.hashValue () + props.size ();
+}
+
+/*
+ * Open an element, match it, and close it again if 'empty'. Return a
+ * checksum of the properties.
+ */
+static unsigned long elem (CssContext *context, Doctree *dt, const char *tag,
+                           const char *id, const char *klass, bool empty)
+{
+   unsigned long sum;
+
+   push (dt, tag, id, klass);
+   sum = apply (context, dt);
+   if (empty)
+      dt->pop ();
+   return sum;
+}
+
+/*
+ * A page in the style of a framework's: a navigation bar, cards with
+ * paragraphs and tables, a sidebar menu and a footer.
+ */
+static unsigned long page (CssContext *context, Doctree *dt)
+{
+   unsigned long sum = 0;
+
+   sum += elem (context, dt, "html", NULL, NULL, false);
+   sum += elem (context, dt, "body", NULL, "layout-main", false);
+   sum += elem (context, dt, "div", "page", "container", false);
+   sum += elem (context, dt, "header", NULL, "navbar", false);
+   sum += elem (context, dt, "ul", NULL, "nav", false);
+   for (int i = 0; i < 8; i++) {
+      sum += elem (context, dt, "li", NULL, "nav-item", false);
+      sum += elem (context, dt, "a", NULL, "nav-link", true);
+      dt->pop ();
+   }
+   dt->pop ();
+   dt->pop ();
+   sum += elem (context, dt, "main", NULL, "content", false);
+   for (int c = 0; c < NUM_CARDS; c++) {
+      sum += elem (context, dt, "section", NULL, "card", false);
+      sum += elem (context, dt, "div", NULL, "card-header", false);
+      sum += elem (context, dt, "h2", NULL, NULL, true);
+      dt->pop ();
+      sum += elem (context, dt, "div", NULL, "card-body", false);
+      for (int p = 0; p < 3; p++) {
+         sum += elem (context, dt, "p", NULL, NULL, false);
+         sum += elem (context, dt, "a", NULL, NULL, true);
+         sum += elem (context, dt, "span", NULL, "badge", true);
+         sum += elem (context, dt, "em", NULL, NULL, true);
+         dt->pop ();
+      }
+      sum += elem (context, dt, "table", NULL, "table", false);
+      sum += elem (context, dt, "tbody", NULL, NULL, false);
+      for (int r = 0; r < 5; r++) {
+         sum += elem (context, dt, "tr", NULL, NULL, false);
+         for (int d = 0; d < 4; d++)
+            sum += elem (context, dt, "td", NULL, NULL, true);
+         dt->pop ();
+      }
+      dt->pop ();
+      dt->pop ();
+      dt->pop ();
+      dt->pop ();
+   }
+   dt->pop ();
+   sum += elem (context, dt, "aside", "sidebar", "sidebar", false);
+   sum += elem (context, dt, "ul", NULL, "menu", false);
+   for (int i = 0; i < 20; i++) {
+      sum += elem (context, dt, "li", NULL, NULL, false);
+      sum += elem (context, dt, "a", NULL, NULL, true);
+      dt->pop ();
+   }
+   dt->pop ();
+   dt->pop ();
+   sum += elem (context, dt, "footer", NULL, "footer", false);
+   sum += elem (context, dt, "p", NULL, NULL, true);
+   dt->pop ();
+   dt->pop ();
+   dt->pop ();
+   dt->pop ();
+   return sum;
+}
+
+static unsigned long run (CssRuleSet *ruleSet, bool filter, double *secs,
+                          int *rejected, int *walked)
+{
+   unsigned long sum = 0;
+   clock_t start = clock ();
+
+   *rejected = *walked = 0;
+   for (int i = 0; i < NUM_ROUNDS; i++) {
+      lout::misc::ZoneAllocator zone (8192);
+      Doctree dt (&zone);
+      CssContext context;
+
+      ruleSet->addTo (&context);
+      dt.filterEnabled = filter;
+      sum += page (&context, &dt);
+      *rejected += dt.filterRejected;
+      *walked += dt.filterWalked;
+   }
+   *secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+   return sum;
+}
+
+int main ()
+{
+   Dstr *sheet = gen_sheet ();
+   CssRuleSet *ruleSet = new CssRuleSet ();
+   unsigned long sum_on, sum_off;
+   double t_on, t_off;
+   int rejected, walked, dummy;
+
+   ruleSet->ref ();
+   CssParser::parse (NULL, NULL, ruleSet, sheet->str, sheet->len,
+                     CSS_ORIGIN_AUTHOR);
+
+   sum_off = run (ruleSet, false, &t_off, &dummy, &dummy);
+   sum_on = run (ruleSet, true, &t_on, &rejected, &walked);
+
+   printf ("%d rules, %d pages\n", ruleSet->numRules (), NUM_ROUNDS);
+   printf ("with the filter:    %.3f s, %d selectors rejected, %d walked\n",
+           t_on, rejected, walked);
+   printf ("without the filter: %.3f s, %d selectors walked\n",
+           t_off, rejected + walked);
+
+   ruleSet->unref ();
+   dStr_free (sheet, 1);
+   if (sum_on != sum_off) {
+      printf ("the filter changed the computed properties\n");
+      return 1;
+   }
+   return rejected > 0 ? 0 : 1;
+}
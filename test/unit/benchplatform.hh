@@ -0,0 +1,165 @@
+/*
+ * Dillo Widget
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __BENCHPLATFORM_HH__
+#define __BENCHPLATFORM_HH__
+
+/*
+ * A platform and a view for the benchmarks that need a dw::core::Layout,
+ * so that no display is needed. Fonts have a fixed width, nothing is
+ * drawn, and the idle functions run when runIdle () is called.
+ */
+
+#include <ctype.h>
+#include <time.h>
+
+#include "dw/core.hh"
+
+#define GLYPH_WIDTH 7
+
+class BenchFont: public dw::core::style::Font
+{
+public:
+   BenchFont (dw::core::style::FontAttrs *attrs)
+   {
+      copyAttrs (attrs);
+      ascent = attrs->size * 4 / 5;
+      descent = attrs->size / 5;
+      spaceWidth = zeroWidth = GLYPH_WIDTH;
+      xHeight = attrs->size / 2;
+   }
+};
+
+class BenchColor: public dw::core::style::Color
+{
+public:
+   BenchColor (int color): Color (color) { }
+};
+
+class BenchPlatform: public dw::core::Platform
+{
+   dw::core::Layout *layout;
+   void (dw::core::Layout::*idleFunc) ();
+   int idleId;
+
+public:
+   double idleSecs;
+
+   BenchPlatform () { layout = NULL; idleFunc = NULL; idleId = 0; }
+
+   /* Run what Layout::queueResize () left for the event loop */
+   void runIdle ()
+   {
+      void (dw::core::Layout::*func) () = idleFunc;
+      clock_t start = clock ();
+
+      if (func) {
+         idleFunc = NULL;
+         (layout->*func) ();
+      }
+      idleSecs += (double) (clock () - start) / CLOCKS_PER_SEC;
+   }
+
+   void setLayout (dw::core::Layout *layout) { this->layout = layout; }
+   void attachView (dw::core::View *view) { }
+   void detachView (dw::core::View *view) { }
+   int textWidth (dw::core::style::Font *font, const char *text, int len)
+   { return len * GLYPH_WIDTH; }
+   char *textToUpper (const char *text, int len)
+   {
+      char *s = dStrndup (text, len);
+      for (int i = 0; i < len; i++)
+         s[i] = toupper (s[i]);
+      return s;
+   }
+   char *textToLower (const char *text, int len)
+   {
+      char *s = dStrndup (text, len);
+      for (int i = 0; i < len; i++)
+         s[i] = tolower (s[i]);
+      return s;
+   }
+   int nextGlyph (const char *text, int idx)
+   { return text[idx] ? idx + 1 : -1; }
+   int prevGlyph (const char *text, int idx) { return idx > 0 ? idx - 1 : -1; }
+   float dpiX () { return 96; }
+   float dpiY () { return 96; }
+   int addIdle (void (dw::core::Layout::*func) ())
+   { idleFunc = func; return ++idleId; }
+   void removeIdle (int idleId) { idleFunc = NULL; }
+   dw::core::style::Font *createFont (dw::core::style::FontAttrs *attrs,
+                                      bool tryEverything)
+   { return new BenchFont (attrs); }
+   bool fontExists (const char *name) { return true; }
+   dw::core::style::Color *createColor (int color)
+   { return new BenchColor (color); }
+   dw::core::style::Tooltip *createTooltip (const char *text) { return NULL; }
+   void cancelTooltip () { }
+   dw::core::Imgbuf *createImgbuf (dw::core::Imgbuf::Type type, int width,
+                                   int height, double gamma)
+   { return NULL; }
+   void copySelection (const char *text) { }
+   dw::core::ui::ResourceFactory *getResourceFactory () { return NULL; }
+};
+
+class BenchView: public dw::core::View
+{
+public:
+   void setLayout (dw::core::Layout *layout) { }
+   void setCanvasSize (int width, int ascent, int descent) { }
+   void setCursor (dw::core::style::Cursor cursor) { }
+   void setBgColor (dw::core::style::Color *color) { }
+   bool usesViewport () { return false; }
+   int getHScrollbarThickness () { return 0; }
+   int getVScrollbarThickness () { return 0; }
+   int getScrollbarOnLeft () { return 0; }
+   void scrollTo (int x, int y) { }
+   void setViewportSize (int width, int height,
+                         int hScrollbarThickness, int vScrollbarThickness) { }
+   void startDrawing (dw::core::Rectangle *area) { }
+   void finishDrawing (dw::core::Rectangle *area) { }
+   void queueDraw (dw::core::Rectangle *area) { }
+   void queueDrawTotal () { }
+   void cancelQueueDraw () { }
+   void drawPoint (dw::core::style::Color *color,
+                   dw::core::style::Color::Shading shading, int x, int y) { }
+   void drawLine (dw::core::style::Color *color,
+                  dw::core::style::Color::Shading shading,
+                  int x1, int y1, int x2, int y2) { }
+   void drawTypedLine (dw::core::style::Color *color,
+                       dw::core::style::Color::Shading shading,
+                       dw::core::style::LineType type,
+                       int width, int x1, int y1, int x2, int y2) { }
+   void drawRectangle (dw::core::style::Color *color,
+                       dw::core::style::Color::Shading shading, bool filled,
+                       int x, int y, int width, int height) { }
+   void drawArc (dw::core::style::Color *color,
+                 dw::core::style::Color::Shading shading, bool filled,
+                 int centerX, int centerY, int width, int height,
+                 int angle1, int angle2) { }
+   void drawPolygon (dw::core::style::Color *color,
+                     dw::core::style::Color::Shading shading,
+                     bool filled, bool convex, dw::core::Point *points,
+                     int npoints) { }
+   void drawText (dw::core::style::Font *font, dw::core::style::Color *color,
+                  dw::core::style::Color::Shading shading,
+                  int x, int y, const char *text, int len) { }
+   void drawSimpleWrappedText (dw::core::style::Font *font,
+                               dw::core::style::Color *color,
+                               dw::core::style::Color::Shading shading,
+                               int x, int y, int w, int h,
+                               const char *text) { }
+   void drawImage (dw::core::Imgbuf *imgbuf, int xRoot, int yRoot,
+                   int x, int y, int width, int height) { }
+   dw::core::View *getClippingView (int x, int y, int width, int height)
+   { return this; }
+   void mergeClippingView (dw::core::View *clippingView) { }
+};
+
+#endif /* __BENCHPLATFORM_HH__ */
@@ -0,0 +1,118 @@
+/*
+ * Dillo charscan test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Compare a_Charscan_find() and a_Charscan_skip() with naive loops, for
+ * every length up to 100 (all the 16- and 32-byte blocks and a tail),
+ * every alignment and a delimiter (or NUL) at every position. Each buffer
+ * is allocated with its exact size, so that memory checkers catch reads
+ * past 'len'.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/charscan.h"
+
+#define MAX_LEN 100
+#define MAX_ALIGN 32
+
+static CharscanSet sets[] = {
+   CHARSCAN_SET("<"),
+   CHARSCAN_SET("<&\r\n"),
+   CHARSCAN_SET(" \t\n\r\f"),
+   CHARSCAN_SET("\x80\xa0\xff"),
+   CHARSCAN_SET("<>&\"'=/ \t\n\r\f"),   /* too many for the vector path */
+};
+#define NUM_SETS (int)(sizeof(sets) / sizeof(sets[0]))
+
+static int failed = 0;
+
+static size_t naive_find(const char *s, size_t len, const char *chars)
+{
+   size_t i;
+
+   for (i = 0; i < len && s[i] && !strchr(chars, s[i]); ++i) ;
+   return i;
+}
+
+static size_t naive_skip(const char *s, size_t len, const char *chars)
+{
+   size_t i;
+
+   for (i = 0; i < len && s[i] && strchr(chars, s[i]); ++i) ;
+   return i;
+}
+
+static void check(const char *s, size_t len, int k, const char *what,
+                  size_t pos)
+{
+   size_t found = a_Charscan_find(s, len, &sets[k]),
+          skipped = a_Charscan_skip(s, len, &sets[k]);
+
+   if (found != naive_find(s, len, sets[k].chars)) {
+      printf("find: set %d, %s at %lu of %lu: got %lu\n", k, what,
+             (unsigned long)pos, (unsigned long)len, (unsigned long)found);
+      failed = 1;
+   }
+   if (skipped != naive_skip(s, len, sets[k].chars)) {
+      printf("skip: set %d, %s at %lu of %lu: got %lu\n", k, what,
+             (unsigned long)pos, (unsigned long)len, (unsigned long)skipped);
+      failed = 1;
+   }
+}
+
+/*
+ * Test a buffer of 'len' bytes at offset 'align' of an allocation that
+ * ends right after it. The buffer is filled with 'fill', with 'mark' at
+ * 'pos' (when pos < len).
+ */
+static void test_buffer(int k, size_t len, size_t align, char fill,
+                        char mark, size_t pos, const char *what)
+{
+   char *mem = malloc(align + len + 1), *s = mem + align;
+
+   memset(s, fill, len);
+   if (pos < len)
+      s[pos] = mark;
+   check(s, len, k, what, pos);
+   free(mem);
+}
+
+int main(void)
+{
+   size_t len, align, pos;
+   int k;
+
+   for (k = 0; k < NUM_SETS; ++k) {
+      const char *chars = sets[k].chars;
+      char outside = 'a', inside = chars[0], last = chars[strlen(chars) - 1];
+
+      for (len = 0; len <= MAX_LEN; ++len) {
+         for (align = 0; align < MAX_ALIGN; ++align) {
+            /* no match at all */
+            test_buffer(k, len, align, outside, outside, len, "none");
+            test_buffer(k, len, align, inside, inside, len, "all");
+            for (pos = 0; pos < len; ++pos) {
+               test_buffer(k, len, align, outside, inside, pos, "first");
+               test_buffer(k, len, align, outside, last, pos, "last");
+               test_buffer(k, len, align, outside, '\0', pos, "NUL");
+               test_buffer(k, len, align, inside, outside, pos, "other");
+               test_buffer(k, len, align, inside, '\0', pos, "NUL in run");
+               test_buffer(k, len, align, inside, '\x81', pos, "0x81");
+            }
+         }
+      }
+   }
+
+   if (!failed)
+      printf("charscan: all checks passed\n");
+   return failed;
+}
@@ -46,6 +46,32 @@ void testHashTable ()
    puts (h.toString());
 }
 
+void testHashTableGrowing ()
+{
+   puts ("--- testHashTableGrowing ---");
+
+   // Starts with 3 slots, and has to grow several times.
+   HashTable<Integer, Integer> h(true, true, 3);
+
+   for (int i = 0; i < 1000; i++)
+      h.put (new Integer (i), new Integer (i * i));
+   for (int i = 0; i < 1000; i += 2) {
+      Integer k (i);
+      h.remove (&k);
+   }
+
+   for (int i = 0; i < 1000; i++) {
+      Integer k (i);
+      Integer *v = h.get (&k);
+      if (i % 2)
+         assert (v && v->getValue () == i * i);
+      else
+         assert (v == NULL);
+   }
+
+   printf ("%d elements\n", h.size ());
+}
+
 void testVector1 ()
 {
    ReverseComparator reverse (&standardComparator);
@@ -148,6 +174,7 @@ int main (int argc, char *argv[])
 {
    testHashSet ();
    testHashTable ();
+   testHashTableGrowing ();
    testVector1 ();
    testVector2 ();
    testVector3 ();
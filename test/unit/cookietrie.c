@@ -0,0 +1,222 @@
+/*
+ * Dillo cookies domain index benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for the domain trie of the cookies dpi, which is included
+ * here whole so that its static functions can be driven directly, below
+ * the MAX_TOTAL_COOKIES cap: 50k cookies are added across 5k domains, and
+ * then the domain nodes for a URL host and its parents are looked up with
+ * Domain_trie_walk() and, as cookies.c used to, by searching a sorted list
+ * of nodes for each suffix of the host. Both must find the same nodes.
+ * Last, Cookies_get() is timed, and all the nodes are deleted to check
+ * that the trie is left empty.
+ */
+
+#define main Cookies_dpi_main
+#include "dpi/cookies.c"
+#undef main
+
+#ifdef DISABLE_COOKIES
+
+int main(void)
+{
+   return 77; /* skipped */
+}
+
+#else
+
+#define NUM_DOMAINS 5000
+#define NUM_SITES (NUM_DOMAINS / 2)
+#define NUM_COOKIES 50000
+#define NUM_LOOKUPS 200000
+#define NUM_GETS 50000
+
+static const char *const tlds[] = { "com", "org", "net", "co.uk", "de" };
+
+/*
+ * The host of a URL on site 'i', with 'sub' levels of subdomains.
+ */
+static void site_host(char *buf, int i, int sub)
+{
+   sprintf(buf, "%ssite%d.%s", sub > 1 ? "a.b." : sub ? "www." : "", i,
+           tlds[i % 5]);
+}
+
+/*
+ * Domain 'i': the www host of a site (for host-only cookies) or the site
+ * with a leading dot.
+ */
+static void cookie_domain(char *buf, int i)
+{
+   sprintf(buf, "%ssite%d.%s", i % 2 ? "." : "www.", i / 2,
+           tlds[(i / 2) % 5]);
+}
+
+static int Domain_node_cmp(const void *v1, const void *v2)
+{
+   const DomainNode *n1 = v1, *n2 = v2;
+
+   return dStrAsciiCasecmp(n1->domain, n2->domain);
+}
+
+static int Domain_node_by_domain_cmp(const void *v1, const void *v2)
+{
+   const DomainNode *node = v1;
+   const char *domain = v2;
+
+   return dStrAsciiCasecmp(node->domain, domain);
+}
+
+/*
+ * Count the nodes for 'host' and its parent domains, with and without a
+ * leading dot, in the sorted list 'sorted'.
+ */
+static int list_lookup(Dlist *sorted, const char *host)
+{
+   char dotted[256];
+   const char *p = host;
+   int n = 0;
+
+   while (p) {
+      dotted[0] = '.';
+      strcpy(dotted + 1, p);
+      n += !!dList_find_sorted(sorted, p, Domain_node_by_domain_cmp);
+      n += !!dList_find_sorted(sorted, dotted, Domain_node_by_domain_cmp);
+      if ((p = strchr(p, '.')))
+         p++;
+   }
+   return n;
+}
+
+/*
+ * Count the nodes for 'host' and its parent domains in the trie.
+ */
+static int trie_lookup(const char *host)
+{
+   DomainTrie *path[MAX_DOMAIN_LABELS];
+   int i, depth, n = 0;
+
+   Domain_trie_walk(host, FALSE, path, &depth);
+   for (i = 0; i < depth; i++)
+      n += (path[i]->node != NULL) + (path[i]->dot_node != NULL);
+   return n;
+}
+
+static double seconds(clock_t start)
+{
+   return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *what, int n, double t)
+{
+   printf("%-36s %7d in %.3f s (%.0f/s)\n", what, n, t,
+          n / (t > 0 ? t : 1e-9));
+}
+
+int main(void)
+{
+   char host[64], domain[64], name[16], *str;
+   DomainNode *node;
+   CookieData_t *cookie;
+   Dlist *sorted;
+   clock_t start;
+   double t;
+   int i, n_trie = 0, n_list = 0, n_get = 0, saved_stdout;
+
+   cookies_epoch_time = mktime(&cookies_epoch_tm);
+   disabled = FALSE;
+   all_cookies = dList_new(NUM_COOKIES);
+   domains = dList_new(NUM_DOMAINS);
+   domain_trie = dNew0(DomainTrie, 1);
+   journal = dStr_new("");
+
+   start = clock();
+   for (i = 0; i < NUM_COOKIES; i++) {
+      cookie = dNew0(CookieData_t, 1);
+      cookie_domain(domain, i % NUM_DOMAINS);
+      cookie->domain = dStrdup(domain);
+      cookie->host_only = (domain[0] == 'w');
+      cookie->path = dStrdup(i % 2 ? "/" : "/account");
+      sprintf(name, "c%d", i / NUM_DOMAINS);
+      cookie->name = dStrdup(name);
+      cookie->value = dStrdup("value");
+      cookie->expires_at = time(NULL) + 365 * 24 * 3600;
+      if (!(node = Cookies_find_node(cookie->domain)))
+         node = Cookies_new_node(cookie->domain);
+      dList_append(node->cookies, cookie);
+      dList_append(all_cookies, cookie);
+   }
+   report("trie: add cookies", NUM_COOKIES, seconds(start));
+   printf("%d domain nodes\n", dList_length(domains));
+
+   start = clock();
+   sorted = dList_new(NUM_DOMAINS);
+   for (i = 0; (node = dList_nth_data(domains, i)); i++)
+      dList_insert_sorted(sorted, node, Domain_node_cmp);
+   report("sorted list: insert domain nodes", dList_length(domains),
+          seconds(start));
+
+   start = clock();
+   for (i = 0; i < NUM_LOOKUPS; i++) {
+      site_host(host, (i * 7919) % NUM_SITES, i % 3);
+      n_trie += trie_lookup(host);
+   }
+   report("trie: host and parent lookups", NUM_LOOKUPS, seconds(start));
+
+   start = clock();
+   for (i = 0; i < NUM_LOOKUPS; i++) {
+      site_host(host, (i * 7919) % NUM_SITES, i % 3);
+      n_list += list_lookup(sorted, host);
+   }
+   report("sorted list: host and parent lookups", NUM_LOOKUPS,
+          seconds(start));
+
+   if (n_trie != n_list) {
+      printf("the trie found %d nodes, the sorted list %d\n", n_trie, n_list);
+      return 1;
+   }
+
+   /* Cookies_get() logs every call */
+   fflush(stdout);
+   saved_stdout = dup(STDOUT_FILENO);
+   dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
+   start = clock();
+   for (i = 0; i < NUM_GETS; i++) {
+      site_host(host, (i * 7919) % NUM_SITES, i % 3);
+      str = Cookies_get(host, i % 2 ? "/" : "/account/settings",
+                        i % 4 ? "https" : "http");
+      n_get += (*str != '\0');
+      dFree(str);
+   }
+   t = seconds(start);
+   fflush(stdout);
+   dup2(saved_stdout, STDOUT_FILENO);
+   report("Cookies_get", NUM_GETS, t);
+   if (n_get != NUM_GETS) {
+      printf("%d of the hosts got no cookies\n", NUM_GETS - n_get);
+      return 1;
+   }
+
+   dList_free(sorted);
+   while ((node = dList_nth_data(domains, 0))) {
+      while ((cookie = dList_nth_data(node->cookies, 0))) {
+         dList_remove(node->cookies, cookie);
+         dList_remove_fast(all_cookies, cookie);
+         Cookies_free_cookie(cookie);
+      }
+      Cookies_delete_node(node);
+   }
+   if (dList_length(domain_trie->children) != 0) {
+      printf("%d trie entries left\n", dList_length(domain_trie->children));
+      return 1;
+   }
+   return 0;
+}
+
+#endif /* !DISABLE_COOKIES */
@@ -0,0 +1,212 @@
+/*
+ * Dillo CSS rule memory benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for the memory that parsed rules take and for matching them.
+ * A generated sheet with many small rules, each with a few classes,
+ * pseudo-classes and declarations, is parsed NUM_SHEETS times and all the
+ * rule sets are kept, as dillo keeps the sheets of the open pages. It
+ * prints how much the resident set size grew, then the time to match
+ * every node of a generated page against one of the sheets, and the time
+ * to free the rule sets again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/css.hh"
+#include "src/cssparser.hh"
+#include "src/doctree.hh"
+
+#define NUM_RULES 4000
+#define NUM_SHEETS 20
+#define NUM_ROUNDS 40
+
+extern int a_Html_tag_index (const char *tag);
+
+static const char *const tags[] = { "div", "p", "a", "span", "li", "td" };
+
+static Dstr *gen_sheet ()
+{
+   Dstr *s = dStr_new ("");
+
+   for (int i = 0; i < NUM_RULES; i++) {
+      const char *tag = tags[i % 6];
+
+      switch (i % 4) {
+      case 0:
+         dStr_sprintfa (s, ".c%d{color:#%06x;margin:%dpx %dpx}\n",
+                        i % 500, i * 0x10307 & 0xffffff, i % 9, i % 13);
+         break;
+      case 1:
+         dStr_sprintfa (s, "%s.c%d.d%d:hover{background-color:#%06x;"
+                        "font-weight:bold;padding-left:%dem}\n",
+                        tag, i % 500, i % 7, i * 0x20501 & 0xffffff, i % 3);
+         break;
+      case 2:
+         dStr_sprintfa (s, ".c%d > %s.d%d{font-family:\"Helvetica Neue\","
+                        "Arial,sans-serif;line-height:1.%d;"
+                        "border-bottom:1px solid #%06x}\n",
+                        i % 500, tag, i % 7, i % 10, i & 0xffffff);
+         break;
+      default:
+         dStr_sprintfa (s, "#box-%d %s.c%d{text-decoration:underline;"
+                        "width:%d%%}\n", i % 50, tag, i % 500, i % 100);
+         break;
+      }
+   }
+   return s;
+}
+
+/* The resident set size in KB, or -1 where /proc is not available */
+static long rss_kb ()
+{
+   FILE *f = fopen ("/proc/self/statm", "r");
+   long size, resident = -1;
+
+   if (f) {
+      if (fscanf (f, "%ld %ld", &size, &resident) != 2)
+         resident = -1;
+      fclose (f);
+   }
+   return resident < 0 ? -1 : resident * 4;
+}
+
+static void push (Doctree *dt, const char *tag, const char *id,
+                  const char *klass)
+{
+   DoctreeNode *dn = dt->push ();
+
+   dn->element = a_Html_tag_index (tag);
+   dt->filterAdd (Doctree::elementHash (dn->element));
+   if (id) {
+      dn->id = dt->getZone ()->strdup (id);
+      dt->filterAdd (Doctree::stringHash (dn->id));
+   }
+   if (klass) {
+      dn->klass = new lout::misc::SimpleVector <char *> (1);
+      for (const char *p = klass, *q; *p; p = q + !!*q) {
+         q = strchr (p, ' ');
+         if (!q)
+            q = p + strlen (p);
+         dn->klass->increase ();
+         dn->klass->set (dn->klass->size () - 1,
+                         (char *) dt->getZone ()->strndup (p, q - p));
+      }
+      for (int i = 0; i < dn->klass->size (); i++)
+         dt->filterAdd (Doctree::stringHash (dn->klass->get (i)));
+   }
+}
+
+static unsigned long apply (CssContext *context, Doctree *dt)
+{
+   CssPropertyList props (true);
+   unsigned long sum = 0;
+
+   context->apply (&props, dt, dt->top (), NULL, NULL, NULL);
+   for (int i = 0; i < props.size (); i++)
+      sum = sum * 31 + props.getRef (i)->name * 7 + props.getRef (i)->type;
+   return sum;
+}
+
+/*
+ * Fifty boxes of ten elements, each with a link and a span, with the ids
+ * and classes of the sheet. Return a checksum of the properties.
+ */
+static unsigned long page (CssContext *context, Doctree *dt)
+{
+   unsigned long sum = 0;
+   char id[16], klass[32];
+
+   push (dt, "html", NULL, NULL);
+   push (dt, "body", NULL, NULL);
+   for (int b = 0; b < 50; b++) {
+      snprintf (id, sizeof (id), "box-%d", b);
+      snprintf (klass, sizeof (klass), "c%d", b * 10);
+      push (dt, "div", id, klass);
+      sum += apply (context, dt);
+      for (int i = 0; i < 10; i++) {
+         snprintf (klass, sizeof (klass), "c%d d%d", b * 10 + i, i % 7);
+         push (dt, tags[i % 6], NULL, klass);
+         sum += apply (context, dt);
+         push (dt, "a", NULL, klass + 1 + strcspn (klass + 1, " "));
+         sum += apply (context, dt);
+         dt->pop ();
+         push (dt, "span", NULL, NULL);
+         sum += apply (context, dt);
+         dt->pop ();
+         dt->pop ();
+      }
+      dt->pop ();
+   }
+   dt->pop ();
+   dt->pop ();
+   return sum;
+}
+
+int main ()
+{
+   Dstr *sheet = gen_sheet ();
+   CssRuleSet *ruleSets[NUM_SHEETS];
+   unsigned long sum = 0;
+   long rss_start, rss_parsed;
+   clock_t start;
+   double t_parse, t_apply, t_free;
+   int rules;
+
+   /* warm up the allocator */
+   ruleSets[0] = new CssRuleSet ();
+   ruleSets[0]->ref ();
+   CssParser::parse (NULL, NULL, ruleSets[0], sheet->str, sheet->len,
+                     CSS_ORIGIN_AUTHOR);
+   ruleSets[0]->unref ();
+
+   rss_start = rss_kb ();
+   start = clock ();
+   for (int i = 0; i < NUM_SHEETS; i++) {
+      ruleSets[i] = new CssRuleSet ();
+      ruleSets[i]->ref ();
+      CssParser::parse (NULL, NULL, ruleSets[i], sheet->str, sheet->len,
+                        CSS_ORIGIN_AUTHOR);
+   }
+   t_parse = (double) (clock () - start) / CLOCKS_PER_SEC;
+   rss_parsed = rss_kb ();
+   rules = ruleSets[0]->numRules ();
+
+   start = clock ();
+   for (int i = 0; i < NUM_ROUNDS; i++) {
+      lout::misc::ZoneAllocator zone (8192);
+      Doctree dt (&zone);
+      CssContext context;
+
+      ruleSets[i % NUM_SHEETS]->addTo (&context);
+      sum += page (&context, &dt);
+   }
+   t_apply = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+   start = clock ();
+   for (int i = 0; i < NUM_SHEETS; i++)
+      ruleSets[i]->unref ();
+   t_free = (double) (clock () - start) / CLOCKS_PER_SEC;
+
+   printf ("%d rules, %d bytes of CSS, %d sheets kept\n",
+           rules, sheet->len, NUM_SHEETS);
+   if (rss_start >= 0)
+      printf ("resident set: %ld KB more, %.1f KB per sheet\n",
+              rss_parsed - rss_start,
+              (double) (rss_parsed - rss_start) / NUM_SHEETS);
+   printf ("parse: %.2f ms per sheet\n", 1000 * t_parse / NUM_SHEETS);
+   printf ("apply: %.2f ms per page (%lu)\n", 1000 * t_apply / NUM_ROUNDS,
+           sum % 100000);
+   printf ("free:  %.2f ms per sheet\n", 1000 * t_free / NUM_SHEETS);
+
+   dStr_free (sheet, 1);
+   return rules == NUM_RULES ? 0 : 1;
+}
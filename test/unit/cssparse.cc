@@ -0,0 +1,223 @@
+/*
+ * Dillo CSS parser benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for CssParser::parse (), on stylesheets of the size of the
+ * big CSS frameworks: the doxygen-awesome.css of devdoc, five times over,
+ * and a generated sheet in the style of Bootstrap's (grid and utility
+ * classes, button variants, media queries, custom properties, data: URLs
+ * and comments). It prints the parse speed and the number of rules, which
+ * must be the same every time a sheet is parsed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/css.hh"
+#include "src/cssparser.hh"
+
+#define DOXYGEN_CSS CUR_SRC_DIR "/../../devdoc/doxygen-awesome.css"
+#define DOXYGEN_COPIES 5
+#define GENERATED_SIZE (400 * 1024)
+#define MIN_BYTES (40 * 1024 * 1024)
+
+static const char *const colors[] = {
+   "primary", "secondary", "success", "info", "warning", "danger", "light",
+   "dark"
+};
+static const char *const sides[] = { "", "t", "b", "s", "e", "x", "y" };
+static const char *const sideProps[] = {
+   "%s:%s!important}", "%s-top:%s!important}", "%s-bottom:%s!important}",
+   "%s-left:%s!important}", "%s-right:%s!important}",
+   "%s-left:%s!important;%s-right:%s!important}",
+   "%s-top:%s!important;%s-bottom:%s!important}"
+};
+static const char *const breakpoints[] = { "sm", "md", "lg", "xl", "xxl" };
+static const int minWidths[] = { 576, 768, 992, 1200, 1400 };
+
+/*
+ * Append one breakpoint's worth of a Bootstrap-like framework: the grid,
+ * the spacing and display utilities, with the infix 'bp' ("" or "-md").
+ */
+static void gen_utilities (Dstr *s, const char *bp)
+{
+   static const char *const sizes[] = {
+      "0", ".25rem", ".5rem", "1rem", "1.5rem", "3rem"
+   };
+
+   for (int i = 1; i <= 12; i++)
+      dStr_sprintfa (s, ".col%s-%d{flex:0 0 auto;width:%.8f%%}\n",
+                     bp, i, 100.0 * i / 12);
+   for (int i = 0; i < 12; i++)
+      dStr_sprintfa (s, ".offset%s-%d{margin-left:%.8f%%}\n",
+                     bp, i, 100.0 * i / 12);
+   for (int p = 0; p < 2; p++) {
+      const char *prop = p ? "padding" : "margin";
+
+      for (int side = 0; side < 7; side++)
+         for (int i = 0; i < 6; i++) {
+            dStr_sprintfa (s, ".%c%s%s-%d{", prop[0], sides[side], bp, i);
+            dStr_sprintfa (s, sideProps[side], prop, sizes[i], prop,
+                           sizes[i]);
+            dStr_append_c (s, '\n');
+         }
+   }
+   dStr_sprintfa (s, ".d%s-none{display:none!important}\n"
+                     ".d%s-inline{display:inline!important}\n"
+                     ".d%s-inline-block{display:inline-block!important}\n"
+                     ".d%s-block{display:block!important}\n"
+                     ".d%s-table{display:table!important}\n"
+                     ".d%s-table-cell{display:table-cell!important}\n"
+                     ".text%s-start{text-align:left!important}\n"
+                     ".text%s-end{text-align:right!important}\n"
+                     ".text%s-center{text-align:center!important}\n",
+                  bp, bp, bp, bp, bp, bp, bp, bp, bp);
+}
+
+/*
+ * Append the components: buttons, alerts, tables and forms, once per
+ * color, with a variation 'n' in the colors so no two blocks are equal.
+ */
+static void gen_components (Dstr *s, int n)
+{
+   for (int c = 0; c < 8; c++) {
+      const char *name = colors[c];
+      int rgb = (c * 0x1f3b5d + n * 0x010203) & 0xffffff;
+
+      dStr_sprintfa (s,
+         "/* %s, variant %d */\n"
+         ".btn-%s{--bs-btn-color:#fff;--bs-btn-bg:#%06x;"
+         "color:#fff;background-color:#%06x;border-color:#%06x;"
+         "border:1px solid transparent;border-radius:.375rem;"
+         "padding:.375rem .75rem;font-size:1rem;line-height:1.5}\n"
+         ".btn-%s:hover,.btn-%s:focus,.btn-check:checked+.btn-%s,"
+         ".btn-%s.active,.show>.btn-%s.dropdown-toggle{color:#fff;"
+         "background-color:#%06x;border-color:#%06x}\n"
+         ".btn-outline-%s{color:#%06x;border-color:#%06x}\n"
+         ".alert-%s{color:#%06x;background-color:#%06x;"
+         "border:1px solid #%06x;margin-bottom:1rem;padding:1rem 1rem}\n"
+         ".alert-%s .alert-link,a.alert-%s:hover{color:#%06x;"
+         "font-weight:700;text-decoration:underline}\n"
+         ".table-%s,.table-%s>th,.table-%s>td{background-color:#%06x;"
+         "border-color:#%06x}\n"
+         "table.table-%s tbody tr:first-child td.cell-%d,"
+         "div#main .card-%s ul li a[href]{color:rgb(%d,%d,%d)}\n"
+         ".form-select-%s{background-image:url(\"data:image/svg+xml,"
+         "%%3csvg xmlns='http://www.w3.org/2000/svg' viewBox='0 0 16 16'"
+         "%%3e%%3cpath fill='none' stroke='%%23%06x' stroke-width='2' "
+         "d='m2 5 6 6 6-6'/%%3e%%3c/svg%%3e\");background-repeat:no-repeat;"
+         "background-position:right .75rem center;"
+         "font-family:\"Helvetica Neue\",Arial,sans-serif}\n",
+         name, n,
+         name, rgb, rgb, rgb,
+         name, name, name, name, name, rgb ^ 0x202020, rgb ^ 0x202020,
+         name, rgb, rgb,
+         name, rgb ^ 0x404040, rgb ^ 0xc0c0c0, rgb ^ 0x808080,
+         name, name, rgb ^ 0x606060,
+         name, name, name, rgb ^ 0xe0e0e0, rgb ^ 0xd0d0d0,
+         name, n, name, rgb >> 16, (rgb >> 8) & 0xff, rgb & 0xff,
+         name, rgb);
+   }
+}
+
+static Dstr *gen_framework ()
+{
+   Dstr *s = dStr_sized_new (GENERATED_SIZE + 16 * 1024);
+
+   dStr_append (s, "/*!\n * A generated framework stylesheet\n */\n"
+                   ":root{--bs-blue:#0d6efd;--bs-font-sans-serif:system-ui,"
+                   "-apple-system,\"Segoe UI\",Roboto,sans-serif}\n"
+                   "*,::after,::before{box-sizing:border-box}\n"
+                   "body{margin:0;font-family:var(--bs-font-sans-serif);"
+                   "font-size:1rem;font-weight:400;line-height:1.5;"
+                   "color:#212529;background-color:#fff}\n");
+   gen_utilities (s, "");
+   for (int n = 0; s->len < GENERATED_SIZE; n++) {
+      int bp = n % 5;
+      char infix[8];
+
+      gen_components (s, n);
+      dStr_sprintfa (s, "@media (min-width:%dpx){\n", minWidths[bp]);
+      snprintf (infix, sizeof (infix), "-%s", breakpoints[bp]);
+      gen_utilities (s, infix);
+      dStr_append (s, "}\n");
+      dStr_sprintfa (s, "@media print{.d-print-%d{display:none!important}}\n"
+                        "@supports (position:sticky){.sticky-%d{top:0}}\n",
+                     n, n);
+   }
+   return s;
+}
+
+static Dstr *read_doxygen_css ()
+{
+   FILE *f = fopen (DOXYGEN_CSS, "r");
+   Dstr *s;
+   char buf[8192];
+   size_t n;
+
+   if (!f)
+      return NULL;
+   s = dStr_new ("");
+   while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+      dStr_append_l (s, buf, n);
+   fclose (f);
+   return s;
+}
+
+/*
+ * Parse 'sheet' until MIN_BYTES have gone through the parser. Return
+ * false if the number of rules changes from one parse to the next.
+ */
+static bool bench (const char *what, Dstr *sheet)
+{
+   int rounds = MIN_BYTES / sheet->len + 1, rules = -1;
+   clock_t start = clock ();
+   double t;
+
+   for (int i = 0; i < rounds; i++) {
+      CssRuleSet *ruleSet = new CssRuleSet ();
+
+      ruleSet->ref ();
+      CssParser::parse (NULL, NULL, ruleSet, sheet->str, sheet->len,
+                        CSS_ORIGIN_AUTHOR);
+      if (rules != -1 && ruleSet->numRules () != rules) {
+         printf ("%s: %d rules, then %d\n", what, rules,
+                 ruleSet->numRules ());
+         return false;
+      }
+      rules = ruleSet->numRules ();
+      ruleSet->unref ();
+   }
+   t = (double) (clock () - start) / CLOCKS_PER_SEC;
+   printf ("%-26s %4d KB, %5d rules: %.2f ms per parse, %.1f MB/s\n",
+           what, sheet->len / 1024, rules, 1000 * t / rounds,
+           (double) sheet->len * rounds / (1024 * 1024) / (t > 0 ? t : 1e-9));
+   return rules > 0;
+}
+
+int main ()
+{
+   Dstr *doxygen, *sheet, *framework = gen_framework ();
+   bool ok = bench ("generated framework", framework);
+
+   if ((doxygen = read_doxygen_css ())) {
+      sheet = dStr_sized_new (doxygen->len * DOXYGEN_COPIES);
+      for (int i = 0; i < DOXYGEN_COPIES; i++)
+         dStr_append_l (sheet, doxygen->str, doxygen->len);
+      ok = bench ("doxygen-awesome.css x5", sheet) && ok;
+      dStr_free (sheet, 1);
+      dStr_free (doxygen, 1);
+   } else {
+      printf ("%s not found, skipped\n", DOXYGEN_CSS);
+   }
+   dStr_free (framework, 1);
+   return ok ? 0 : 1;
+}
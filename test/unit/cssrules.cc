@@ -0,0 +1,146 @@
+/*
+ * Dillo CSS rule set saving test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Test for CssRuleSet::save () and load (), which build the user agent
+ * rules into dillo and cache the user stylesheet. The user agent sheet and
+ * the doxygen-awesome.css of devdoc are parsed, saved, loaded and saved
+ * again, and both saved forms must be the same. Damaged data must be
+ * refused. It also prints how long parsing and loading take.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/css.hh"
+#include "src/cssparser.hh"
+
+#define UA_CSS CUR_SRC_DIR "/../../src/uastyle.css"
+#define DOXYGEN_CSS CUR_SRC_DIR "/../../devdoc/doxygen-awesome.css"
+#define MIN_BYTES (20 * 1024 * 1024)
+
+static Dstr *read_file (const char *filename)
+{
+   FILE *f = fopen (filename, "r");
+   Dstr *s;
+   char buf[8192];
+   size_t n;
+
+   if (!f)
+      return NULL;
+   s = dStr_new ("");
+   while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+      dStr_append_l (s, buf, n);
+   fclose (f);
+   return s;
+}
+
+static double seconds (clock_t start)
+{
+   return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+static bool test (const char *filename, CssOrigin origin)
+{
+   Dstr *css = read_file (filename), *saved, *again;
+   CssRuleSet *ruleSet;
+   int rounds, rules;
+   clock_t start;
+   double t_parse, t_load;
+   bool ok = true;
+
+   if (!css) {
+      printf ("%s not found, skipped\n", filename);
+      return true;
+   }
+
+   ruleSet = new CssRuleSet ();
+   ruleSet->ref ();
+   CssParser::parse (NULL, NULL, ruleSet, css->str, css->len, origin);
+   rules = ruleSet->numRules ();
+   saved = dStr_new ("");
+   ruleSet->save (saved);
+   ruleSet->unref ();
+
+   ruleSet = new CssRuleSet ();
+   ruleSet->ref ();
+   again = dStr_new ("");
+   if (!ruleSet->load (saved->str, saved->len)) {
+      printf ("%s: can't load the saved rules\n", filename);
+      ok = false;
+   } else if (ruleSet->numRules () != rules) {
+      printf ("%s: %d rules parsed, %d loaded\n", filename, rules,
+              ruleSet->numRules ());
+      ok = false;
+   } else {
+      ruleSet->save (again);
+      if (again->len != saved->len ||
+          memcmp (again->str, saved->str, saved->len) != 0) {
+         printf ("%s: the loaded rules are saved differently\n", filename);
+         ok = false;
+      }
+   }
+   ruleSet->unref ();
+
+   /* cut short, or with a byte changed in the header */
+   for (int i = 0; i < 2; i++) {
+      ruleSet = new CssRuleSet ();
+      ruleSet->ref ();
+      if (i == 0 && ruleSet->load (saved->str, saved->len - 1)) {
+         printf ("%s: loaded truncated rules\n", filename);
+         ok = false;
+      }
+      if (i == 1) {
+         saved->str[4] ^= 0x40;
+         if (ruleSet->load (saved->str, saved->len)) {
+            printf ("%s: loaded rules of another version\n", filename);
+            ok = false;
+         }
+         saved->str[4] ^= 0x40;
+      }
+      ruleSet->unref ();
+   }
+
+   rounds = MIN_BYTES / css->len + 1;
+   start = clock ();
+   for (int i = 0; i < rounds; i++) {
+      ruleSet = new CssRuleSet ();
+      ruleSet->ref ();
+      CssParser::parse (NULL, NULL, ruleSet, css->str, css->len, origin);
+      ruleSet->unref ();
+   }
+   t_parse = seconds (start);
+   start = clock ();
+   for (int i = 0; i < rounds; i++) {
+      ruleSet = new CssRuleSet ();
+      ruleSet->ref ();
+      ruleSet->load (saved->str, saved->len);
+      ruleSet->unref ();
+   }
+   t_load = seconds (start);
+
+   printf ("%-24s %5d rules, %6d bytes of CSS, %6d saved: "
+           "parse %.1f us, load %.1f us\n",
+           strrchr (filename, '/') + 1, rules, css->len, saved->len,
+           1e6 * t_parse / rounds, 1e6 * t_load / rounds);
+
+   dStr_free (again, 1);
+   dStr_free (saved, 1);
+   dStr_free (css, 1);
+   return ok;
+}
+
+int main ()
+{
+   bool ok = test (UA_CSS, CSS_ORIGIN_USER_AGENT);
+
+   ok = test (DOXYGEN_CSS, CSS_ORIGIN_USER) && ok;
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+/*
+ * Dillo CSS tests and benchmarks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Stubs for the few functions of html.cc and hsts.c that the CSS code and
+ * url.c call, so that the CSS tests and benchmarks can be linked without
+ * the rest of src/.
+ */
+
+#include <stdlib.h>
+
+#include "src/html_common.hh"
+#include "src/hsts.h"
+
+/* The element names the tests and benchmarks use, sorted; anything else
+ * is unknown, as in a_Html_tag_index () */
+static const char *const tags[] = {
+   "a", "abbr", "address", "article", "aside", "b", "big", "blockquote",
+   "body", "button", "caption", "center", "cite", "code", "dd", "del",
+   "details", "dir", "div", "dl", "dt", "em", "fieldset", "figcaption",
+   "figure", "footer", "form", "frameset", "h1", "h2", "h3", "h4", "h5", "h6",
+   "header", "hr", "html", "i", "img", "input", "ins", "kbd", "label",
+   "legend", "li", "main", "mark", "nav", "ol", "p", "pre", "s", "samp",
+   "section", "select", "small", "span", "strike", "strong", "sub", "summary",
+   "sup", "table", "tbody", "td", "textarea", "tfoot", "th", "thead", "tr",
+   "tt", "u", "ul", "var"
+};
+
+static int tag_cmp (const void *key, const void *elem)
+{
+   return dStrAsciiCasecmp ((const char *) key, *(const char *const *) elem);
+}
+
+int a_Html_tag_index (const char *tag)
+{
+   const char *const *t = (const char *const *)
+      bsearch (tag, tags, sizeof (tags) / sizeof (tags[0]), sizeof (tags[0]),
+               tag_cmp);
+
+   return t ? (int) (t - tags) : -1;
+}
+
+const char *a_Html_tag_name (int idx)
+{
+   return (idx >= 0 && idx < (int) (sizeof (tags) / sizeof (tags[0]))) ?
+          tags[idx] : NULL;
+}
+
+DilloUrl *a_Html_url_new (DilloHtml *html, const char *url_str,
+                          const char *base_url, int use_base_url)
+{
+   return NULL; /* no @import without a DilloHtml */
+}
+
+bool_t a_Hsts_require_https (const char *host)
+{
+   return FALSE;
+}
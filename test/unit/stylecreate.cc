@@ -0,0 +1,99 @@
+/*
+ * Dillo Widget
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Microbenchmark for dw::core::style::Style::create (), on the miss path
+ * (a new style is interned) and on the hit path (an equal one is found),
+ * with styles that differ in a few fields, as table cells and list items
+ * do. It also checks that equal attributes give the same style.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dw/core.hh"
+
+using namespace dw::core::style;
+
+#define NUM_STYLES 50000
+#define NUM_ROUNDS 10
+
+/* Style::create () only needs a font to point to and to ref */
+class BenchFont: public Font
+{
+public:
+   BenchFont (FontAttrs *attrs) { copyAttrs (attrs); ref (); }
+};
+
+static void setAttrs (StyleAttrs *attrs, Font *font, int i)
+{
+   attrs->initValues ();
+   attrs->font = font;
+   attrs->x_link = i % 50 - 1;
+   attrs->margin.left = i % 7;
+   attrs->padding.setVal (i % 3);
+   attrs->width = createAbsLength (i / 350);
+}
+
+static double seconds (clock_t start)
+{
+   return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+int main ()
+{
+   FontAttrs fontAttrs;
+   StyleAttrs attrs;
+   Style **styles = new Style*[NUM_STYLES];
+   Style *style;
+   clock_t start;
+   double t;
+
+   fontAttrs.name = "serif";
+   fontAttrs.size = 14;
+   fontAttrs.weight = 400;
+   fontAttrs.letterSpacing = 0;
+   fontAttrs.fontVariant = FONT_VARIANT_NORMAL;
+   fontAttrs.style = FONT_STYLE_NORMAL;
+   Font *font = new BenchFont (&fontAttrs);
+
+   start = clock ();
+   for (int i = 0; i < NUM_STYLES; i++) {
+      setAttrs (&attrs, font, i);
+      styles[i] = Style::create (&attrs);
+   }
+   t = seconds (start);
+   printf ("Style::create: %d misses in %.3f s (%.0f/s)\n",
+           NUM_STYLES, t, NUM_STYLES / (t > 0 ? t : 1e-9));
+
+   start = clock ();
+   for (int r = 0; r < NUM_ROUNDS; r++) {
+      for (int i = 0; i < NUM_STYLES; i++) {
+         setAttrs (&attrs, font, i);
+         style = Style::create (&attrs);
+         if (style != styles[i]) {
+            printf ("Style::create returned a new style for %d\n", i);
+            exit (1);
+         }
+         style->unref ();
+      }
+   }
+   t = seconds (start);
+   printf ("Style::create: %d hits in %.3f s (%.0f/s)\n",
+           NUM_STYLES * NUM_ROUNDS, t,
+           NUM_STYLES * NUM_ROUNDS / (t > 0 ? t : 1e-9));
+
+   for (int i = 0; i < NUM_STYLES; i++)
+      styles[i]->unref ();
+   delete[] styles;
+   font->unref ();
+
+   return 0;
+}
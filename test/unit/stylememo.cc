@@ -0,0 +1,222 @@
+/*
+ * Dillo style engine benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for the computed styles that StyleEngine memoizes. A page of
+ * repeated structures (a table with a class per column, nested lists and
+ * cards) is fed to a StyleEngine, with the built-in user agent rules and
+ * a small author sheet, and the style of every element is computed, the
+ * way the HTML parser does it. It prints the time per page and how many
+ * styles were shared with a sibling, memoized or computed.
+ *
+ * The rest of dillo is stubbed out: there is no browser window, and no
+ * background images or @import are loaded. The user stylesheet is left
+ * out too.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/prefs.h"
+#include "src/misc.h"
+#include "src/html_common.hh"
+#include "src/styleengine.hh"
+#include "src/web.hh"
+#include "src/capi.h"
+#include "src/image.hh"
+#include "benchplatform.hh"
+
+#define NUM_ROWS 200
+#define NUM_COLUMNS 6
+#define NUM_LISTS 50
+#define NUM_CARDS 100
+#define NUM_ROUNDS 20
+
+static const char *const sheet =
+   "body{margin:0;font-family:sans-serif;font-size:15px;color:#222}\n"
+   ".container{max-width:960px;margin:0 auto;padding:0 16px}\n"
+   "table.listing{border-collapse:collapse;width:100%}\n"
+   ".listing td{padding:4px 8px;border-bottom:1px solid #ddd}\n"
+   ".listing td.rank{text-align:right;color:#888;width:2em}\n"
+   ".listing td.title a{color:#000;font-weight:bold}\n"
+   ".listing td.site a{color:#666;font-size:smaller}\n"
+   ".listing td.score{font-size:13px}\n"
+   ".listing td.user a{color:#036}\n"
+   ".listing td.age{color:#999;white-space:nowrap}\n"
+   ".meta{font-size:12px;color:#777;margin-left:4px}\n"
+   "ul.tree{list-style-type:square;padding-left:20px}\n"
+   "ul.tree ul{list-style-type:circle;margin:2px 0}\n"
+   "ul.tree li a{text-decoration:none}\n"
+   ".card{border:1px solid #ccc;border-radius:4px;margin:12px 0;"
+   "padding:8px 12px;background-color:#fafafa}\n"
+   ".card h2{font-size:18px;margin:0 0 6px}\n"
+   ".card p{line-height:1.4;margin:4px 0}\n"
+   ".card .footer{border-top:1px dotted #ccc;padding-top:4px}\n"
+   ".card .footer a{margin-right:8px}\n";
+
+static const char *const columns[NUM_COLUMNS] = {
+   "rank", "title", "site", "score", "user", "age"
+};
+
+/* Stubs for what StyleEngine calls to load background images and
+ * imported stylesheets, which the benchmark doesn't use. */
+void a_Html_load_stylesheet (DilloHtml *html, DilloUrl *url) { }
+void a_Bw_add_client (BrowserWindow *bw, int Key, int Root) { }
+void a_Bw_add_url (BrowserWindow *bw, const DilloUrl *Url) { }
+int a_Capi_open_url (DilloWeb *web, CA_Callback_t Call, void *CbData)
+{ return 0; }
+uint_t a_Capi_get_serial (const DilloUrl *Url) { return 0; }
+void a_Capi_stop_client (int Key, int force) { }
+DilloImage *a_Image_new (void *layout, void *img_rndr,
+                         int32_t bg_color, int32_t fg_color)
+{ return NULL; }
+void a_Image_ref (DilloImage *Image) { }
+DilloWeb *a_Web_new (BrowserWindow *bw, const DilloUrl *url,
+                     const DilloUrl *requester)
+{ return NULL; }
+Dstr *a_Misc_file2dstr (const char *filename) { return NULL; }
+
+/*
+ * Open an element and compute its style, as the HTML parser does before
+ * it adds the element's content. Return a checksum of the style.
+ */
+static unsigned long openElement (StyleEngine *se, const char *tag,
+                                  const char *klass)
+{
+   dw::core::style::Style *style;
+
+   se->startElement (tag, NULL);
+   if (klass)
+      se->setClass (klass);
+   style = se->style (NULL);
+   return style->font->size + style->margin.left + style->padding.top +
+          style->color->getColor () + style->display;
+}
+
+static void closeElement (StyleEngine *se)
+{
+   se->endElement (se->getDoctreeNode ()->element);
+}
+
+static unsigned long page (StyleEngine *se)
+{
+   unsigned long sum = 0;
+
+   sum += openElement (se, "html", NULL);
+   sum += openElement (se, "body", NULL);
+   sum += openElement (se, "div", "container");
+
+   sum += openElement (se, "table", "listing");
+   sum += openElement (se, "tbody", NULL);
+   for (int r = 0; r < NUM_ROWS; r++) {
+      sum += openElement (se, "tr", NULL);
+      for (int c = 0; c < NUM_COLUMNS; c++) {
+         sum += openElement (se, "td", columns[c]);
+         if (c == 0) {
+            closeElement (se);
+            continue;
+         }
+         sum += openElement (se, "a", NULL);
+         closeElement (se);
+         if (c == 1) {
+            sum += openElement (se, "span", "meta");
+            closeElement (se);
+         }
+         closeElement (se);
+      }
+      closeElement (se);
+   }
+   closeElement (se);
+   closeElement (se);
+
+   for (int l = 0; l < NUM_LISTS; l++) {
+      sum += openElement (se, "ul", "tree");
+      for (int i = 0; i < 3; i++) {
+         sum += openElement (se, "li", NULL);
+         sum += openElement (se, "a", NULL);
+         closeElement (se);
+         sum += openElement (se, "ul", NULL);
+         for (int j = 0; j < 4; j++) {
+            sum += openElement (se, "li", NULL);
+            sum += openElement (se, "a", NULL);
+            closeElement (se);
+            closeElement (se);
+         }
+         closeElement (se);
+         closeElement (se);
+      }
+      closeElement (se);
+   }
+
+   for (int c = 0; c < NUM_CARDS; c++) {
+      sum += openElement (se, "div", "card");
+      sum += openElement (se, "h2", NULL);
+      closeElement (se);
+      for (int p = 0; p < 2; p++) {
+         sum += openElement (se, "p", NULL);
+         sum += openElement (se, "em", NULL);
+         closeElement (se);
+         closeElement (se);
+      }
+      sum += openElement (se, "div", "footer");
+      for (int a = 0; a < 3; a++) {
+         sum += openElement (se, "a", NULL);
+         closeElement (se);
+      }
+      sum += openElement (se, "span", "meta");
+      closeElement (se);
+      closeElement (se);
+      closeElement (se);
+   }
+
+   closeElement (se);
+   closeElement (se);
+   closeElement (se);
+   return sum;
+}
+
+int main ()
+{
+   BenchPlatform *platform = new BenchPlatform ();
+   dw::core::Layout *layout = new dw::core::Layout (platform);
+   unsigned long sum = 0;
+   int shared = 0, memoized = 0, computed = 0;
+   clock_t start;
+   double t = 0;
+
+   a_Prefs_init ();
+   StyleEngine::init ();
+
+   for (int i = 0; i < NUM_ROUNDS; i++) {
+      lout::misc::ZoneAllocator zone (8192);
+      StyleEngine *se = new StyleEngine (layout, NULL, NULL, 1.0, &zone);
+      int s, m, c;
+
+      se->parse (NULL, NULL, sheet, strlen (sheet), CSS_ORIGIN_AUTHOR);
+      start = clock ();
+      sum += page (se);
+      t += (double) (clock () - start) / CLOCKS_PER_SEC;
+      se->getStatistics (&s, &m, &c);
+      shared += s;
+      memoized += m;
+      computed += c;
+      delete se;
+   }
+
+   printf ("%d elements per page: %.2f ms per page (%lu)\n",
+           (shared + memoized + computed) / NUM_ROUNDS,
+           1000 * t / NUM_ROUNDS, sum % 100000);
+   printf ("styles shared with a sibling: %d, memoized: %d, computed: %d\n",
+           shared / NUM_ROUNDS, memoized / NUM_ROUNDS, computed / NUM_ROUNDS);
+
+   delete layout;
+   a_Prefs_freeall ();
+   return computed > 0 && shared + memoized + computed > 0 ? 0 : 1;
+}
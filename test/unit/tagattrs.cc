@@ -0,0 +1,375 @@
+/*
+ * Dillo tag attribute benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for the attribute lookups of the HTML parser, in tags per
+ * second. Each tag of an attribute-heavy page gets the lookups that its
+ * open handler and Html_parse_common_attrs() make, served:
+ *  - from a table built by splitting the tag once, as Html_split_attrs()
+ *    and Html_get_attr2() in src/html.cc do now, and
+ *  - by running the attribute state machine over the whole tag for every
+ *    lookup, as Html_get_attr2() used to.
+ * Both must return the same values. The code below follows src/html.cc,
+ * which can't be linked without the rest of the browser; entities are
+ * reduced to "&amp;", the same for both.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dlib/dlib.h"
+#include "lout/misc.hh"
+
+using namespace lout;
+
+#define NUM_ROUNDS 20000
+
+typedef enum {
+   HTML_LeftTrim      = 1 << 0,
+   HTML_RightTrim     = 1 << 1,
+   HTML_ParseEntities = 1 << 2
+} DilloHtmlTagParsingFlags;
+
+typedef enum {
+   SEEK_ATTR_START,
+   MATCH_ATTR_NAME,
+   SEEK_TOKEN_START,
+   SEEK_VALUE_START,
+   SKIP_VALUE,
+   GET_VALUE,
+   FINISHED
+} DilloHtmlTagParsingState;
+
+typedef struct {
+   int name, nameLen;
+   uint32_t nameHash;
+   int value, valueLen;
+} DilloHtmlAttr;
+
+static Dstr *attr_data;
+static const char *attr_tag;
+static int attr_tagsize;
+static misc::SimpleVector <DilloHtmlAttr> *attrs;
+
+/* The tags of a table of image links, and the names their handlers ask */
+static const struct {
+   const char *tag;
+   const char *const names[16];
+} tags[] = {
+   { "<tr class=\"row odd\" bgcolor=\"#f0f0f0\" valign=top>",
+     { "id", "class", "style", "lang", "bgcolor", "align", "valign" } },
+   { "<td class=\"thumb\" align=\"center\" width=\"120\" nowrap "
+     "style=\"padding: 2px 4px\">",
+     { "id", "class", "style", "lang", "nowrap", "width", "bgcolor",
+       "align", "valign" } },
+   { "<a href=\"/gallery/view?id=31337&amp;size=large&amp;from=index\" "
+     "title=\"A view of the bay\" class=\"thumb-link\" rel=\"nofollow\">",
+     { "id", "class", "style", "lang", "href", "title", "name" } },
+   { "<img src=\"/thumbs/31337-120x90.jpg\" alt=\"A view of the bay, "
+     "from the north\" title=\"A view of the bay\" width=\"120\" "
+     "height=\"90\" border=\"0\" class=\"thumb\" loading=\"lazy\" "
+     "data-full=\"/photos/31337.jpg\">",
+     { "id", "class", "style", "lang", "title", "width", "height",
+       "hspace", "vspace", "border", "src", "alt", "usemap", "ismap",
+       "align" } },
+   { "<td class=\"caption\" colspan=2 style='text-align: left'>",
+     { "id", "class", "style", "lang", "nowrap", "width", "bgcolor",
+       "align", "valign" } },
+};
+#define NUM_TAGS (int)(sizeof(tags) / sizeof(tags[0]))
+
+static const char *parse_entity(const char *s, int *entsize)
+{
+   if (!strncmp(s, "&amp;", 5)) {
+      *entsize = 5;
+      return "&";
+   }
+   return NULL;
+}
+
+static uint32_t name_hash(const char *name, int len)
+{
+   uint32_t h = 2166136261U;
+   int i;
+
+   for (i = 0; i < len; ++i)
+      h = (h ^ (uchar_t)D_ASCII_TOLOWER(name[i])) * 16777619U;
+   return h;
+}
+
+static void trim(Dstr *Buf, int tag_parsing_flags)
+{
+   if (tag_parsing_flags & HTML_LeftTrim)
+      while (isspace(Buf->str[0]))
+         dStr_erase(Buf, 0, 1);
+   if (tag_parsing_flags & HTML_RightTrim)
+      while (Buf->len && isspace(Buf->str[Buf->len - 1]))
+         dStr_truncate(Buf, Buf->len - 1);
+}
+
+/*
+ * Html_split_attrs()
+ */
+static void split_attrs(const char *tag, int tagsize)
+{
+   DilloHtmlAttr *attr;
+   int i = 1, end = tagsize - 1, delimiter;
+
+   attrs->setSize(0);
+   attr_tag = tag;
+   attr_tagsize = tagsize;
+
+   while (i < end && !isspace(tag[i]) && tag[i] != '=')
+      ++i;
+
+   while (i < end) {
+      if (isspace(tag[i])) {
+         ++i;
+         continue;
+      }
+      attr = NULL;
+      if (tag[i] != '=') {
+         attrs->increase();
+         attr = attrs->getLastRef();
+         attr->name = i;
+         while (i < end && !isspace(tag[i]) && tag[i] != '=')
+            ++i;
+         attr->nameLen = i - attr->name;
+         attr->nameHash = name_hash(tag + attr->name, attr->nameLen);
+         attr->value = -1;
+         attr->valueLen = 0;
+         while (i < end && isspace(tag[i]))
+            ++i;
+         if (i == end || tag[i] != '=')
+            continue;
+      }
+      for (++i; i < end && isspace(tag[i]); ++i) ;
+      if (i < end && (tag[i] == '"' || tag[i] == '\'')) {
+         delimiter = tag[i++];
+         if (attr)
+            attr->value = i;
+         while (i < tagsize && tag[i] != delimiter)
+            ++i;
+         if (attr)
+            attr->valueLen = i - attr->value;
+         ++i;
+      } else {
+         if (attr)
+            attr->value = i;
+         while (i < end && !isspace(tag[i]))
+            ++i;
+         if (attr)
+            attr->valueLen = i - attr->value;
+      }
+   }
+}
+
+/*
+ * Html_get_attr2(), now
+ */
+static const char *get_attr_split(const char *tag, int tagsize,
+                                  const char *attrname, int tag_parsing_flags)
+{
+   int i, j, n, entsize;
+   uint32_t h;
+   Dstr *Buf = attr_data;
+   DilloHtmlAttr *attr = NULL;
+   const char *val, *entstr;
+
+   if (tag != attr_tag || tagsize != attr_tagsize)
+      split_attrs(tag, tagsize);
+
+   n = strlen(attrname);
+   h = name_hash(attrname, n);
+   for (i = 0; i < attrs->size(); ++i) {
+      attr = attrs->getRef(i);
+      if (attr->nameHash == h && attr->nameLen == n) {
+         for (j = 0; j < n && (D_ASCII_TOLOWER(tag[attr->name + j]) ==
+                               D_ASCII_TOLOWER(attrname[j])); ++j) ;
+         if (j == n)
+            break;
+      }
+   }
+   if (i == attrs->size())
+      return NULL;
+
+   dStr_truncate(Buf, 0);
+   val = (attr->value >= 0) ? tag + attr->value : "";
+   for (i = 0; i < attr->valueLen; ++i) {
+      if (val[i] == '&' && (tag_parsing_flags & HTML_ParseEntities) &&
+          (entstr = parse_entity(val + i, &entsize))) {
+         dStr_append(Buf, entstr);
+         i += entsize-1;
+      } else if (val[i] == '\r' || val[i] == '\t') {
+         dStr_append_c(Buf, ' ');
+      } else if (val[i] != '\n') {
+         dStr_append_c(Buf, val[i]);
+      }
+   }
+   trim(Buf, tag_parsing_flags);
+   return Buf->str;
+}
+
+/*
+ * Html_get_attr2(), as it was
+ */
+static const char *get_attr_scan(const char *tag, int tagsize,
+                                 const char *attrname, int tag_parsing_flags)
+{
+   int i, entsize, Found = 0, delimiter = 0, attr_pos = 0;
+   Dstr *Buf = attr_data;
+   DilloHtmlTagParsingState state = SEEK_ATTR_START;
+   const char *entstr;
+
+   dStr_truncate(Buf, 0);
+
+   for (i = 1; i < tagsize; ++i) {
+      switch (state) {
+      case SEEK_ATTR_START:
+         if (isspace(tag[i]))
+            state = SEEK_TOKEN_START;
+         else if (tag[i] == '=')
+            state = SEEK_VALUE_START;
+         break;
+
+      case MATCH_ATTR_NAME:
+         if (!attrname[attr_pos] &&
+             (tag[i] == '=' || isspace(tag[i]) || tag[i] == '>')) {
+            Found = 1;
+            state = SEEK_TOKEN_START;
+            --i;
+         } else if (!tag[i]) {
+            state = SEEK_ATTR_START;
+         } else {
+            if (D_ASCII_TOLOWER(tag[i]) != D_ASCII_TOLOWER(attrname[attr_pos]))
+               state = SEEK_ATTR_START;
+            attr_pos++;
+         }
+         break;
+
+      case SEEK_TOKEN_START:
+         if (tag[i] == '=') {
+            state = SEEK_VALUE_START;
+         } else if (!isspace(tag[i])) {
+            attr_pos = 0;
+            state = (Found) ? FINISHED : MATCH_ATTR_NAME;
+            --i;
+         }
+         break;
+      case SEEK_VALUE_START:
+         if (!isspace(tag[i])) {
+            delimiter = (tag[i] == '"' || tag[i] == '\'') ? tag[i] : ' ';
+            i -= (delimiter == ' ');
+            state = (Found) ? GET_VALUE : SKIP_VALUE;
+         }
+         break;
+
+      case SKIP_VALUE:
+         if ((delimiter == ' ' && isspace(tag[i])) || tag[i] == delimiter)
+            state = SEEK_TOKEN_START;
+         break;
+      case GET_VALUE:
+         if ((delimiter == ' ' && (isspace(tag[i]) || tag[i] == '>')) ||
+             tag[i] == delimiter) {
+            state = FINISHED;
+         } else if (tag[i] == '&' &&
+                    (tag_parsing_flags & HTML_ParseEntities) &&
+                    (entstr = parse_entity(tag + i, &entsize))) {
+            dStr_append(Buf, entstr);
+            i += entsize-1;
+         } else if (tag[i] == '\r' || tag[i] == '\t') {
+            dStr_append_c(Buf, ' ');
+         } else if (tag[i] != '\n') {
+            dStr_append_c(Buf, tag[i]);
+         }
+         break;
+
+      case FINISHED:
+         i = tagsize;
+         break;
+      }
+   }
+   trim(Buf, tag_parsing_flags);
+   return (Found) ? Buf->str : NULL;
+}
+
+/*
+ * Do the lookups of every tag, 'rounds' times; return a checksum of the
+ * values found.
+ */
+static unsigned long run(bool split, int rounds, double *secs)
+{
+   const int flags = HTML_LeftTrim | HTML_RightTrim | HTML_ParseEntities;
+   clock_t start = clock();
+   unsigned long sum = 0;
+   const char *val;
+
+   for (int r = 0; r < rounds; r++) {
+      for (int t = 0; t < NUM_TAGS; t++) {
+         const char *tag = tags[t].tag;
+         int tagsize = strlen(tag);
+
+         for (int n = 0; tags[t].names[n]; n++) {
+            val = split ? get_attr_split(tag, tagsize, tags[t].names[n], flags)
+                        : get_attr_scan(tag, tagsize, tags[t].names[n], flags);
+            sum = sum * 31 + (val ? strlen(val) + (uchar_t)val[0] + 1 : 0);
+         }
+         /* Html_process_tag() drops the table once the tag is done */
+         attr_tag = NULL;
+      }
+   }
+   *secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+   return sum;
+}
+
+int main()
+{
+   unsigned long sum_split, sum_scan;
+   double t_split, t_scan;
+   int ntags = NUM_ROUNDS * NUM_TAGS;
+
+   attr_data = dStr_sized_new(1024);
+   attrs = new misc::SimpleVector <DilloHtmlAttr> (16);
+
+   for (int t = 0; t < NUM_TAGS; t++) {
+      for (int n = 0; tags[t].names[n]; n++) {
+         int tagsize = strlen(tags[t].tag);
+         const char *name = tags[t].names[n], *val;
+         char *scan;
+
+         val = get_attr_scan(tags[t].tag, tagsize, name, HTML_ParseEntities);
+         scan = val ? dStrdup(val) : NULL;
+         val = get_attr_split(tags[t].tag, tagsize, name, HTML_ParseEntities);
+         if ((!val) != (!scan) || (val && strcmp(val, scan))) {
+            printf("%s in %s: \"%s\", was \"%s\"\n", name, tags[t].tag,
+                   val ? val : "(null)", scan ? scan : "(null)");
+            return 1;
+         }
+         dFree(scan);
+      }
+      attr_tag = NULL;
+   }
+
+   sum_split = run(true, NUM_ROUNDS, &t_split);
+   sum_scan = run(false, NUM_ROUNDS, &t_scan);
+   if (sum_split != sum_scan) {
+      printf("the lookups returned different values\n");
+      return 1;
+   }
+   printf("split once:      %d tags in %.3f s (%.0f tags/s)\n", ntags,
+          t_split, ntags / (t_split > 0 ? t_split : 1e-9));
+   printf("scan per lookup: %d tags in %.3f s (%.0f tags/s)\n", ntags,
+          t_scan, ntags / (t_scan > 0 ? t_scan : 1e-9));
+
+   delete attrs;
+   dStr_free(attr_data, TRUE);
+   return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Dillo Widget
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for dw::Textblock::addTextRun (), next to addText () and
+ * addSpace () per word, as the HTML parser used to call them. A text-heavy
+ * page (paragraphs of running text, with a bold word now and then) is added
+ * to a textblock in chunks, as it would arrive from the network, and each
+ * chunk is followed by a layout pass. It prints the time to add and lay out
+ * the page, and the number of queueResize calls, and checks that both ways
+ * give the same number of words and the same height.
+ *
+ * The platform and the view are the stubs of benchplatform.hh.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dw/core.hh"
+#include "dw/textblock.hh"
+#include "benchplatform.hh"
+
+using namespace dw;
+using namespace dw::core;
+using namespace dw::core::style;
+
+#define NUM_PARAGRAPHS 1000
+#define WORDS_PER_PARAGRAPH 120
+#define PARAGRAPHS_PER_CHUNK 10
+
+static const char *const words[] = {
+   "Sed", "ut", "perspiciatis,", "unde", "omnis", "iste", "natus",
+   "error", "sit", "voluptatem", "accusantium", "doloremque",
+   "laudantium,", "totam", "rem", "aperiam", "eaque", "ipsa,", "quae",
+   "ab", "illo", "inventore", "veritatis", "et", "quasi", "architecto",
+   "beatae", "vitae", "dicta", "sunt,", "explicabo.", "Nemo", "enim",
+   "ipsam", "voluptatem,", "quia", "voluptas", "sit,", "aspernatur"
+};
+#define NUM_WORDS (int)(sizeof(words) / sizeof(words[0]))
+
+class ResizeCounter: public Layout::Receiver
+{
+public:
+   int count;
+
+   ResizeCounter () { count = 0; }
+   void resizeQueued (bool extremesChanged) { count++; }
+};
+
+static Style *createStyle (Layout *layout, int weight)
+{
+   StyleAttrs attrs;
+   FontAttrs fontAttrs;
+
+   fontAttrs.name = "serif";
+   fontAttrs.size = 14;
+   fontAttrs.weight = weight;
+   fontAttrs.letterSpacing = 0;
+   fontAttrs.fontVariant = FONT_VARIANT_NORMAL;
+   fontAttrs.style = FONT_STYLE_NORMAL;
+
+   attrs.initValues ();
+   attrs.font = Font::create (layout, &fontAttrs);
+   attrs.color = Color::create (layout, 0x000000);
+   return Style::create (&attrs);
+}
+
+/*
+ * Add the page to a new textblock, one word at a time or in runs, and lay
+ * it out after every chunk. Return the number of words added, and the
+ * time taken in all and by the layout passes alone.
+ */
+static int run (bool batch, double *secs, double *layoutSecs, int *resizes,
+                int *height)
+{
+   BenchPlatform *platform = new BenchPlatform ();
+   Layout *layout = new Layout (platform);
+   ResizeCounter counter;
+   Textblock *textblock = new Textblock (false);
+   Textblock::TextRunItem items[2 * WORDS_PER_PARAGRAPH];
+   Style *normal, *bold, *style, *runStyle = NULL;
+   Dstr *text = dStr_sized_new (1024);
+   int nitems = 0, nwords = 0;
+   clock_t start;
+
+   layout->attachView (new BenchView ());
+   layout->connect (&counter);
+   layout->viewportSizeChanged (NULL, 800, 600);
+   normal = createStyle (layout, 400);
+   bold = createStyle (layout, 700);
+   textblock->setStyle (normal);
+   layout->setWidget (textblock);
+   platform->runIdle ();
+   counter.count = 0;
+   platform->idleSecs = 0;
+
+   start = clock ();
+   for (int p = 0; p < NUM_PARAGRAPHS; p++) {
+      for (int w = 0; w < WORDS_PER_PARAGRAPH; w++) {
+         const char *word = words[(p * 7 + w) % NUM_WORDS];
+         int len = strlen (word);
+
+         style = ((p + w) % 17 == 0) ? bold : normal;
+         if (!batch) {
+            if (w > 0)
+               textblock->addSpace (style);
+            textblock->addText (word, len, style);
+            nwords++;
+            continue;
+         }
+         /* what Html_text_run_add () does */
+         if (style != runStyle) {
+            if (nitems)
+               textblock->addTextRun (text->str, items, nitems, runStyle);
+            nitems = 0;
+            dStr_truncate (text, 0);
+            runStyle = style;
+         }
+         if (w > 0)
+            items[nitems++].type = Textblock::TextRunItem::SPACE;
+         items[nitems].type = Textblock::TextRunItem::TEXT;
+         items[nitems].start = text->len;
+         items[nitems++].len = len;
+         dStr_append_l (text, word, len);
+         nwords++;
+      }
+      /* the closing </p> ends the run */
+      if (nitems)
+         textblock->addTextRun (text->str, items, nitems, runStyle);
+      nitems = 0;
+      dStr_truncate (text, 0);
+      runStyle = NULL;
+      textblock->addParbreak (10, normal);
+
+      if ((p + 1) % PARAGRAPHS_PER_CHUNK == 0) {
+         textblock->flush ();
+         platform->runIdle ();
+      }
+   }
+   textblock->flush ();
+   platform->runIdle ();
+   *secs = (double) (clock () - start) / CLOCKS_PER_SEC;
+   *layoutSecs = platform->idleSecs;
+   *resizes = counter.count;
+   *height = textblock->getAllocation()->ascent +
+             textblock->getAllocation()->descent;
+
+   normal->unref ();
+   bold->unref ();
+   dStr_free (text, 1);
+   delete layout;
+   return nwords;
+}
+
+static void report (const char *what, int n, double t, double layoutSecs,
+                    int resizes)
+{
+   printf ("%-17s %d words in %.3f s (%.0f words/s), %.3f s in layout, "
+           "%d queueResize calls\n", what, n, t, n / (t > 0 ? t : 1e-9),
+           layoutSecs, resizes);
+}
+
+int main ()
+{
+   double t_word, t_run, l_word, l_run;
+   int n_word, n_run, resizes_word, resizes_run, height_word, height_run;
+
+   n_word = run (false, &t_word, &l_word, &resizes_word, &height_word);
+   n_run = run (true, &t_run, &l_run, &resizes_run, &height_run);
+   report ("addText per word:", n_word, t_word, l_word, resizes_word);
+   report ("addTextRun:", n_run, t_run, l_run, resizes_run);
+
+   if (n_word != n_run || height_word != height_run) {
+      printf ("the page is %d pixels high with addText, %d with addTextRun\n",
+              height_word, height_run);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Dillo Widget
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Benchmark for dw::fltk::FltkPlatform::textWidth (), in words per second,
+ * next to plain fl_width () over the same words. It needs a display.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <FL/Fl.H>
+#include <FL/x.H>
+#include <FL/fl_draw.H>
+
+#include "dw/fltkcore.hh"
+
+using namespace dw::core::style;
+
+#define NUM_ROUNDS 2000
+
+static const char *const words[] = {
+   "Sed", "ut", "perspiciatis,", "unde", "omnis", "iste", "natus",
+   "error", "sit", "voluptatem", "accusantium", "doloremque",
+   "laudantium,", "totam", "rem", "aperiam", "eaque", "ipsa,", "quae",
+   "ab", "illo", "inventore", "veritatis", "et", "quasi", "architecto",
+   "beatae", "vitae", "dicta", "sunt,", "explicabo.", "Grundstücks",
+   "naïve", "Ärger", "façade", "\xe2\x80\x9cquoted\xe2\x80\x9d",
+   "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "1024", "(x)"
+};
+#define NUM_WORDS (int)(sizeof(words) / sizeof(words[0]))
+
+static double seconds (clock_t start)
+{
+   return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+static void report (const char *what, double t)
+{
+   printf ("%s: %d words in %.3f s (%.0f words/s)\n", what,
+           NUM_WORDS * NUM_ROUNDS, t,
+           NUM_WORDS * NUM_ROUNDS / (t > 0 ? t : 1e-9));
+}
+
+int main ()
+{
+   dw::fltk::FltkPlatform *platform;
+   FontAttrs attrs;
+   Font *font;
+   int lens[NUM_WORDS], sum = 0;
+   clock_t start;
+
+   fl_open_display ();
+   platform = new dw::fltk::FltkPlatform ();
+
+   for (int i = 0; i < NUM_WORDS; i++)
+      lens[i] = strlen (words[i]);
+
+   attrs.name = "serif";
+   attrs.size = 14;
+   attrs.weight = 400;
+   attrs.letterSpacing = 0;
+   attrs.fontVariant = FONT_VARIANT_NORMAL;
+   attrs.style = FONT_STYLE_NORMAL;
+
+   for (int variant = 0; variant < 2; variant++) {
+      attrs.fontVariant =
+         variant ? FONT_VARIANT_SMALL_CAPS : FONT_VARIANT_NORMAL;
+      font = platform->createFont (&attrs, false);
+      font->ref ();
+
+      start = clock ();
+      for (int r = 0; r < NUM_ROUNDS; r++)
+         for (int i = 0; i < NUM_WORDS; i++)
+            sum += platform->textWidth (font, words[i], lens[i]);
+      report (variant ? "textWidth, small caps" : "textWidth", seconds (start));
+
+      font->unref ();
+   }
+
+   fl_font (FL_TIMES, attrs.size);
+   start = clock ();
+   for (int r = 0; r < NUM_ROUNDS; r++)
+      for (int i = 0; i < NUM_WORDS; i++)
+         sum += (int) fl_width (words[i], lens[i]);
+   report ("fl_width", seconds (start));
+
+   /* keep the loops from being optimized away */
+   return sum == 0;
+}
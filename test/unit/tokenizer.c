@@ -0,0 +1,201 @@
+/*
+ * Dillo tokenizer benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Microbenchmark for the delimiter scans of the HTML tokenizer
+ * (Html_scan_token() in src/html.cc): the page is split into words,
+ * spaces, tags and comments with a_Charscan_find()/a_Charscan_skip(), and
+ * again with the strcspn() and isspace() loops they replaced, and the
+ * throughput of each is printed in MB/s. Both must give the same tokens.
+ *
+ * Usage: tokenizer [file.html ...]
+ * With no files, it uses synthetic pages only; pass e.g. the test/html
+ * corpus to add it.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/charscan.h"
+
+#define SYNTHETIC_SIZE (8 * 1024 * 1024)
+#define MIN_BYTES (64 * 1024 * 1024)   /* scanned per measurement */
+
+static CharscanSet scan_space = CHARSCAN_SET(" \t\n\v\f\r");
+static CharscanSet scan_word = CHARSCAN_SET(" <\n\r\t\f\v");
+static CharscanSet scan_tag = CHARSCAN_SET(">\"'<");
+static CharscanSet scan_dq = CHARSCAN_SET("\">");
+static CharscanSet scan_sq = CHARSCAN_SET("'>");
+
+/*
+ * The token scan, without the verbatim and unterminated quote cases.
+ * 'simd' picks charscan, or the libc loops. Return the end of the token.
+ */
+static size_t scan_token(const char *buf, size_t size, size_t i, int simd)
+{
+   const char *p;
+   char ch;
+
+   if (isspace((unsigned char)buf[i])) {
+      if (simd)
+         return i + 1 + a_Charscan_skip(buf + i + 1, size - i - 1,
+                                        &scan_space);
+      while (++i < size && isspace((unsigned char)buf[i])) ;
+      return i;
+   }
+   if (buf[i] == '<' && (isalpha((unsigned char)buf[i + 1]) ||
+                         (buf[i + 1] && strchr("/!?", buf[i + 1])))) {
+      if (!strncmp(buf + i, "<!--", 4)) {
+         while ((p = memchr(buf + i, '>', size - i))) {
+            i = p - buf + 1;
+            if (p[-1] == '-' && p[-2] == '-')
+               return i;
+         }
+         return size;
+      }
+      while (i < size) {
+         i++;
+         i += simd ? a_Charscan_find(buf + i, size - i, &scan_tag)
+                   : strcspn(buf + i, ">\"'<");
+         if ((ch = buf[i]) == '>' || ch == '<' || !ch)
+            break;
+         i++;
+         i += simd ? a_Charscan_find(buf + i, size - i,
+                                     ch == '"' ? &scan_dq : &scan_sq)
+                   : strcspn(buf + i, ch == '"' ? "\">" : "'>");
+         if (buf[i] != ch)
+            break;
+      }
+      return i < size ? i + 1 : size;
+   }
+   while (++i < size) {
+      i += simd ? a_Charscan_find(buf + i, size - i, &scan_word)
+                : strcspn(buf + i, " <\n\r\t\f\v");
+      if (buf[i] == '<' && !isalpha((unsigned char)buf[i + 1]) &&
+          !(buf[i + 1] && strchr("/!?", buf[i + 1])))
+         continue;
+      break;
+   }
+   return i;
+}
+
+/*
+ * Split the page 'rounds' times; return the number of tokens of one round.
+ */
+static long tokenize(const char *buf, size_t size, int simd, int rounds,
+                     double *secs)
+{
+   clock_t start = clock();
+   long ntokens = 0;
+   size_t i;
+   int r;
+
+   for (r = 0; r < rounds; r++) {
+      ntokens = 0;
+      for (i = 0; i < size; ntokens++)
+         i = scan_token(buf, size, i, simd);
+   }
+   *secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+   return ntokens;
+}
+
+static int bench(const char *name, const char *buf, size_t size)
+{
+   int rounds = MIN_BYTES / (size ? size : 1) + 1;
+   long tokens, tokens_libc;
+   double t, t_libc;
+
+   tokens = tokenize(buf, size, 1, rounds, &t);
+   tokens_libc = tokenize(buf, size, 0, rounds, &t_libc);
+   if (tokens != tokens_libc) {
+      printf("%s: %ld tokens with charscan, %ld with libc\n", name,
+             tokens, tokens_libc);
+      return 1;
+   }
+   printf("%-24s %8lu KB %8ld tokens  charscan %7.0f MB/s  "
+          "libc %7.0f MB/s\n", name, (unsigned long) size / 1024, tokens,
+          rounds * (size / 1e6) / (t > 0 ? t : 1e-9),
+          rounds * (size / 1e6) / (t_libc > 0 ? t_libc : 1e-9));
+   return 0;
+}
+
+/*
+ * Synthetic pages: running text, a table with attributes, and indented
+ * markup with long runs of spaces.
+ */
+static char *synthetic(int kind, size_t *size)
+{
+   static const char *const text =
+      "<p>Sed ut perspiciatis, unde omnis iste natus error sit voluptatem "
+      "accusantium doloremque laudantium, totam rem aperiam eaque ipsa, "
+      "quae ab illo inventore veritatis et quasi architecto beatae vitae "
+      "dicta sunt, explicabo. <b>Nemo</b> enim ipsam voluptatem, quia "
+      "voluptas sit, aspernatur aut odit aut fugit.</p>\n";
+   static const char *const table =
+      "<tr class=\"row\"><td align=\"right\" valign=top>1024</td>"
+      "<td><a href=\"/item?id=31337&amp;p=2\" title='Item'>Item</a></td>"
+      "<td><img src=\"i.png\" width=16 height=16 alt=\"\"></td></tr>\n";
+   static const char *const indented =
+      "            <div class=\"outer\">\n"
+      "                <span>x</span>\n"
+      "                <!-- a comment -->\n"
+      "            </div>\n";
+   const char *piece = kind == 0 ? text : kind == 1 ? table : indented;
+   size_t len = strlen(piece), n = 0;
+   char *buf = malloc(SYNTHETIC_SIZE + len + 1);
+
+   while (n < SYNTHETIC_SIZE) {
+      memcpy(buf + n, piece, len);
+      n += len;
+   }
+   buf[n] = '\0';
+   *size = n;
+   return buf;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *const names[] = {
+      "synthetic text", "synthetic table", "synthetic indented"
+   };
+   char *buf;
+   size_t size;
+   FILE *fp;
+   int i, failed = 0;
+   long len;
+
+   for (i = 0; i < 3; i++) {
+      buf = synthetic(i, &size);
+      failed |= bench(names[i], buf, size);
+      free(buf);
+   }
+
+   for (i = 1; i < argc; i++) {
+      const char *name = strrchr(argv[i], '/');
+
+      if (!(fp = fopen(argv[i], "rb"))) {
+         perror(argv[i]);
+         return 1;
+      }
+      fseek(fp, 0, SEEK_END);
+      len = ftell(fp);
+      rewind(fp);
+      /* NUL-terminated, as the cache's buffer */
+      buf = malloc(len + 1);
+      size = fread(buf, 1, len, fp);
+      buf[size] = '\0';
+      fclose(fp);
+      failed |= bench(name ? name + 1 : argv[i], buf, size);
+      free(buf);
+   }
+   return failed;
+}